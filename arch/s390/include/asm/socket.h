@@ -68,4 +68,6 @@
 #define SO_PROTOCOL		38
 #define SO_DOMAIN		39
 
+#define SO_MAX_PACING_RATE	47
+
 #endif /* _ASM_SOCKET_H */
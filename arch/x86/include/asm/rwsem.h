@@ -5,8 +5,9 @@
  * Derived from asm-x86/semaphore.h
  *
  *
- * The MSW of the count is the negated number of active writers and waiting
- * lockers, and the LSW is the total number of active locks
+ * The MSW of the count is negative when there is an active writer or when
+ * anybody is queued, and the LSW is the total number of active locks
+ * (see lib/rwsem.c for the complete list of states)
  *
  * The lock count is initialized to 0 (no active and no waiting lockers).
  *
@@ -22,11 +23,13 @@
  *
  * The value of ACTIVE_BIAS supports up to 65535 active processes.
  *
- * This should be totally fair - if anything is waiting, a process that wants a
- * lock will go to the back of the queue. When the currently active lock is
- * released, if there's a writer at the front of the queue, then that and only
- * that will be woken up; if there's a bunch of consequtive readers at the
- * front, then they'll all be woken up, but no other readers will be.
+ * If anything is waiting, a reader that wants the lock will go to the back of
+ * the queue. When the currently active lock is released, if there's a writer
+ * at the front of the queue, then that and only that will be woken up; if
+ * there's a bunch of consequtive readers at the front, then they'll all be
+ * granted the lock and woken up, but no other readers will be. Writers may
+ * steal the lock from a woken writer, and may spin waiting for a running
+ * write owner instead of queueing.
  */
 
 #ifndef _ASM_X86_RWSEM_H
@@ -80,6 +83,10 @@ struct rw_semaphore {
 	rwsem_count_t		count;
 	spinlock_t		wait_lock;
 	struct list_head	wait_list;
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	/* write owner, for optimistic spinning */
+	struct task_struct	*owner;
+#endif
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map dep_map;
 #endif
@@ -251,8 +251,12 @@ static inline void __raw_spin_unlock_wait(raw_spinlock_t *lock)
  * read-locks.
  *
  * On x86, we implement read-write locks as a 32-bit counter
- * with the high bit (sign) being the "contended" bit.
+ * with the high bit (sign) being the "contended" bit, unless
+ * CONFIG_QUEUE_RWLOCK selects the fair queued implementation.
  */
+#ifdef CONFIG_QUEUE_RWLOCK
+#include <asm/qrwlock.h>
+#else
 
 /**
  * read_can_lock - would read_trylock() succeed?
@@ -320,6 +324,7 @@ static inline void __raw_write_unlock(raw_rwlock_t *rw)
 	asm volatile(LOCK_PREFIX "addl %1, %0"
 		     : "+m" (rw->lock) : "i" (RW_LOCK_BIAS) : "memory");
 }
+#endif /* CONFIG_QUEUE_RWLOCK */
 
 #define __raw_read_lock_flags(lock, flags) __raw_read_lock(lock)
 #define __raw_write_lock_flags(lock, flags) __raw_write_lock(lock)
@@ -12,10 +12,14 @@ typedef struct raw_spinlock {
 
 #define __RAW_SPIN_LOCK_UNLOCKED	{ 0 }
 
+#ifdef CONFIG_QUEUE_RWLOCK
+#include <asm-generic/qrwlock_types.h>
+#else
 typedef struct {
 	unsigned int lock;
 } raw_rwlock_t;
 
 #define __RAW_RW_LOCK_UNLOCKED		{ RW_LOCK_BIAS }
+#endif
 
 #endif /* _ASM_X86_SPINLOCK_TYPES_H */
@@ -32,6 +32,7 @@
 #include <trace/events/block.h>
 
 #include "blk.h"
+#include "blk-wbt.h"
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_remap);
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_rq_remap);
@@ -382,6 +383,8 @@ void blk_sync_queue(struct request_queue *q)
 	del_timer_sync(&q->unplug_timer);
 	del_timer_sync(&q->timeout);
 	cancel_work_sync(&q->unplug_work);
+	if (q->rq_wb)
+		del_timer_sync(&q->rq_wb->window_timer);
 }
 EXPORT_SYMBOL(blk_sync_queue);
 
@@ -1079,6 +1082,8 @@ void __blk_put_request(struct request_queue *q, struct request *req)
 	if (unlikely(--req->ref_count))
 		return;
 
+	wbt_done(q->rq_wb, req);
+
 	elv_completed_request(q, req);
 
 	/* this is a bio leak */
@@ -1164,6 +1169,7 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	const bool sync = bio_rw_flagged(bio, BIO_RW_SYNCIO);
 	const bool unplug = bio_rw_flagged(bio, BIO_RW_UNPLUG);
 	const unsigned int ff = bio->bi_rw & REQ_FAILFAST_MASK;
+	bool wb_acct = false;
 	int rw_flags;
 
 	if (bio_rw_flagged(bio, BIO_RW_BARRIER) &&
@@ -1255,6 +1261,16 @@ get_rq:
 	if (sync)
 		rw_flags |= REQ_RW_SYNC;
 
+	/*
+	 * Async writeback has to get in line for a throttling slot before
+	 * it can have a request, so that it doesn't fill up the queue in
+	 * front of reads. This might sleep, dropping the queue lock.
+	 */
+	if (wbt_should_throttle(q->rq_wb, bio)) {
+		wbt_wait(q->rq_wb, bio);
+		wb_acct = true;
+	}
+
 	/*
 	 * Grab a free request. This is might sleep but can not fail.
 	 * Returns with the queue unlocked.
@@ -1268,6 +1284,8 @@ get_rq:
 	 * often, and the elevators are able to handle it.
 	 */
 	init_request_from_bio(req, bio);
+	if (wb_acct)
+		wbt_track(q->rq_wb, req);
 
 	spin_lock_irq(q->queue_lock);
 	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) ||
@@ -1898,6 +1916,8 @@ void blk_start_request(struct request *req)
 	if (unlikely(blk_bidi_rq(req)))
 		req->next_rq->resid_len = blk_rq_bytes(req->next_rq);
 
+	wbt_issue(req->q->rq_wb, req);
+
 	blk_add_timer(req);
 }
 EXPORT_SYMBOL(blk_start_request);
@@ -2117,6 +2137,8 @@ static void blk_finish_request(struct request *req, int error)
 
 	blk_account_io_done(req);
 
+	wbt_done(req->q->rq_wb, req);
+
 	if (req->end_io)
 		req->end_io(req, error);
 	else {
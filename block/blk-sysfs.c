@@ -8,6 +8,7 @@
 #include <linux/blktrace_api.h>
 
 #include "blk.h"
+#include "blk-wbt.h"
 
 struct queue_sysfs_entry {
 	struct attribute attr;
@@ -76,6 +77,9 @@ queue_requests_store(struct request_queue *q, const char *page, size_t count)
 		blk_clear_queue_full(q, BLK_RW_ASYNC);
 		wake_up(&rl->wait[BLK_RW_ASYNC]);
 	}
+
+	if (q->rq_wb)
+		wbt_update_limits(q->rq_wb);
 	spin_unlock_irq(q->queue_lock);
 	return ret;
 }
@@ -239,6 +243,76 @@ static ssize_t queue_iostats_store(struct request_queue *q, const char *page,
 	return ret;
 }
 
+#ifdef CONFIG_BLK_WBT
+static ssize_t queue_wb_lat_show(struct request_queue *q, char *page)
+{
+	if (!q->rq_wb)
+		return -EINVAL;
+
+	return sprintf(page, "%llu\n",
+		       div_u64(q->rq_wb->min_lat_nsec, 1000));
+}
+
+/*
+ * Writing -1 restores the default target for this kind of device,
+ * 0 disables writeback throttling.
+ */
+static ssize_t queue_wb_lat_store(struct request_queue *q, const char *page,
+				  size_t count)
+{
+	long long val;
+
+	if (!q->rq_wb)
+		return -EINVAL;
+
+	if (strict_strtoll(page, 10, &val))
+		return -EINVAL;
+	/* -1 is the default, anything else is in usecs */
+	if (val < -1 || val > LLONG_MAX / 1000)
+		return -EINVAL;
+
+	spin_lock_irq(q->queue_lock);
+	if (val == -1)
+		wbt_set_min_lat(q->rq_wb, wbt_default_latency_nsec(q));
+	else
+		wbt_set_min_lat(q->rq_wb, 1000ULL * val);
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+
+static ssize_t queue_wb_win_show(struct request_queue *q, char *page)
+{
+	if (!q->rq_wb)
+		return -EINVAL;
+
+	return sprintf(page, "%llu\n", div_u64(q->rq_wb->win_nsec, 1000));
+}
+
+static ssize_t queue_wb_win_store(struct request_queue *q, const char *page,
+				  size_t count)
+{
+	unsigned long val;
+	int err;
+
+	if (!q->rq_wb)
+		return -EINVAL;
+
+	err = strict_strtoul(page, 10, &val);
+	if (err)
+		return err;
+	/* 1ms to 10s, in usecs */
+	if (val < 1000 || val > 10 * USEC_PER_SEC)
+		return -EINVAL;
+
+	spin_lock_irq(q->queue_lock);
+	q->rq_wb->win_nsec = 1000ULL * val;
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+#endif
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -317,6 +391,20 @@ static struct queue_sysfs_entry queue_iostats_entry = {
 	.store = queue_iostats_store,
 };
 
+#ifdef CONFIG_BLK_WBT
+static struct queue_sysfs_entry queue_wb_lat_entry = {
+	.attr = {.name = "wbt_lat_usec", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_wb_lat_show,
+	.store = queue_wb_lat_store,
+};
+
+static struct queue_sysfs_entry queue_wb_win_entry = {
+	.attr = {.name = "wbt_window_usec", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_wb_win_show,
+	.store = queue_wb_win_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -332,6 +420,10 @@ static struct attribute *default_attrs[] = {
 	&queue_nomerges_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
+#ifdef CONFIG_BLK_WBT
+	&queue_wb_lat_entry.attr,
+	&queue_wb_win_entry.attr,
+#endif
 	NULL,
 };
 
@@ -410,6 +502,8 @@ static void blk_release_queue(struct kobject *kobj)
 
 	blk_trace_shutdown(q);
 
+	wbt_exit(q);
+
 	bdi_destroy(&q->backing_dev_info);
 	kmem_cache_free(blk_requestq_cachep, q);
 }
@@ -458,6 +552,13 @@ int blk_register_queue(struct gendisk *disk)
 		return ret;
 	}
 
+	/*
+	 * Writeback throttling is best effort, the queue works fine
+	 * without it.
+	 */
+	if (!q->rq_wb)
+		wbt_init(q);
+
 	return 0;
 }
 
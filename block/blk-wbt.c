@@ -0,0 +1,480 @@
+/*
+ * Buffered writeback throttling, loosely based on CoDel. We can't drop
+ * packets for IO scheduling, so the logic is something like this:
+ *
+ * - Monitor read latencies in a time window.
+ * - If the minimum latency in the window exceeds the target latency
+ *   (wbt_lat_usec), every read in that window waited too long behind
+ *   something. Shrink the number of async (background) writes we allow
+ *   in flight and shorten the monitoring window.
+ * - If latencies look good, scale the depth back up until we're at the
+ *   default again.
+ *
+ * Only new async write requests are throttled; merges into existing
+ * requests, sync writes and reads are never held back here.
+ *
+ * Depth is tracked in three classes: wb_max for kswapd (memory needs to
+ * be cleaned), wb_normal for writeback with no competing IO and
+ * wb_background for writeback while reads or sync writes are being
+ * issued on the same queue.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/swap.h>
+
+#include "blk.h"
+#include "blk-wbt.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/wbt.h>
+
+enum {
+	/*
+	 * Default queue depth when the driver doesn't tell us one
+	 */
+	RWB_DEF_DEPTH		= 16,
+
+	/*
+	 * 100msec window
+	 */
+	RWB_WINDOW_NSEC		= 100 * 1000 * 1000ULL,
+
+	/*
+	 * If we have this number of consecutive windows with no reads,
+	 * scale the depth back up towards the default
+	 */
+	RWB_UNKNOWN_BUMP	= 5,
+};
+
+enum {
+	LAT_OK = 1,
+	LAT_UNKNOWN,
+	LAT_EXCEEDED,
+};
+
+static inline bool rwb_enabled(struct rq_wb *rwb)
+{
+	return rwb && rwb->min_lat_nsec != 0;
+}
+
+static void calc_wb_limits(struct rq_wb *rwb)
+{
+	unsigned int depth;
+
+	if (!rwb->min_lat_nsec) {
+		rwb->wb_max = rwb->wb_normal = rwb->wb_background = 0;
+		return;
+	}
+
+	depth = max(rwb->queue_depth >> rwb->scale_step, 1U);
+
+	rwb->wb_max = depth;
+	rwb->wb_normal = (depth + 1) / 2;
+	rwb->wb_background = (depth + 3) / 4;
+}
+
+static void rwb_trace_step(struct rq_wb *rwb, const char *msg)
+{
+	trace_wbt_step(&rwb->q->backing_dev_info, msg, rwb->scale_step,
+		       rwb->cur_win_nsec, rwb->wb_background, rwb->wb_normal,
+		       rwb->wb_max);
+}
+
+static void rwb_arm_timer(struct rq_wb *rwb)
+{
+	unsigned long expires;
+
+	/*
+	 * Shrink the window as we scale down, so that we react faster
+	 * when latencies are bad and back off gently when they recover:
+	 * win = default_win / sqrt(step + 1)
+	 */
+	rwb->cur_win_nsec = div_u64(rwb->win_nsec,
+				    int_sqrt(rwb->scale_step + 1));
+	expires = jiffies + usecs_to_jiffies(div_u64(rwb->cur_win_nsec,
+						     NSEC_PER_USEC));
+	mod_timer(&rwb->window_timer, expires);
+}
+
+static void scale_up(struct rq_wb *rwb)
+{
+	if (!rwb->scale_step)
+		return;
+
+	rwb->scale_step--;
+	rwb->unknown_cnt = 0;
+	calc_wb_limits(rwb);
+
+	/*
+	 * The limits went up, let everybody have another go
+	 */
+	wake_up_all(&rwb->wait);
+	rwb_trace_step(rwb, "step up");
+}
+
+static void scale_down(struct rq_wb *rwb)
+{
+	/*
+	 * Stop scaling down when we've hit the limit. This also prevents
+	 * ->scale_step from going to crazy values, if the device can't
+	 * keep up.
+	 */
+	if (rwb->wb_max == 1)
+		return;
+
+	rwb->scale_step++;
+	rwb->unknown_cnt = 0;
+	calc_wb_limits(rwb);
+	rwb_trace_step(rwb, "step down");
+}
+
+static int latency_exceeded(struct rq_wb *rwb)
+{
+	trace_wbt_stat(&rwb->q->backing_dev_info, rwb->read_lat_min,
+		       rwb->read_lat_max, rwb->nr_read, rwb->nr_write);
+
+	/*
+	 * No reads in this window, we have no idea whether the writes
+	 * hurt anybody.
+	 */
+	if (!rwb->nr_read)
+		return LAT_UNKNOWN;
+
+	/*
+	 * If the fastest read in the window was still slower than the
+	 * target, all of them were: the queue is full of our writes.
+	 */
+	if (rwb->read_lat_min > rwb->min_lat_nsec)
+		return LAT_EXCEEDED;
+
+	return LAT_OK;
+}
+
+static void rwb_reset_stats(struct rq_wb *rwb)
+{
+	rwb->read_lat_min = ULLONG_MAX;
+	rwb->read_lat_max = 0;
+	rwb->nr_read = 0;
+	rwb->nr_write = 0;
+}
+
+static void wb_timer_fn(unsigned long data)
+{
+	struct rq_wb *rwb = (struct rq_wb *) data;
+	struct request_queue *q = rwb->q;
+	unsigned int inflight;
+	unsigned long flags;
+	int status;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+
+	if (!rwb_enabled(rwb))
+		goto out;
+
+	status = latency_exceeded(rwb);
+	inflight = atomic_read(&rwb->inflight);
+
+	trace_wbt_timer(&rwb->q->backing_dev_info, status, rwb->scale_step,
+			inflight);
+
+	switch (status) {
+	case LAT_EXCEEDED:
+		/*
+		 * Slow reads are only our business if we had writes
+		 * competing with them.
+		 */
+		if (rwb->nr_write || inflight)
+			scale_down(rwb);
+		break;
+	case LAT_OK:
+		scale_up(rwb);
+		break;
+	case LAT_UNKNOWN:
+		/*
+		 * We haven't seen a read for a while. If we're throttled,
+		 * slowly allow more writes again: whoever was suffering
+		 * from them is apparently gone.
+		 */
+		if (++rwb->unknown_cnt >= RWB_UNKNOWN_BUMP)
+			scale_up(rwb);
+		break;
+	}
+
+	rwb_reset_stats(rwb);
+
+	/*
+	 * Re-arm the timer while there is something to watch; wbt_wait()
+	 * restarts it when writes show up again.
+	 */
+	if (rwb->scale_step || inflight)
+		rwb_arm_timer(rwb);
+out:
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+/*
+ * Was there recent IO on this queue that our writes could get in the
+ * way of?
+ */
+static bool close_io(struct rq_wb *rwb)
+{
+	const unsigned long now = jiffies;
+
+	return time_before(now, rwb->last_issue + HZ / 10) ||
+		time_before(now, rwb->last_comp + HZ / 10);
+}
+
+static unsigned int wbt_get_limit(struct rq_wb *rwb)
+{
+	/*
+	 * If we got disabled, just return UINT_MAX. This ensures that
+	 * we'll properly inc a new IO, and dec+wakeup at the end.
+	 */
+	if (!rwb_enabled(rwb))
+		return UINT_MAX;
+
+	/*
+	 * kswapd is trying to free memory, let it have the full depth.
+	 * Otherwise, if somebody else is doing IO on this queue, leave
+	 * room for it; if not, allow a bit more writeback.
+	 */
+	if (current_is_kswapd())
+		return rwb->wb_max;
+	if (close_io(rwb))
+		return rwb->wb_background;
+
+	return rwb->wb_normal;
+}
+
+static bool may_queue(struct rq_wb *rwb, bool waiting)
+{
+	/*
+	 * inc it here even if disabled, since we'll dec it at completion.
+	 * this only happens if the task was sleeping in __make_request(),
+	 * and someone turned it off at the same time.
+	 */
+	if (!rwb_enabled(rwb)) {
+		atomic_inc(&rwb->inflight);
+		return true;
+	}
+
+	/*
+	 * Don't jump the queue in front of tasks that are already waiting.
+	 */
+	if (!waiting && waitqueue_active(&rwb->wait))
+		return false;
+
+	if (atomic_read(&rwb->inflight) >= wbt_get_limit(rwb))
+		return false;
+
+	atomic_inc(&rwb->inflight);
+	return true;
+}
+
+/**
+ * wbt_wait - wait for a writeback throttling slot
+ * @rwb: the queue's writeback throttling state
+ * @bio: the async write about to get a new request
+ *
+ * Called from __make_request() with the queue lock held and interrupts
+ * disabled; the lock may be dropped while we sleep. On return the
+ * caller owns one in-flight slot, and must hand it to the request with
+ * wbt_track().
+ */
+void wbt_wait(struct rq_wb *rwb, struct bio *bio)
+{
+	struct request_queue *q = rwb->q;
+	DEFINE_WAIT(wait);
+
+	if (!timer_pending(&rwb->window_timer))
+		rwb_arm_timer(rwb);
+
+	if (may_queue(rwb, false))
+		return;
+
+	do {
+		prepare_to_wait_exclusive(&rwb->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+
+		if (may_queue(rwb, true))
+			break;
+
+		__generic_unplug_device(q);
+		spin_unlock_irq(q->queue_lock);
+		io_schedule();
+		spin_lock_irq(q->queue_lock);
+	} while (1);
+
+	finish_wait(&rwb->wait, &wait);
+}
+
+/**
+ * wbt_track - account a new request against the throttling depth
+ * @rwb: the queue's writeback throttling state
+ * @rq: the request built for a bio that went through wbt_wait()
+ */
+void wbt_track(struct rq_wb *rwb, struct request *rq)
+{
+	rq->cmd_flags |= REQ_WB_TRACKED;
+}
+
+/**
+ * wbt_issue - note a request being handed to the driver
+ * @rwb: the queue's writeback throttling state
+ * @rq: the request being started
+ *
+ * Called with the queue lock held from blk_start_request().
+ */
+void wbt_issue(struct rq_wb *rwb, struct request *rq)
+{
+	if (!rwb_enabled(rwb) || !blk_fs_request(rq))
+		return;
+
+	if (!(rq->cmd_flags & REQ_WB_TRACKED))
+		rwb->last_issue = jiffies;
+
+	if (rq_data_dir(rq) == READ)
+		rq->issue_time_ns = ktime_to_ns(ktime_get());
+}
+
+/**
+ * wbt_done - complete a request for writeback throttling purposes
+ * @rwb: the queue's writeback throttling state
+ * @rq: the request that finished, or is being freed
+ *
+ * Called with the queue lock held, both from blk_finish_request() and
+ * from __blk_put_request(), so it must be idempotent: requests that are
+ * merged away are freed without ever being finished.
+ */
+void wbt_done(struct rq_wb *rwb, struct request *rq)
+{
+	if (!rwb)
+		return;
+
+	if (rq->cmd_flags & REQ_WB_TRACKED) {
+		int inflight;
+
+		rq->cmd_flags &= ~REQ_WB_TRACKED;
+		inflight = atomic_dec_return(&rwb->inflight);
+		rwb->nr_write++;
+
+		/*
+		 * Wake one waiter per completion; it rechecks its own limit.
+		 * When the queue drained, everybody may go.
+		 */
+		if (!inflight)
+			wake_up_all(&rwb->wait);
+		else if (waitqueue_active(&rwb->wait) &&
+			 inflight < wbt_get_limit(rwb))
+			wake_up(&rwb->wait);
+		return;
+	}
+
+	if (rq->issue_time_ns) {
+		u64 now = ktime_to_ns(ktime_get());
+		u64 lat = now > rq->issue_time_ns ?
+				now - rq->issue_time_ns : 0;
+
+		rq->issue_time_ns = 0;
+		rwb->last_comp = jiffies;
+		rwb->nr_read++;
+		if (lat < rwb->read_lat_min)
+			rwb->read_lat_min = lat;
+		if (lat > rwb->read_lat_max)
+			rwb->read_lat_max = lat;
+	}
+}
+
+/**
+ * wbt_update_limits - recompute the depths after a queue change
+ * @rwb: the queue's writeback throttling state
+ *
+ * Called with the queue lock held, e.g. when nr_requests is changed.
+ */
+void wbt_update_limits(struct rq_wb *rwb)
+{
+	struct request_queue *q = rwb->q;
+	unsigned int depth = RWB_DEF_DEPTH;
+
+	if (q->queue_tags)
+		depth = q->queue_tags->max_depth;
+	rwb->queue_depth = min_t(unsigned int, depth, q->nr_requests);
+
+	rwb->scale_step = 0;
+	rwb->unknown_cnt = 0;
+	calc_wb_limits(rwb);
+	wake_up_all(&rwb->wait);
+	rwb_trace_step(rwb, "reset");
+}
+
+/**
+ * wbt_set_min_lat - set the read latency target
+ * @rwb: the queue's writeback throttling state
+ * @lat_nsec: new target, or 0 to disable throttling
+ *
+ * Called with the queue lock held.
+ */
+void wbt_set_min_lat(struct rq_wb *rwb, u64 lat_nsec)
+{
+	rwb->min_lat_nsec = lat_nsec;
+	trace_wbt_lat(&rwb->q->backing_dev_info, lat_nsec);
+	wbt_update_limits(rwb);
+}
+
+/*
+ * Rotational devices see much higher latencies for a single read than
+ * SSDs do, so start from a more relaxed target there.
+ */
+u64 wbt_default_latency_nsec(struct request_queue *q)
+{
+	if (blk_queue_nonrot(q))
+		return 2000000ULL;
+	else
+		return 75000000ULL;
+}
+
+/**
+ * wbt_init - enable writeback throttling on a request based queue
+ * @q: the queue, which must have its queue_lock set up
+ */
+int wbt_init(struct request_queue *q)
+{
+	struct rq_wb *rwb;
+
+	rwb = kzalloc_node(sizeof(*rwb), GFP_KERNEL, q->node);
+	if (!rwb)
+		return -ENOMEM;
+
+	atomic_set(&rwb->inflight, 0);
+	init_waitqueue_head(&rwb->wait);
+	setup_timer(&rwb->window_timer, wb_timer_fn, (unsigned long) rwb);
+	rwb->last_comp = rwb->last_issue = jiffies;
+	rwb->win_nsec = RWB_WINDOW_NSEC;
+	rwb->cur_win_nsec = RWB_WINDOW_NSEC;
+	rwb->q = q;
+	rwb_reset_stats(rwb);
+
+	spin_lock_irq(q->queue_lock);
+	wbt_set_min_lat(rwb, wbt_default_latency_nsec(q));
+	q->rq_wb = rwb;
+	spin_unlock_irq(q->queue_lock);
+
+	return 0;
+}
+
+/**
+ * wbt_exit - tear down writeback throttling for a queue
+ * @q: the queue, which no longer has IO in flight
+ */
+void wbt_exit(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (rwb) {
+		del_timer_sync(&rwb->window_timer);
+		q->rq_wb = NULL;
+		kfree(rwb);
+	}
+}
@@ -0,0 +1,101 @@
+#ifndef BLK_WBT_H
+#define BLK_WBT_H
+
+#include <linux/kernel.h>
+#include <asm/atomic.h>
+#include <linux/wait.h>
+#include <linux/timer.h>
+#include <linux/ktime.h>
+
+/*
+ * Writeback throttling state for one request_queue. All fields except
+ * ->inflight and the waitqueue are protected by the queue lock.
+ */
+struct rq_wb {
+	/*
+	 * Settings that govern how we throttle
+	 */
+	unsigned int wb_background;		/* background writeback */
+	unsigned int wb_normal;			/* normal writeback */
+	unsigned int wb_max;			/* max throughput writeback */
+	int scale_step;				/* depth is queue_depth >> step */
+
+	u64 win_nsec;				/* default window size */
+	u64 cur_win_nsec;			/* current window size */
+	u64 min_lat_nsec;			/* read latency target, 0 = off */
+	unsigned int queue_depth;		/* depth at scale_step 0 */
+	unsigned int unknown_cnt;		/* windows without reads */
+
+	unsigned long last_issue;		/* last non-throttled issue */
+	unsigned long last_comp;		/* last non-throttled comp */
+
+	/*
+	 * Statistics for the current window
+	 */
+	u64 read_lat_min;
+	u64 read_lat_max;
+	unsigned int nr_read;
+	unsigned int nr_write;
+
+	struct timer_list window_timer;
+	struct request_queue *q;
+
+	atomic_t inflight;			/* tracked writes in flight */
+	wait_queue_head_t wait;
+};
+
+#ifdef CONFIG_BLK_WBT
+
+int wbt_init(struct request_queue *q);
+void wbt_exit(struct request_queue *q);
+void wbt_wait(struct rq_wb *rwb, struct bio *bio);
+void wbt_track(struct rq_wb *rwb, struct request *rq);
+void wbt_issue(struct rq_wb *rwb, struct request *rq);
+void wbt_done(struct rq_wb *rwb, struct request *rq);
+void wbt_update_limits(struct rq_wb *rwb);
+void wbt_set_min_lat(struct rq_wb *rwb, u64 lat_nsec);
+u64 wbt_default_latency_nsec(struct request_queue *q);
+
+static inline bool wbt_should_throttle(struct rq_wb *rwb, struct bio *bio)
+{
+	/*
+	 * Only async writes are throttled: sync writes (fsync, O_DIRECT)
+	 * have somebody waiting on them, just like reads do.
+	 */
+	return rwb && rwb->min_lat_nsec && bio_data_dir(bio) == WRITE &&
+		!bio_rw_flagged(bio, BIO_RW_SYNCIO) &&
+		!bio_rw_flagged(bio, BIO_RW_BARRIER);
+}
+
+#else
+
+static inline int wbt_init(struct request_queue *q)
+{
+	return -EINVAL;
+}
+static inline void wbt_exit(struct request_queue *q)
+{
+}
+static inline void wbt_wait(struct rq_wb *rwb, struct bio *bio)
+{
+}
+static inline void wbt_track(struct rq_wb *rwb, struct request *rq)
+{
+}
+static inline void wbt_issue(struct rq_wb *rwb, struct request *rq)
+{
+}
+static inline void wbt_done(struct rq_wb *rwb, struct request *rq)
+{
+}
+static inline void wbt_update_limits(struct rq_wb *rwb)
+{
+}
+static inline bool wbt_should_throttle(struct rq_wb *rwb, struct bio *bio)
+{
+	return false;
+}
+
+#endif /* CONFIG_BLK_WBT */
+
+#endif
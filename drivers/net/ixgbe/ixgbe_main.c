@@ -340,6 +340,7 @@ static bool ixgbe_clean_tx_irq(struct ixgbe_q_vector *q_vector,
 	struct ixgbe_tx_buffer *tx_buffer_info;
 	unsigned int i, eop, count = 0;
 	unsigned int total_bytes = 0, total_packets = 0;
+	unsigned int bytes_compl = 0, pkts_compl = 0;
 
 	i = tx_ring->next_to_clean;
 	eop = tx_ring->tx_buffer_info[i].next_to_watch;
@@ -377,6 +378,9 @@ static bool ixgbe_clean_tx_irq(struct ixgbe_q_vector *q_vector,
 				bytecount = ((segs - 1) * hlen) + skb->len;
 				total_packets += segs;
 				total_bytes += bytecount;
+				/* as reported to netdev_tx_sent_queue() */
+				bytes_compl += skb->len;
+				pkts_compl++;
 			}
 
 			ixgbe_unmap_and_free_tx_resource(adapter,
@@ -395,6 +399,10 @@ static bool ixgbe_clean_tx_irq(struct ixgbe_q_vector *q_vector,
 
 	tx_ring->next_to_clean = i;
 
+	netdev_tx_completed_queue(netdev_get_tx_queue(netdev,
+						      tx_ring->queue_index),
+				  pkts_compl, bytes_compl);
+
 #define TX_WAKE_THRESHOLD (DESC_NEEDED * 2)
 	if (unlikely(count && netif_carrier_ok(netdev) &&
 	             (IXGBE_DESC_UNUSED(tx_ring) >= TX_WAKE_THRESHOLD))) {
@@ -2987,6 +2995,8 @@ static void ixgbe_clean_tx_ring(struct ixgbe_adapter *adapter,
 
 	tx_ring->next_to_use = 0;
 	tx_ring->next_to_clean = 0;
+	netdev_tx_reset_queue(netdev_get_tx_queue(adapter->netdev,
+						  tx_ring->queue_index));
 
 	if (tx_ring->head)
 		writel(0, adapter->hw.hw_addr + tx_ring->head);
@@ -5363,6 +5373,10 @@ static netdev_tx_t ixgbe_xmit_frame(struct sk_buff *skb,
 				tx_ring->atr_count = 0;
 			}
 		}
+		/* before the tail write, the skb may complete right away */
+		netdev_tx_sent_queue(netdev_get_tx_queue(netdev,
+							 tx_ring->queue_index),
+				     skb->len);
 		ixgbe_tx_queue(adapter, tx_ring, tx_flags, count, skb->len,
 		               hdr_len);
 		ixgbe_maybe_stop_tx(netdev, tx_ring, DESC_NEEDED);
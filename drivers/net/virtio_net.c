@@ -63,6 +63,9 @@ struct virtnet_info
 	/* Work struct for refilling if we run low on memory. */
 	struct delayed_work refill;
 
+	/* Reaps completed send buffers outside of the virtqueue callback. */
+	struct tasklet_struct tx_tasklet;
+
 	/* Chain pages by the private ptr. */
 	struct page *pages;
 };
@@ -114,8 +117,8 @@ static void skb_xmit_done(struct virtqueue *svq)
 	/* Suppress further interrupts. */
 	svq->vq_ops->disable_cb(svq);
 
-	/* We were probably waiting for more output buffers. */
-	netif_wake_queue(vi->dev);
+	/* Report the completions from softirq, under the xmit lock. */
+	tasklet_schedule(&vi->tx_tasklet);
 }
 
 static void receive_skb(struct net_device *dev, struct sk_buff *skb,
@@ -459,6 +462,7 @@ static unsigned int free_old_xmit_skbs(struct virtnet_info *vi)
 {
 	struct sk_buff *skb;
 	unsigned int len, tot_sgs = 0;
+	unsigned int pkts = 0, bytes = 0;
 
 	while ((skb = vi->svq->vq_ops->get_buf(vi->svq, &len)) != NULL) {
 		pr_debug("Sent skb %p\n", skb);
@@ -466,11 +470,26 @@ static unsigned int free_old_xmit_skbs(struct virtnet_info *vi)
 		vi->dev->stats.tx_bytes += skb->len;
 		vi->dev->stats.tx_packets++;
 		tot_sgs += skb_vnet_hdr(skb)->num_sg;
+		pkts++;
+		bytes += skb->len;
 		dev_kfree_skb_any(skb);
 	}
+	netdev_completed_queue(vi->dev, pkts, bytes);
 	return tot_sgs;
 }
 
+static void xmit_tasklet(unsigned long data)
+{
+	struct virtnet_info *vi = (struct virtnet_info *)data;
+
+	netif_tx_lock(vi->dev);
+	free_old_xmit_skbs(vi);
+	netif_tx_unlock(vi->dev);
+
+	/* We were probably waiting for more output buffers. */
+	netif_wake_queue(vi->dev);
+}
+
 static int xmit_skb(struct virtnet_info *vi, struct sk_buff *skb)
 {
 	struct scatterlist sg[2+MAX_SKB_FRAGS];
@@ -523,6 +542,7 @@ static int xmit_skb(struct virtnet_info *vi, struct sk_buff *skb)
 static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct virtnet_info *vi = netdev_priv(dev);
+	struct netdev_queue *txq;
 	int capacity;
 
 	/* Free up any pending old buffers before queueing new ones. */
@@ -548,6 +568,7 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 		kfree_skb(skb);
 		return NETDEV_TX_OK;
 	}
+	netdev_sent_queue(dev, skb->len);
 	vi->svq->vq_ops->kick(vi->svq);
 
 	/*
@@ -577,6 +598,19 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 		}
 	}
 
+	/* If the byte queue limit stopped us, nothing calls back in here
+	 * until some of it completes: ask for the callback. */
+	txq = netdev_get_tx_queue(dev, 0);
+	if (netif_xmit_stopped(txq)) {
+		while (unlikely(!vi->svq->vq_ops->enable_cb(vi->svq))) {
+			free_old_xmit_skbs(vi);
+			if (!netif_xmit_stopped(txq)) {
+				vi->svq->vq_ops->disable_cb(vi->svq);
+				break;
+			}
+		}
+	}
+
 	return NETDEV_TX_OK;
 }
 
@@ -900,6 +934,7 @@ static int virtnet_probe(struct virtio_device *vdev)
 	vdev->priv = vi;
 	vi->pages = NULL;
 	INIT_DELAYED_WORK(&vi->refill, refill_work);
+	tasklet_init(&vi->tx_tasklet, xmit_tasklet, (unsigned long)vi);
 
 	/* If we can receive ANY GSO packets, we must allocate large ones. */
 	if (virtio_has_feature(vdev, VIRTIO_NET_F_GUEST_TSO4)
@@ -972,6 +1007,7 @@ static void __devexit virtnet_remove(struct virtio_device *vdev)
 
 	/* Stop all the virtqueues. */
 	vdev->config->reset(vdev);
+	tasklet_kill(&vi->tx_tasklet);
 
 	/* Free our skbs in send and recv queues, if any. */
 	while ((skb = __skb_dequeue(&vi->recv)) != NULL) {
@@ -979,6 +1015,7 @@ static void __devexit virtnet_remove(struct virtio_device *vdev)
 		vi->num--;
 	}
 	__skb_queue_purge(&vi->send);
+	netdev_reset_queue(vi->dev);
 
 	BUG_ON(vi->num != 0);
 
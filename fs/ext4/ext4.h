@@ -29,6 +29,7 @@
 #include <linux/wait.h>
 #include <linux/blockgroup_lock.h>
 #include <linux/percpu_counter.h>
+#include <linux/ktime.h>
 #ifdef __KERNEL__
 #include <linux/compat.h>
 #endif
@@ -505,6 +506,7 @@ struct ext4_mount_options {
 	gid_t s_resgid;
 	unsigned long s_commit_interval;
 	u32 s_min_batch_time, s_max_batch_time;
+	unsigned int s_li_wait_mult;
 #ifdef CONFIG_QUOTA
 	int s_jquota_fmt;
 	char *s_qf_names[MAXQUOTAS];
@@ -846,6 +848,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
+#define EXT4_MOUNT_INIT_INODE_TABLE	0x80000000 /* Initialize uninitialized itables */
 
 #define clear_opt(o, opt)		o &= ~EXT4_MOUNT_##opt
 #define set_opt(o, opt)			o |= EXT4_MOUNT_##opt
@@ -1091,6 +1094,12 @@ struct ext4_sb_info {
 	atomic_t s_mb_preallocated;
 	atomic_t s_mb_discarded;
 	atomic_t s_lock_busy;
+#ifdef CONFIG_EXT4_MB_BENCH
+	/* allocator benchmark (mb_bench.c) */
+	struct ext4_mb_bench *s_mb_bench;
+	struct ext4_mb_bench_stats *s_mb_bench_stats;
+	int s_mb_bench_active;
+#endif
 
 	/* locality groups */
 	struct ext4_locality_group *s_locality_groups;
@@ -1104,6 +1113,11 @@ struct ext4_sb_info {
 
 	/* workqueue for dio unwritten */
 	struct workqueue_struct *dio_unwritten_wq;
+
+	/* Lazy inode table initialization info */
+	struct ext4_li_request *s_li_request;
+	/* Wait multiplier for lazy initialization thread */
+	unsigned int s_li_wait_mult;
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1260,6 +1274,15 @@ EXT4_INODE_BIT_FNS(state, state_flags)
 
 #define EXT4_DEF_INODE_READAHEAD_BLKS	32
 
+/*
+ * Lazy inode table initialization: after zeroing one group the thread
+ * sleeps for EXT4_DEF_LI_WAIT_MULT times as long as the zeroing took,
+ * and the first run of a newly mounted fs is delayed by a random
+ * amount of up to EXT4_DEF_LI_MAX_START_DELAY seconds.
+ */
+#define EXT4_DEF_LI_WAIT_MULT			10
+#define EXT4_DEF_LI_MAX_START_DELAY		5
+
 /*
  * Default mount options
  */
@@ -1499,6 +1522,8 @@ extern unsigned ext4_init_inode_bitmap(struct super_block *sb,
 				       ext4_group_t group,
 				       struct ext4_group_desc *desc);
 extern void mark_bitmap_end(int start_bit, int end_bit, char *bitmap);
+extern int ext4_init_inode_table(struct super_block *sb,
+				 ext4_group_t group, int barrier);
 
 /* mballoc.c */
 extern long ext4_mb_stats;
@@ -1555,6 +1580,8 @@ extern qsize_t *ext4_get_reserved_space(struct inode *inode);
 extern int flush_aio_dio_completed_IO(struct inode *inode);
 extern void ext4_da_update_reserve_space(struct inode *inode,
 					int used, int quota_claim);
+extern int ext4_da_reserve_space(struct inode *inode, sector_t lblock);
+extern void ext4_da_release_space(struct inode *inode, int to_free);
 /* ioctl.c */
 extern long ext4_ioctl(struct file *, unsigned int, unsigned long);
 extern long ext4_compat_ioctl(struct file *, unsigned int, unsigned long);
@@ -1789,6 +1816,79 @@ static inline int ext4_fs_is_busy(struct ext4_sb_info *sbi)
 	return (atomic_read(&sbi->s_lock_busy) > EXT4_CONTENTION_THRESHOLD);
 }
 
+/*
+ * Allocator statistics collected while an mb_bench run is active.  Each
+ * counted operation is followed by the item holding its total time in ns.
+ */
+enum ext4_mb_bench_item {
+	MB_BENCH_NEW_BLOCKS,		/* ext4_mb_new_blocks() calls */
+	MB_BENCH_NEW_BLOCKS_NS,
+	MB_BENCH_SCANS,			/* ext4_mb_regular_allocator() calls */
+	MB_BENCH_SCAN_NS,
+	MB_BENCH_SCAN_GROUPS,		/* groups whose buddy was searched */
+	MB_BENCH_LOCKS,			/* group lock acquisitions */
+	MB_BENCH_LOCK_CONTENDED,	/* ... of which had to spin */
+	MB_BENCH_LOCK_WAIT_NS,
+	MB_BENCH_NR_ITEMS
+};
+
+struct ext4_mb_bench_stats {
+	u64 item[MB_BENCH_NR_ITEMS];
+};
+
+#ifdef CONFIG_EXT4_MB_BENCH
+extern void ext4_mb_bench_register(struct super_block *sb);
+extern void ext4_mb_bench_unregister(struct super_block *sb);
+
+static inline void ext4_mb_bench_add(struct super_block *sb,
+				     enum ext4_mb_bench_item item, u64 val)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	if (unlikely(sbi->s_mb_bench_active)) {
+		per_cpu_ptr(sbi->s_mb_bench_stats, get_cpu())->item[item] += val;
+		put_cpu();
+	}
+}
+
+static inline u64 ext4_mb_bench_clock(struct super_block *sb)
+{
+	if (likely(!EXT4_SB(sb)->s_mb_bench_active))
+		return 0;
+	return ktime_to_ns(ktime_get());
+}
+
+/* account one @item operation which started at @start */
+static inline void ext4_mb_bench_end(struct super_block *sb,
+				     enum ext4_mb_bench_item item, u64 start)
+{
+	if (start) {
+		ext4_mb_bench_add(sb, item, 1);
+		ext4_mb_bench_add(sb, item + 1,
+				  ktime_to_ns(ktime_get()) - start);
+	}
+}
+#else
+static inline void ext4_mb_bench_register(struct super_block *sb)
+{
+}
+static inline void ext4_mb_bench_unregister(struct super_block *sb)
+{
+}
+static inline void ext4_mb_bench_add(struct super_block *sb,
+				     enum ext4_mb_bench_item item, u64 val)
+{
+}
+static inline u64 ext4_mb_bench_clock(struct super_block *sb)
+{
+	return 0;
+}
+static inline void ext4_mb_bench_end(struct super_block *sb,
+				     enum ext4_mb_bench_item item, u64 start)
+{
+}
+#endif
+
 static inline void ext4_lock_group(struct super_block *sb, ext4_group_t group)
 {
 	spinlock_t *lock = ext4_group_lock_ptr(sb, group);
@@ -1799,6 +1899,8 @@ static inline void ext4_lock_group(struct super_block *sb, ext4_group_t group)
 		 */
 		atomic_add_unless(&EXT4_SB(sb)->s_lock_busy, -1, 0);
 	else {
+		u64 start = ext4_mb_bench_clock(sb);
+
 		/*
 		 * The lock is busy, so bump the contention counter,
 		 * and then wait on the spin lock.
@@ -1806,7 +1908,9 @@ static inline void ext4_lock_group(struct super_block *sb, ext4_group_t group)
 		atomic_add_unless(&EXT4_SB(sb)->s_lock_busy, 1,
 				  EXT4_MAX_CONTENTION);
 		spin_lock(lock);
+		ext4_mb_bench_end(sb, MB_BENCH_LOCK_CONTENDED, start);
 	}
+	ext4_mb_bench_add(sb, MB_BENCH_LOCKS, 1);
 }
 
 static inline void ext4_unlock_group(struct super_block *sb,
@@ -1864,6 +1968,8 @@ extern int ext4_get_blocks(handle_t *handle, struct inode *inode,
 			   struct buffer_head *bh, int flags);
 extern int ext4_fiemap(struct inode *inode, struct fiemap_extent_info *fieinfo,
 			__u64 start, __u64 len);
+extern int ext4_issue_zeroout(struct super_block *sb, ext4_fsblk_t pblk,
+			      unsigned int len);
 /* move_extent.c */
 extern int ext4_move_extents(struct file *o_filp, struct file *d_filp,
 			     __u64 start_orig, __u64 start_donor,
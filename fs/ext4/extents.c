@@ -2448,42 +2448,48 @@ static void bi_complete(struct bio *bio, int error)
 	complete((struct completion *)bio->bi_private);
 }
 
-/* FIXME!! we need to try to merge to left or right after zero-out  */
-static int ext4_ext_zeroout(struct inode *inode, struct ext4_extent *ex)
+/**
+ * ext4_issue_zeroout() - write zeroes to a range of physical blocks
+ * @sb:		super block of the filesystem
+ * @pblk:	first physical block to zero
+ * @len:	number of blocks to zero
+ *
+ * The writes bypass the buffer cache and are waited upon; returns 0 or a
+ * negative error code.
+ */
+int ext4_issue_zeroout(struct super_block *sb, ext4_fsblk_t pblk,
+		       unsigned int len)
 {
 	int ret;
 	struct bio *bio;
 	int blkbits, blocksize;
-	sector_t ee_pblock;
+	sector_t sector;
 	struct completion event;
-	unsigned int ee_len, len, done, offset;
-
+	unsigned int batch, done, offset;
 
-	blkbits   = inode->i_blkbits;
-	blocksize = inode->i_sb->s_blocksize;
-	ee_len    = ext4_ext_get_actual_len(ex);
-	ee_pblock = ext_pblock(ex);
+	blkbits   = sb->s_blocksize_bits;
+	blocksize = sb->s_blocksize;
 
-	/* convert ee_pblock to 512 byte sectors */
-	ee_pblock = ee_pblock << (blkbits - 9);
+	/* convert pblk to 512 byte sectors */
+	sector = (sector_t)pblk << (blkbits - 9);
 
-	while (ee_len > 0) {
+	while (len > 0) {
 
-		if (ee_len > BIO_MAX_PAGES)
-			len = BIO_MAX_PAGES;
+		if (len > BIO_MAX_PAGES)
+			batch = BIO_MAX_PAGES;
 		else
-			len = ee_len;
+			batch = len;
 
-		bio = bio_alloc(GFP_NOIO, len);
+		bio = bio_alloc(GFP_NOIO, batch);
 		if (!bio)
 			return -ENOMEM;
 
-		bio->bi_sector = ee_pblock;
-		bio->bi_bdev   = inode->i_sb->s_bdev;
+		bio->bi_sector = sector;
+		bio->bi_bdev   = sb->s_bdev;
 
 		done = 0;
 		offset = 0;
-		while (done < len) {
+		while (done < batch) {
 			ret = bio_add_page(bio, ZERO_PAGE(0),
 							blocksize, offset);
 			if (ret != blocksize) {
@@ -2510,12 +2516,19 @@ static int ext4_ext_zeroout(struct inode *inode, struct ext4_extent *ex)
 			return -EIO;
 		}
 		bio_put(bio);
-		ee_len    -= done;
-		ee_pblock += done  << (blkbits - 9);
+		len    -= done;
+		sector += done  << (blkbits - 9);
 	}
 	return 0;
 }
 
+/* FIXME!! we need to try to merge to left or right after zero-out  */
+static int ext4_ext_zeroout(struct inode *inode, struct ext4_extent *ex)
+{
+	return ext4_issue_zeroout(inode->i_sb, ext_pblock(ex),
+				  ext4_ext_get_actual_len(ex));
+}
+
 #define EXT4_EXT_ZERO_LEN 7
 /*
  * This function is called by ext4_ext_get_blocks() if someone tries to write
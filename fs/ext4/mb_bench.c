@@ -0,0 +1,820 @@
+/*
+ *  linux/fs/ext4/mb_bench.c
+ *
+ * Synthetic allocation workloads for the multiblock allocator.
+ *
+ * Writing a workload description to <debugfs>/ext4/<dev>/mb_bench runs it
+ * against that filesystem; reading the file returns the results of the
+ * last run:
+ *
+ *   # echo "append threads=8 blocks=16384 chunk=4" > \
+ *		/sys/kernel/debug/ext4/sdb1/mb_bench
+ *   # cat /sys/kernel/debug/ext4/sdb1/mb_bench
+ *
+ * Workloads:
+ *   append	each thread appends @chunk blocks at a time to each of its
+ *		@files files in turn, until all of them are @blocks long
+ *   smallfiles	each thread creates @files files of @blocks blocks, one
+ *		after the other
+ *   random	like append, but every file is written in a random chunk
+ *		order, so it is extended at random offsets
+ *
+ * With "delalloc" blocks are only reserved when they are written and get
+ * allocated once @flush contiguous blocks have accumulated, like delayed
+ * allocation writeback maps them.
+ *
+ * The files are unlinked orphans which are deleted at the end of the run.
+ * The allocator statistics include every allocation done on the filesystem
+ * while the run is active, not only those of the benchmark threads.
+ */
+
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/kthread.h>
+#include <linux/kref.h>
+#include <linux/parser.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
+#include <linux/buffer_head.h>
+#include <linux/uaccess.h>
+#include "ext4_jbd2.h"
+#include "ext4.h"
+#include "mballoc.h"
+
+#define MB_BENCH_MAX_THREADS	64
+#define MB_BENCH_MAX_FILES	65536		/* over all threads */
+#define MB_BENCH_MAX_BLOCKS	(1U << 20)	/* per file */
+#define MB_BENCH_MAX_LISTED	256		/* files listed in the report */
+#define MB_BENCH_REPORT_SIZE	16384
+
+enum { MB_BENCH_APPEND, MB_BENCH_SMALLFILES, MB_BENCH_RANDOM };
+
+static const char *mb_bench_workloads[] = { "append", "smallfiles", "random" };
+
+struct ext4_mb_bench {
+	struct kref		kref;
+	struct mutex		run_lock;	/* one run at a time */
+	struct super_block	*sb;		/* NULL once unmounted */
+	struct dentry		*dir;
+	struct dentry		*file;
+	char			*report;	/* results of the last run */
+	size_t			report_len;
+};
+
+/* protects ->sb and the debugfs inode's i_private */
+static DEFINE_MUTEX(mb_bench_mutex);
+
+struct mb_bench_params {
+	int		workload;
+	unsigned int	threads;
+	unsigned int	files;		/* per thread */
+	unsigned int	blocks;		/* per file */
+	unsigned int	chunk;		/* blocks per write */
+	unsigned int	flush;		/* delalloc blocks per allocation */
+	int		delalloc;
+};
+
+struct mb_bench_file {
+	struct inode	*inode;
+	unsigned int	done;		/* chunks written */
+	ext4_lblk_t	pend_start;	/* reserved but not yet allocated */
+	unsigned int	pend_len;
+	unsigned int	extents;
+};
+
+struct mb_bench_run;
+
+struct mb_bench_worker {
+	struct mb_bench_run	*run;
+	struct mb_bench_file	*files;
+	u32			*order;		/* chunk order for "random" */
+	int			err;
+};
+
+struct mb_bench_run {
+	struct super_block	*sb;
+	struct mb_bench_params	p;
+	unsigned int		nchunks;	/* chunks per file */
+	atomic_long_t		allocated;
+	atomic_t		running;
+	int			abort;
+	struct completion	done;
+	struct mb_bench_worker	*workers;
+	struct mb_bench_file	*files;
+};
+
+static int mb_bench_create(struct mb_bench_run *run, struct mb_bench_file *f)
+{
+	struct inode *dir = run->sb->s_root->d_inode;
+	struct inode *inode;
+	handle_t *handle;
+	int err;
+
+	handle = ext4_journal_start(dir, EXT4_DATA_TRANS_BLOCKS(dir->i_sb) +
+					EXT4_INDEX_EXTRA_TRANS_BLOCKS + 3 +
+					EXT4_MAXQUOTAS_INIT_BLOCKS(dir->i_sb));
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	inode = ext4_new_inode(handle, dir, S_IFREG | S_IRUSR | S_IWUSR,
+			       NULL, 0);
+	err = PTR_ERR(inode);
+	if (!IS_ERR(inode)) {
+		inode->i_op = &ext4_file_inode_operations;
+		inode->i_fop = &ext4_file_operations;
+		ext4_set_aops(inode);
+		/* never linked: the orphan list deletes it after a crash */
+		clear_nlink(inode);
+		err = ext4_orphan_add(handle, inode);
+		ext4_mark_inode_dirty(handle, inode);
+		unlock_new_inode(inode);
+		if (err)
+			iput(inode);
+		else
+			f->inode = inode;
+	}
+	ext4_journal_stop(handle);
+	return err;
+}
+
+/*
+ * Allocate *len blocks at *lblk, advancing both as blocks get allocated
+ * so that the caller knows what is left if we fail half way.
+ */
+static int mb_bench_alloc(struct mb_bench_run *run, struct inode *inode,
+			  ext4_lblk_t *lblk, unsigned int *len, int flags)
+{
+	struct buffer_head bh;
+	handle_t *handle;
+	loff_t end;
+	int ret;
+
+	while (*len) {
+		unsigned int n = *len;
+
+		if (!ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS) &&
+		    n > EXT4_MAX_TRANS_DATA)
+			n = EXT4_MAX_TRANS_DATA;
+
+		handle = ext4_journal_start(inode,
+					    ext4_chunk_trans_blocks(inode, n));
+		if (IS_ERR(handle))
+			return PTR_ERR(handle);
+
+		memset(&bh, 0, sizeof(bh));
+		ret = ext4_get_blocks(handle, inode, *lblk, n, &bh,
+				      EXT4_GET_BLOCKS_CREATE | flags);
+		if (ret > 0) {
+			end = (loff_t)(*lblk + ret) << inode->i_blkbits;
+			if (end > i_size_read(inode))
+				i_size_write(inode, end);
+			ext4_update_i_disksize(inode, end);
+			ext4_mark_inode_dirty(handle, inode);
+			atomic_long_add(ret, &run->allocated);
+			*lblk += ret;
+			*len -= ret;
+		} else if (ret == 0)
+			ret = -ENOSPC;
+		ext4_journal_stop(handle);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+static int mb_bench_flush(struct mb_bench_run *run, struct mb_bench_file *f)
+{
+	return mb_bench_alloc(run, f->inode, &f->pend_start, &f->pend_len,
+			      EXT4_GET_BLOCKS_DELALLOC_RESERVE);
+}
+
+/* the "write" half of delayed allocation: reserve now, allocate later */
+static int mb_bench_reserve(struct mb_bench_run *run, struct mb_bench_file *f,
+			    ext4_lblk_t lblk, unsigned int len)
+{
+	struct inode *inode = f->inode;
+	loff_t end;
+	int err;
+
+	if (f->pend_len && lblk != f->pend_start + f->pend_len) {
+		err = mb_bench_flush(run, f);
+		if (err)
+			return err;
+	}
+	if (!f->pend_len)
+		f->pend_start = lblk;
+	while (len--) {
+		err = ext4_da_reserve_space(inode, f->pend_start + f->pend_len);
+		if (err)
+			return err;
+		f->pend_len++;
+	}
+
+	end = (loff_t)(f->pend_start + f->pend_len) << inode->i_blkbits;
+	if (end > i_size_read(inode))
+		i_size_write(inode, end);
+
+	if (f->pend_len >= run->p.flush)
+		return mb_bench_flush(run, f);
+	return 0;
+}
+
+/* write the next chunk of @f */
+static int mb_bench_step(struct mb_bench_worker *w, struct mb_bench_file *f)
+{
+	struct mb_bench_run *run = w->run;
+	unsigned int k = f->done, len;
+	ext4_lblk_t lblk;
+	int err;
+
+	if (run->abort)
+		return -EINTR;
+
+	if (w->order)
+		k = w->order[k];
+	lblk = k * run->p.chunk;
+	len = min(run->p.chunk, run->p.blocks - lblk);
+	f->done++;
+
+	if (run->p.delalloc)
+		err = mb_bench_reserve(run, f, lblk, len);
+	else
+		err = mb_bench_alloc(run, f->inode, &lblk, &len, 0);
+	if (!err && f->done == run->nchunks)
+		err = mb_bench_flush(run, f);
+	cond_resched();
+	return err;
+}
+
+static int mb_bench_worker(void *data)
+{
+	struct mb_bench_worker *w = data;
+	struct mb_bench_run *run = w->run;
+	unsigned int i, left;
+	int err = 0;
+
+	if (run->p.workload == MB_BENCH_SMALLFILES) {
+		for (i = 0; i < run->p.files && !err; i++) {
+			err = mb_bench_create(run, &w->files[i]);
+			while (!err && w->files[i].done < run->nchunks)
+				err = mb_bench_step(w, &w->files[i]);
+		}
+		goto out;
+	}
+
+	for (i = 0; i < run->p.files && !err; i++)
+		err = mb_bench_create(run, &w->files[i]);
+
+	left = run->p.files;
+	while (!err && left) {
+		for (i = 0; i < run->p.files && !err; i++) {
+			if (w->files[i].done == run->nchunks)
+				continue;
+			err = mb_bench_step(w, &w->files[i]);
+			if (w->files[i].done == run->nchunks)
+				left--;
+		}
+	}
+out:
+	w->err = err;
+	if (atomic_dec_and_test(&run->running))
+		complete(&run->done);
+	return 0;
+}
+
+/* number of physically discontiguous runs of blocks in the file */
+static unsigned int mb_bench_count_extents(struct inode *inode,
+					   unsigned int blocks)
+{
+	struct buffer_head bh;
+	ext4_fsblk_t next = 0;
+	ext4_lblk_t lblk = 0;
+	unsigned int extents = 0;
+	int ret;
+
+	while (lblk < blocks) {
+		memset(&bh, 0, sizeof(bh));
+		ret = ext4_get_blocks(NULL, inode, lblk, blocks - lblk, &bh, 0);
+		if (ret < 0)
+			break;
+		if (ret == 0 || !buffer_mapped(&bh)) {
+			next = 0;
+			lblk++;
+			continue;
+		}
+		if (bh.b_blocknr != next)
+			extents++;
+		next = bh.b_blocknr + ret;
+		lblk += ret;
+	}
+	return extents;
+}
+
+static void mb_bench_stats_reset(struct ext4_sb_info *sbi)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(sbi->s_mb_bench_stats, cpu), 0,
+		       sizeof(struct ext4_mb_bench_stats));
+}
+
+static void mb_bench_stats_sum(struct ext4_sb_info *sbi, u64 *sum)
+{
+	struct ext4_mb_bench_stats *stats;
+	int cpu, i;
+
+	memset(sum, 0, sizeof(u64) * MB_BENCH_NR_ITEMS);
+	for_each_possible_cpu(cpu) {
+		stats = per_cpu_ptr(sbi->s_mb_bench_stats, cpu);
+		for (i = 0; i < MB_BENCH_NR_ITEMS; i++)
+			sum[i] += stats->item[i];
+	}
+}
+
+/* the s_bal_* counters are only maintained with mb_stats enabled */
+enum {
+	MB_BAL_REQS, MB_BAL_SUCCESS, MB_BAL_EX_SCANNED, MB_BAL_GOALS,
+	MB_BAL_BREAKS, MB_BAL_2ORDERS, MB_BAL_PREALLOCATED, MB_BAL_DISCARDED,
+	MB_BAL_NR
+};
+
+static void mb_bench_bal_snapshot(struct ext4_sb_info *sbi, unsigned int *v)
+{
+	v[MB_BAL_REQS] = atomic_read(&sbi->s_bal_reqs);
+	v[MB_BAL_SUCCESS] = atomic_read(&sbi->s_bal_success);
+	v[MB_BAL_EX_SCANNED] = atomic_read(&sbi->s_bal_ex_scanned);
+	v[MB_BAL_GOALS] = atomic_read(&sbi->s_bal_goals);
+	v[MB_BAL_BREAKS] = atomic_read(&sbi->s_bal_breaks);
+	v[MB_BAL_2ORDERS] = atomic_read(&sbi->s_bal_2orders);
+	v[MB_BAL_PREALLOCATED] = atomic_read(&sbi->s_mb_preallocated);
+	v[MB_BAL_DISCARDED] = atomic_read(&sbi->s_mb_discarded);
+}
+
+static u64 mb_bench_avg(u64 total, u64 nr)
+{
+	return nr ? div64_u64(total, nr) : 0;
+}
+
+static size_t mb_bench_report(struct mb_bench_run *run, char *buf,
+			      u64 elapsed_ns, unsigned int *bal, int err)
+{
+	static const char *hist_names[] = {
+		"1", "2", "3-4", "5-8", "9-16", "17-32", "33-64", ">64"
+	};
+	struct mb_bench_params *p = &run->p;
+	struct ext4_sb_info *sbi = EXT4_SB(run->sb);
+	unsigned int nr_files = p->threads * p->files;
+	unsigned int hist[ARRAY_SIZE(hist_names)] = { 0 };
+	unsigned int lo = UINT_MAX, hi = 0, counted = 0;
+	unsigned int now[MB_BAL_NR];
+	unsigned long long total = 0;
+	u64 st[MB_BENCH_NR_ITEMS];
+	size_t len = 0, size = MB_BENCH_REPORT_SIZE;
+	unsigned int i;
+
+	for (i = 0; i < nr_files; i++) {
+		unsigned int e = run->files[i].extents;
+
+		if (!run->files[i].inode)
+			continue;
+		counted++;
+		total += e;
+		lo = min(lo, e);
+		hi = max(hi, e);
+		hist[e <= 1 ? 0 : min_t(int, fls(e - 1),
+					ARRAY_SIZE(hist_names) - 1)]++;
+	}
+	if (!counted)
+		lo = 0;
+
+	len += scnprintf(buf + len, size - len,
+			 "workload: %s threads=%u files=%u blocks=%u chunk=%u",
+			 mb_bench_workloads[p->workload], p->threads,
+			 p->files, p->blocks, p->chunk);
+	if (p->delalloc)
+		len += scnprintf(buf + len, size - len,
+				 " delalloc flush=%u", p->flush);
+	len += scnprintf(buf + len, size - len, "\n");
+	if (err)
+		len += scnprintf(buf + len, size - len, "error: %d\n", err);
+	len += scnprintf(buf + len, size - len,
+			 "elapsed_ms: %llu\nblocks_allocated: %ld\n",
+			 (unsigned long long)div_u64(elapsed_ns, NSEC_PER_MSEC),
+			 atomic_long_read(&run->allocated));
+
+	len += scnprintf(buf + len, size - len,
+			 "files: %u\nextents: total %llu min %u avg %llu max %u\n",
+			 counted, total, lo,
+			 (unsigned long long)mb_bench_avg(total, counted), hi);
+	len += scnprintf(buf + len, size - len, "extents_per_file:");
+	for (i = 0; i < ARRAY_SIZE(hist_names); i++)
+		len += scnprintf(buf + len, size - len, " %s:%u",
+				 hist_names[i], hist[i]);
+	len += scnprintf(buf + len, size - len, "\n");
+
+	mb_bench_stats_sum(sbi, st);
+	len += scnprintf(buf + len, size - len,
+			 "mb_new_blocks: calls %llu avg_ns %llu\n",
+			 (unsigned long long)st[MB_BENCH_NEW_BLOCKS],
+			 (unsigned long long)
+			 mb_bench_avg(st[MB_BENCH_NEW_BLOCKS_NS],
+				      st[MB_BENCH_NEW_BLOCKS]));
+	len += scnprintf(buf + len, size - len,
+			 "buddy_scan: calls %llu groups %llu avg_ns %llu\n",
+			 (unsigned long long)st[MB_BENCH_SCANS],
+			 (unsigned long long)st[MB_BENCH_SCAN_GROUPS],
+			 (unsigned long long)
+			 mb_bench_avg(st[MB_BENCH_SCAN_NS], st[MB_BENCH_SCANS]));
+	len += scnprintf(buf + len, size - len,
+			 "group_lock: acquired %llu contended %llu "
+			 "wait_ns %llu avg_wait_ns %llu\n",
+			 (unsigned long long)st[MB_BENCH_LOCKS],
+			 (unsigned long long)st[MB_BENCH_LOCK_CONTENDED],
+			 (unsigned long long)st[MB_BENCH_LOCK_WAIT_NS],
+			 (unsigned long long)mb_bench_avg(st[MB_BENCH_LOCK_WAIT_NS],
+				      st[MB_BENCH_LOCK_CONTENDED]));
+
+	mb_bench_bal_snapshot(sbi, now);
+	len += scnprintf(buf + len, size - len,
+			 "preallocation: preallocated %u discarded %u\n",
+			 now[MB_BAL_PREALLOCATED] - bal[MB_BAL_PREALLOCATED],
+			 now[MB_BAL_DISCARDED] - bal[MB_BAL_DISCARDED]);
+	if (sbi->s_mb_stats)
+		len += scnprintf(buf + len, size - len,
+				 "mb_stats: reqs %u success %u extents_scanned %u "
+				 "goal_hits %u 2^n_hits %u breaks %u\n",
+				 now[MB_BAL_REQS] - bal[MB_BAL_REQS],
+				 now[MB_BAL_SUCCESS] - bal[MB_BAL_SUCCESS],
+				 now[MB_BAL_EX_SCANNED] - bal[MB_BAL_EX_SCANNED],
+				 now[MB_BAL_GOALS] - bal[MB_BAL_GOALS],
+				 now[MB_BAL_2ORDERS] - bal[MB_BAL_2ORDERS],
+				 now[MB_BAL_BREAKS] - bal[MB_BAL_BREAKS]);
+
+	len += scnprintf(buf + len, size - len, "thread/file: extents\n");
+	for (i = 0; i < nr_files && i < MB_BENCH_MAX_LISTED; i++) {
+		if (!run->files[i].inode)
+			continue;
+		len += scnprintf(buf + len, size - len, "%u/%u: %u\n",
+				 i / p->files, i % p->files,
+				 run->files[i].extents);
+	}
+	if (nr_files > MB_BENCH_MAX_LISTED)
+		len += scnprintf(buf + len, size - len, "...\n");
+	return len;
+}
+
+static int mb_bench_run(struct ext4_mb_bench *bench, struct super_block *sb,
+			struct mb_bench_params *p)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned int nr_files = p->threads * p->files;
+	unsigned int bal[MB_BAL_NR];
+	struct mb_bench_run *run;
+	struct task_struct *task;
+	unsigned int i, j;
+	char *report;
+	ktime_t start;
+	u64 elapsed;
+	int err = 0;
+
+	report = kmalloc(MB_BENCH_REPORT_SIZE, GFP_KERNEL);
+	run = kzalloc(sizeof(*run), GFP_KERNEL);
+	if (!report || !run)
+		goto out_nomem;
+	run->sb = sb;
+	run->p = *p;
+	run->nchunks = DIV_ROUND_UP(p->blocks, p->chunk);
+	atomic_long_set(&run->allocated, 0);
+	init_completion(&run->done);
+
+	run->workers = kcalloc(p->threads, sizeof(*run->workers), GFP_KERNEL);
+	run->files = vmalloc(nr_files * sizeof(*run->files));
+	if (!run->workers || !run->files)
+		goto out_nomem;
+	memset(run->files, 0, nr_files * sizeof(*run->files));
+
+	for (i = 0; i < p->threads; i++) {
+		struct mb_bench_worker *w = &run->workers[i];
+
+		w->run = run;
+		w->files = run->files + i * p->files;
+		if (p->workload != MB_BENCH_RANDOM)
+			continue;
+		w->order = vmalloc(run->nchunks * sizeof(u32));
+		if (!w->order)
+			goto out_nomem;
+		for (j = 0; j < run->nchunks; j++)
+			w->order[j] = j;
+		for (j = run->nchunks - 1; j > 0; j--)
+			swap(w->order[j], w->order[random32() % (j + 1)]);
+	}
+
+	mb_bench_bal_snapshot(sbi, bal);
+	mb_bench_stats_reset(sbi);
+	sbi->s_mb_bench_active = 1;
+	start = ktime_get();
+
+	/* the extra count is dropped once all threads have been started */
+	atomic_set(&run->running, 1);
+	for (i = 0; i < p->threads; i++) {
+		atomic_inc(&run->running);
+		task = kthread_run(mb_bench_worker, &run->workers[i],
+				   "ext4-mbbench/%u", i);
+		if (IS_ERR(task)) {
+			atomic_dec(&run->running);
+			err = PTR_ERR(task);
+			run->abort = 1;
+			break;
+		}
+	}
+	if (atomic_dec_and_test(&run->running))
+		complete(&run->done);
+	if (wait_for_completion_killable(&run->done)) {
+		run->abort = 1;
+		wait_for_completion(&run->done);
+	}
+
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+	sbi->s_mb_bench_active = 0;
+
+	for (i = 0; i < p->threads && !err; i++)
+		err = run->workers[i].err;
+	for (i = 0; i < nr_files; i++)
+		if (run->files[i].inode)
+			run->files[i].extents =
+				mb_bench_count_extents(run->files[i].inode,
+						       p->blocks);
+
+	kfree(bench->report);
+	bench->report_len = mb_bench_report(run, report, elapsed, bal, err);
+	bench->report = report;
+	report = NULL;
+
+	for (i = 0; i < nr_files; i++) {
+		struct mb_bench_file *f = &run->files[i];
+
+		if (!f->inode)
+			continue;
+		if (f->pend_len)
+			ext4_da_release_space(f->inode, f->pend_len);
+		iput(f->inode);
+	}
+	goto out;
+
+out_nomem:
+	err = -ENOMEM;
+out:
+	if (run) {
+		for (i = 0; run->workers && i < p->threads; i++)
+			vfree(run->workers[i].order);
+		kfree(run->workers);
+		vfree(run->files);
+		kfree(run);
+	}
+	kfree(report);
+	return err;
+}
+
+enum {
+	Opt_append, Opt_smallfiles, Opt_random, Opt_threads, Opt_files,
+	Opt_blocks, Opt_chunk, Opt_delalloc, Opt_flush, Opt_err
+};
+
+static const match_table_t tokens = {
+	{Opt_append, "append"},
+	{Opt_smallfiles, "smallfiles"},
+	{Opt_random, "random"},
+	{Opt_threads, "threads=%u"},
+	{Opt_files, "files=%u"},
+	{Opt_blocks, "blocks=%u"},
+	{Opt_chunk, "chunk=%u"},
+	{Opt_delalloc, "delalloc"},
+	{Opt_flush, "flush=%u"},
+	{Opt_err, NULL},
+};
+
+static int mb_bench_parse(char *options, struct mb_bench_params *p)
+{
+	substring_t args[MAX_OPT_ARGS];
+	unsigned int *val;
+	char *s;
+	int token, n;
+
+	memset(p, 0, sizeof(*p));
+	p->workload = -1;
+	while ((s = strsep(&options, " \t\n")) != NULL) {
+		if (!*s)
+			continue;
+		token = match_token(s, tokens, args);
+		switch (token) {
+		case Opt_append:
+		case Opt_smallfiles:
+		case Opt_random:
+			p->workload = token - Opt_append;
+			continue;
+		case Opt_delalloc:
+			p->delalloc = 1;
+			continue;
+		case Opt_threads:
+			val = &p->threads;
+			break;
+		case Opt_files:
+			val = &p->files;
+			break;
+		case Opt_blocks:
+			val = &p->blocks;
+			break;
+		case Opt_chunk:
+			val = &p->chunk;
+			break;
+		case Opt_flush:
+			val = &p->flush;
+			break;
+		default:
+			return -EINVAL;
+		}
+		if (match_int(&args[0], &n) || n <= 0)
+			return -EINVAL;
+		*val = n;
+	}
+	if (p->workload < 0)
+		return -EINVAL;
+
+	if (!p->threads)
+		p->threads = 4;
+	if (!p->files)
+		p->files = p->workload == MB_BENCH_SMALLFILES ? 256 : 1;
+	if (!p->blocks)
+		p->blocks = p->workload == MB_BENCH_SMALLFILES ? 4 : 4096;
+	if (!p->chunk)
+		p->chunk = 16;
+	if (!p->flush)
+		p->flush = 1024;
+	p->chunk = min(p->chunk, p->blocks);
+
+	if (p->threads > MB_BENCH_MAX_THREADS ||
+	    p->files > MB_BENCH_MAX_FILES / p->threads ||
+	    p->blocks > MB_BENCH_MAX_BLOCKS)
+		return -EINVAL;
+	return 0;
+}
+
+static int mb_bench_open(struct inode *inode, struct file *file)
+{
+	struct ext4_mb_bench *bench;
+
+	mutex_lock(&mb_bench_mutex);
+	bench = inode->i_private;
+	if (bench)
+		kref_get(&bench->kref);
+	mutex_unlock(&mb_bench_mutex);
+	if (!bench)
+		return -ENODEV;
+	file->private_data = bench;
+	return 0;
+}
+
+static void mb_bench_free(struct kref *kref)
+{
+	struct ext4_mb_bench *bench =
+		container_of(kref, struct ext4_mb_bench, kref);
+
+	kfree(bench->report);
+	kfree(bench);
+}
+
+static int mb_bench_release(struct inode *inode, struct file *file)
+{
+	struct ext4_mb_bench *bench = file->private_data;
+
+	kref_put(&bench->kref, mb_bench_free);
+	return 0;
+}
+
+static ssize_t mb_bench_read(struct file *file, char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct ext4_mb_bench *bench = file->private_data;
+	ssize_t ret = 0;
+
+	if (mutex_lock_interruptible(&bench->run_lock))
+		return -ERESTARTSYS;
+	if (bench->report)
+		ret = simple_read_from_buffer(buf, count, ppos, bench->report,
+					      bench->report_len);
+	mutex_unlock(&bench->run_lock);
+	return ret;
+}
+
+static ssize_t mb_bench_write(struct file *file, const char __user *ubuf,
+			      size_t count, loff_t *ppos)
+{
+	struct ext4_mb_bench *bench = file->private_data;
+	struct mb_bench_params p;
+	struct super_block *sb;
+	char buf[128];
+	int err;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	err = mb_bench_parse(buf, &p);
+	if (err)
+		return err;
+
+	if (!mutex_trylock(&bench->run_lock))
+		return -EBUSY;
+
+	/*
+	 * Holding s_umount keeps the filesystem mounted (and writable) for
+	 * the duration of the run.  Unmount calls ext4_mb_bench_unregister()
+	 * with s_umount held, so we must not sleep on it under mb_bench_mutex.
+	 */
+	mutex_lock(&mb_bench_mutex);
+	sb = bench->sb;
+	if (!sb)
+		err = -ENODEV;
+	else if (!down_read_trylock(&sb->s_umount))
+		err = -EBUSY;
+	mutex_unlock(&mb_bench_mutex);
+	if (err)
+		goto out;
+
+	if (sb->s_flags & MS_RDONLY)
+		err = -EROFS;
+	else
+		err = mb_bench_run(bench, sb, &p);
+	up_read(&sb->s_umount);
+out:
+	mutex_unlock(&bench->run_lock);
+	return err ? err : count;
+}
+
+static const struct file_operations mb_bench_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mb_bench_open,
+	.release	= mb_bench_release,
+	.read		= mb_bench_read,
+	.write		= mb_bench_write,
+};
+
+void ext4_mb_bench_register(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_mb_bench *bench;
+
+	if (!ext4_debugfs_dir)
+		return;
+
+	bench = kzalloc(sizeof(*bench), GFP_KERNEL);
+	if (!bench)
+		return;
+	sbi->s_mb_bench_stats = alloc_percpu(struct ext4_mb_bench_stats);
+	if (!sbi->s_mb_bench_stats)
+		goto out_free;
+
+	kref_init(&bench->kref);
+	mutex_init(&bench->run_lock);
+	bench->sb = sb;
+	bench->dir = debugfs_create_dir(sb->s_id, ext4_debugfs_dir);
+	if (!bench->dir)
+		goto out_stats;
+	bench->file = debugfs_create_file("mb_bench", S_IRUSR | S_IWUSR,
+					  bench->dir, bench, &mb_bench_fops);
+	if (!bench->file)
+		goto out_dir;
+	sbi->s_mb_bench = bench;
+	return;
+
+out_dir:
+	debugfs_remove(bench->dir);
+out_stats:
+	free_percpu(sbi->s_mb_bench_stats);
+	sbi->s_mb_bench_stats = NULL;
+out_free:
+	kfree(bench);
+}
+
+void ext4_mb_bench_unregister(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_mb_bench *bench = sbi->s_mb_bench;
+
+	if (!bench)
+		return;
+
+	mutex_lock(&mb_bench_mutex);
+	bench->sb = NULL;
+	bench->file->d_inode->i_private = NULL;
+	mutex_unlock(&mb_bench_mutex);
+
+	debugfs_remove(bench->file);
+	debugfs_remove(bench->dir);
+	free_percpu(sbi->s_mb_bench_stats);
+	sbi->s_mb_bench_stats = NULL;
+	sbi->s_mb_bench = NULL;
+	kref_put(&bench->kref, mb_bench_free);
+}
@@ -2484,6 +2484,7 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 
 	if (sbi->s_journal)
 		sbi->s_journal->j_commit_callback = release_blocks_on_commit;
+	ext4_mb_bench_register(sb);
 	return 0;
 }
 
@@ -2513,6 +2514,7 @@ int ext4_mb_release(struct super_block *sb)
 	struct ext4_group_info *grinfo;
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 
+	ext4_mb_bench_unregister(sb);
 	if (sbi->s_group_info) {
 		for (i = 0; i < ngroups; i++) {
 			grinfo = ext4_get_group_info(sb, i);
@@ -2630,26 +2632,30 @@ static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 	mb_debug(1, "freed %u blocks in %u structures\n", count, count2);
 }
 
+#if defined(CONFIG_EXT4_DEBUG) || defined(CONFIG_EXT4_MB_BENCH)
 #ifdef CONFIG_EXT4_DEBUG
 u8 mb_enable_debug __read_mostly;
+#endif
 
-static struct dentry *debugfs_dir;
+struct dentry *ext4_debugfs_dir;
 static struct dentry *debugfs_debug;
 
 static void __init ext4_create_debugfs_entry(void)
 {
-	debugfs_dir = debugfs_create_dir("ext4", NULL);
-	if (debugfs_dir)
+	ext4_debugfs_dir = debugfs_create_dir("ext4", NULL);
+#ifdef CONFIG_EXT4_DEBUG
+	if (ext4_debugfs_dir)
 		debugfs_debug = debugfs_create_u8("mballoc-debug",
 						  S_IRUGO | S_IWUSR,
-						  debugfs_dir,
+						  ext4_debugfs_dir,
 						  &mb_enable_debug);
+#endif
 }
 
 static void ext4_remove_debugfs_entry(void)
 {
 	debugfs_remove(debugfs_debug);
-	debugfs_remove(debugfs_dir);
+	debugfs_remove(ext4_debugfs_dir);
 }
 
 #else
@@ -4278,11 +4284,13 @@ ext4_fsblk_t ext4_mb_new_blocks(handle_t *handle,
 	ext4_fsblk_t block = 0;
 	unsigned int inquota = 0;
 	unsigned int reserv_blks = 0;
+	u64 start, scan_start;
 
 	sb = ar->inode->i_sb;
 	sbi = EXT4_SB(sb);
 
 	trace_ext4_request_blocks(ar);
+	start = ext4_mb_bench_clock(sb);
 
 	/*
 	 * For delayed allocation, we could skip the ENOSPC and
@@ -4336,7 +4344,9 @@ ext4_fsblk_t ext4_mb_new_blocks(handle_t *handle,
 		ext4_mb_normalize_request(ac, ar);
 repeat:
 		/* allocate space in core */
+		scan_start = ext4_mb_bench_clock(sb);
 		ext4_mb_regular_allocator(ac);
+		ext4_mb_bench_end(sb, MB_BENCH_SCANS, scan_start);
 
 		/* as we've just preallocated more space than
 		 * user requested orinally, we store allocated
@@ -4377,6 +4387,7 @@ repeat:
 		ext4_mb_show_ac(ac);
 	}
 
+	ext4_mb_bench_add(sb, MB_BENCH_SCAN_GROUPS, ac->ac_groups_scanned);
 	ext4_mb_release_context(ac);
 
 out2:
@@ -4393,6 +4404,7 @@ out3:
 	}
 
 	trace_ext4_allocate_blocks(ar, (unsigned long long)block);
+	ext4_mb_bench_end(sb, MB_BENCH_NEW_BLOCKS, start);
 
 	return block;
 }
@@ -52,6 +52,10 @@ extern u8 mb_enable_debug;
 #define mb_debug(n, fmt, a...)
 #endif
 
+#if defined(CONFIG_EXT4_DEBUG) || defined(CONFIG_EXT4_MB_BENCH)
+extern struct dentry *ext4_debugfs_dir;
+#endif
+
 #define EXT4_MB_HISTORY_ALLOC		1	/* allocation */
 #define EXT4_MB_HISTORY_PREALLOC	2	/* preallocated blocks used */
 
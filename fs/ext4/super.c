@@ -39,6 +39,8 @@
 #include <linux/ctype.h>
 #include <linux/log2.h>
 #include <linux/crc16.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include <asm/uaccess.h>
 
 #include "ext4.h"
@@ -68,6 +70,7 @@ static int ext4_statfs(struct dentry *dentry, struct kstatfs *buf);
 static int ext4_unfreeze(struct super_block *sb);
 static void ext4_write_super(struct super_block *sb);
 static int ext4_freeze(struct super_block *sb);
+static void ext4_unregister_li_request(struct super_block *sb);
 
 
 ext4_fsblk_t ext4_block_bitmap(struct super_block *sb,
@@ -596,6 +599,8 @@ static void ext4_put_super(struct super_block *sb)
 	struct ext4_super_block *es = sbi->s_es;
 	int i, err;
 
+	ext4_unregister_li_request(sb);
+
 	flush_workqueue(sbi->dio_unwritten_wq);
 	destroy_workqueue(sbi->dio_unwritten_wq);
 
@@ -917,6 +922,12 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, NOLOAD))
 		seq_puts(seq, ",norecovery");
 
+	if (!test_opt(sb, INIT_INODE_TABLE))
+		seq_puts(seq, ",noinit_itable");
+	else if (sbi->s_li_wait_mult != EXT4_DEF_LI_WAIT_MULT)
+		seq_printf(seq, ",init_itable=%u",
+			   (unsigned) sbi->s_li_wait_mult);
+
 	ext4_show_quota_options(seq, sb);
 
 	return 0;
@@ -1101,6 +1112,7 @@ enum {
 	Opt_block_validity, Opt_noblock_validity,
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_discard, Opt_nodiscard,
+	Opt_init_inode_table, Opt_noinit_inode_table,
 };
 
 static const match_table_t tokens = {
@@ -1168,6 +1180,9 @@ static const match_table_t tokens = {
 	{Opt_noauto_da_alloc, "noauto_da_alloc"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_init_inode_table, "init_itable=%u"},
+	{Opt_init_inode_table, "init_itable"},
+	{Opt_noinit_inode_table, "noinit_itable"},
 	{Opt_err, NULL},
 };
 
@@ -1602,6 +1617,20 @@ set_qf_format:
 		case Opt_nodiscard:
 			clear_opt(sbi->s_mount_opt, DISCARD);
 			break;
+		case Opt_init_inode_table:
+			set_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+			if (args[0].from) {
+				if (match_int(&args[0], &option))
+					return 0;
+			} else
+				option = EXT4_DEF_LI_WAIT_MULT;
+			if (option < 0)
+				return 0;
+			sbi->s_li_wait_mult = option;
+			break;
+		case Opt_noinit_inode_table:
+			clear_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+			break;
 		default:
 			ext4_msg(sb, KERN_ERR,
 			       "Unrecognized mount option \"%s\" "
@@ -2352,6 +2381,276 @@ static int ext4_feature_set_ok(struct super_block *sb, int readonly)
 	return 1;
 }
 
+/*
+ * Lazy inode table initialization.
+ *
+ * mke2fs can leave the inode tables of uninit_bg filesystems unwritten;
+ * the groups are then missing EXT4_BG_INODE_ZEROED.  A single kernel
+ * thread, ext4lazyinit, walks every mounted filesystem that still has
+ * such groups and zeroes their inode tables one group at a time.  To
+ * keep the I/O rate down, after each group it sleeps for s_li_wait_mult
+ * times as long as zeroing the first group took (init_itable=n).
+ */
+struct ext4_li_request {
+	struct super_block	*lr_super;
+	struct list_head	lr_request;
+	unsigned long		lr_next_sched;	/* jiffies of the next run */
+	unsigned long		lr_timeout;	/* delay between groups */
+	ext4_group_t		lr_next_group;	/* first group to look at */
+};
+
+struct ext4_lazy_init {
+	struct task_struct	*li_task;
+	struct list_head	li_request_list;
+	struct mutex		li_list_mtx;
+};
+
+/* ext4_li_info is created and torn down under ext4_li_mtx */
+static struct ext4_lazy_init *ext4_li_info;
+static DEFINE_MUTEX(ext4_li_mtx);
+
+/*
+ * Zero the inode table of the next not yet zeroed group.  Returns
+ * non-zero when the request is finished, either because every group is
+ * done or because of an error.
+ */
+static int ext4_run_li_request(struct ext4_li_request *elr)
+{
+	struct super_block *sb = elr->lr_super;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ext4_group_t group, ngroups = sbi->s_groups_count;
+	struct ext4_group_desc *gdp = NULL;
+	ktime_t start;
+	u64 us;
+	int ret = 0;
+
+	for (group = elr->lr_next_group; group < ngroups; group++) {
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		if (!gdp) {
+			ret = 1;
+			break;
+		}
+
+		if (!(gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED)))
+			break;
+	}
+
+	if (group == ngroups)
+		ret = 1;
+
+	if (!ret) {
+		start = ktime_get();
+		/*
+		 * Flush the first group out to the disk so that the
+		 * time it took is a fair estimate of the device speed.
+		 */
+		ret = ext4_init_inode_table(sb, group,
+					    elr->lr_timeout ? 0 : 1);
+		if (elr->lr_timeout == 0) {
+			us = div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)),
+				     NSEC_PER_USEC);
+			elr->lr_timeout = usecs_to_jiffies(us *
+						sbi->s_li_wait_mult) ?: 1;
+		}
+		elr->lr_next_sched = jiffies + elr->lr_timeout;
+		elr->lr_next_group = group + 1;
+	}
+
+	return ret;
+}
+
+/* Called with li_list_mtx held */
+static void ext4_remove_li_request(struct ext4_li_request *elr)
+{
+	if (!elr)
+		return;
+
+	list_del(&elr->lr_request);
+	EXT4_SB(elr->lr_super)->s_li_request = NULL;
+	kfree(elr);
+}
+
+static void ext4_unregister_li_request(struct super_block *sb)
+{
+	struct ext4_li_request *elr;
+
+	mutex_lock(&ext4_li_mtx);
+	if (!ext4_li_info) {
+		mutex_unlock(&ext4_li_mtx);
+		return;
+	}
+
+	/*
+	 * Taking li_list_mtx waits for the thread to finish with this
+	 * filesystem if it is working on it right now.
+	 */
+	mutex_lock(&ext4_li_info->li_list_mtx);
+	elr = EXT4_SB(sb)->s_li_request;
+	ext4_remove_li_request(elr);
+	if (elr && list_empty(&ext4_li_info->li_request_list))
+		wake_up_process(ext4_li_info->li_task);
+	mutex_unlock(&ext4_li_info->li_list_mtx);
+	mutex_unlock(&ext4_li_mtx);
+}
+
+/*
+ * The thread holds a reference on the module and exits on its own once
+ * the request list has drained, so nobody ever has to kthread_stop() it.
+ */
+static int ext4_lazyinit_thread(void *arg)
+{
+	struct ext4_lazy_init *eli = arg;
+	struct ext4_li_request *elr, *n;
+	unsigned long next_wakeup;
+
+	set_freezable();
+	for (;;) {
+		next_wakeup = MAX_JIFFY_OFFSET;
+
+		mutex_lock(&eli->li_list_mtx);
+		list_for_each_entry_safe(elr, n, &eli->li_request_list,
+					 lr_request) {
+			if (time_after_eq(jiffies, elr->lr_next_sched) &&
+			    ext4_run_li_request(elr) != 0) {
+				/* done or error, drop the request */
+				ext4_remove_li_request(elr);
+				continue;
+			}
+
+			if (time_before(elr->lr_next_sched, next_wakeup))
+				next_wakeup = elr->lr_next_sched;
+		}
+		mutex_unlock(&eli->li_list_mtx);
+
+		if (next_wakeup == MAX_JIFFY_OFFSET) {
+			/* Nothing left: exit unless a request raced in. */
+			mutex_lock(&ext4_li_mtx);
+			if (list_empty(&eli->li_request_list)) {
+				ext4_li_info = NULL;
+				mutex_unlock(&ext4_li_mtx);
+				break;
+			}
+			mutex_unlock(&ext4_li_mtx);
+			continue;
+		}
+
+		try_to_freeze();
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (time_after(next_wakeup, jiffies))
+			schedule_timeout(next_wakeup - jiffies);
+		__set_current_state(TASK_RUNNING);
+	}
+
+	kfree(eli);
+	module_put_and_exit(0);
+	return 0;
+}
+
+/* Called with ext4_li_mtx held */
+static int ext4_run_lazyinit_thread(void)
+{
+	struct ext4_lazy_init *eli;
+	struct task_struct *task;
+
+	eli = kzalloc(sizeof(*eli), GFP_KERNEL);
+	if (!eli)
+		return -ENOMEM;
+
+	INIT_LIST_HEAD(&eli->li_request_list);
+	mutex_init(&eli->li_list_mtx);
+
+	__module_get(THIS_MODULE);
+	task = kthread_create(ext4_lazyinit_thread, eli, "ext4lazyinit");
+	if (IS_ERR(task)) {
+		module_put(THIS_MODULE);
+		kfree(eli);
+		printk(KERN_CRIT "EXT4: error %ld creating inode table "
+		       "initialization thread\n", PTR_ERR(task));
+		return PTR_ERR(task);
+	}
+	eli->li_task = task;
+	ext4_li_info = eli;
+	/* the thread finds the first request on the list when it starts */
+	return 0;
+}
+
+/*
+ * Returns the number of the first group whose inode table has not been
+ * zeroed yet, or s_groups_count if there is none.
+ */
+static ext4_group_t ext4_has_uninit_itable(struct super_block *sb)
+{
+	ext4_group_t group, ngroups = EXT4_SB(sb)->s_groups_count;
+	struct ext4_group_desc *gdp = NULL;
+
+	for (group = 0; group < ngroups; group++) {
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		if (!gdp)
+			continue;
+
+		if (!(gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED)))
+			break;
+	}
+
+	return group;
+}
+
+static int ext4_register_li_request(struct super_block *sb,
+				    ext4_group_t first_not_zeroed)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_li_request *elr;
+	int ret = 0;
+
+	if (!EXT4_HAS_RO_COMPAT_FEATURE(sb,
+					EXT4_FEATURE_RO_COMPAT_GDT_CSUM) ||
+	    first_not_zeroed == sbi->s_groups_count ||
+	    (sb->s_flags & MS_RDONLY) ||
+	    !test_opt(sb, INIT_INODE_TABLE))
+		return 0;
+
+	mutex_lock(&ext4_li_mtx);
+	if (ext4_li_info && sbi->s_li_request) {
+		/*
+		 * Already queued: recompute the delay on the next run,
+		 * s_li_wait_mult may have changed on remount.
+		 */
+		mutex_lock(&ext4_li_info->li_list_mtx);
+		sbi->s_li_request->lr_timeout = 0;
+		mutex_unlock(&ext4_li_info->li_list_mtx);
+		goto out;
+	}
+
+	elr = kzalloc(sizeof(*elr), GFP_KERNEL);
+	if (!elr) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	elr->lr_super = sb;
+	elr->lr_next_group = first_not_zeroed;
+	/* Don't start zeroing many filesystems at the same time */
+	elr->lr_next_sched = jiffies + (random32() %
+				(EXT4_DEF_LI_MAX_START_DELAY * HZ));
+
+	if (!ext4_li_info) {
+		ret = ext4_run_lazyinit_thread();
+		if (ret) {
+			kfree(elr);
+			goto out;
+		}
+	}
+
+	mutex_lock(&ext4_li_info->li_list_mtx);
+	list_add(&elr->lr_request, &ext4_li_info->li_request_list);
+	sbi->s_li_request = elr;
+	mutex_unlock(&ext4_li_info->li_list_mtx);
+	wake_up_process(ext4_li_info->li_task);
+out:
+	mutex_unlock(&ext4_li_mtx);
+	return ret;
+}
+
 static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 				__releases(kernel_lock)
 				__acquires(kernel_lock)
@@ -2472,6 +2771,13 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 
 	set_opt(sbi->s_mount_opt, BARRIER);
 
+	/*
+	 * zero uninitialized inode tables in the background by default
+	 * Use -o noinit_itable to turn it off
+	 */
+	set_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+	sbi->s_li_wait_mult = EXT4_DEF_LI_WAIT_MULT;
+
 	/*
 	 * enable delayed allocation by default
 	 * Use -o nodelalloc to turn it off
@@ -2961,6 +3267,11 @@ no_journal:
 	} else
 		descr = "out journal";
 
+	err = ext4_register_li_request(sb, ext4_has_uninit_itable(sb));
+	if (err)
+		ext4_msg(sb, KERN_WARNING, "failed to start background "
+			 "inode table initialization (%d)", err);
+
 	ext4_msg(sb, KERN_INFO, "mounted filesystem with%s", descr);
 
 	lock_kernel();
@@ -3513,6 +3824,7 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	old_opts.s_commit_interval = sbi->s_commit_interval;
 	old_opts.s_min_batch_time = sbi->s_min_batch_time;
 	old_opts.s_max_batch_time = sbi->s_max_batch_time;
+	old_opts.s_li_wait_mult = sbi->s_li_wait_mult;
 #ifdef CONFIG_QUOTA
 	old_opts.s_jquota_fmt = sbi->s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++)
@@ -3551,6 +3863,9 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 		}
 
 		if (*flags & MS_RDONLY) {
+			/* Stop zeroing inode tables before going read-only */
+			ext4_unregister_li_request(sb);
+
 			/*
 			 * First of all, the unconditional stuff we have to do
 			 * to disable replay of the journal when we next remount
@@ -3625,6 +3940,16 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	if (sbi->s_journal == NULL)
 		ext4_commit_super(sb, 1);
 
+	/*
+	 * Start or stop the lazy inode table initialization depending on
+	 * the new mount state and options.
+	 */
+	if ((sb->s_flags & MS_RDONLY) || !test_opt(sb, INIT_INODE_TABLE))
+		ext4_unregister_li_request(sb);
+	else if (ext4_register_li_request(sb, ext4_has_uninit_itable(sb)))
+		ext4_msg(sb, KERN_WARNING, "failed to start background "
+			 "inode table initialization");
+
 #ifdef CONFIG_QUOTA
 	/* Release old quota file names */
 	for (i = 0; i < MAXQUOTAS; i++)
@@ -3644,6 +3969,7 @@ restore_opts:
 	sbi->s_commit_interval = old_opts.s_commit_interval;
 	sbi->s_min_batch_time = old_opts.s_min_batch_time;
 	sbi->s_max_batch_time = old_opts.s_max_batch_time;
+	sbi->s_li_wait_mult = old_opts.s_li_wait_mult;
 #ifdef CONFIG_QUOTA
 	sbi->s_jquota_fmt = old_opts.s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++) {
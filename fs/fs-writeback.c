@@ -732,6 +732,16 @@ static inline bool over_bground_thresh(void)
 		global_page_state(NR_UNSTABLE_NFS) >= background_thresh);
 }
 
+/*
+ * Keep the bdi write bandwidth estimate fresh while the flusher is busy,
+ * even when no task is being throttled in balance_dirty_pages().
+ */
+static void wb_update_bandwidth(struct bdi_writeback *wb,
+				unsigned long start_time)
+{
+	bdi_update_bandwidth(wb->bdi, 0, 0, 0, 0, 0, start_time);
+}
+
 /*
  * Explicit flushing or periodic writeback of "old" data.
  *
@@ -758,6 +768,7 @@ static long wb_writeback(struct bdi_writeback *wb,
 		.for_kupdate		= args->for_kupdate,
 		.range_cyclic		= args->range_cyclic,
 	};
+	unsigned long wb_start = jiffies;
 	unsigned long oldest_jif;
 	long wrote = 0;
 	struct inode *inode;
@@ -791,6 +802,7 @@ static long wb_writeback(struct bdi_writeback *wb,
 		wbc.nr_to_write = MAX_WRITEBACK_PAGES;
 		wbc.pages_skipped = 0;
 		writeback_inodes_wb(wb, &wbc);
+		wb_update_bandwidth(wb, wb_start);
 		args->nr_pages -= MAX_WRITEBACK_PAGES - wbc.nr_to_write;
 		wrote += MAX_WRITEBACK_PAGES - wbc.nr_to_write;
 
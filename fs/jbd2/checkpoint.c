@@ -23,6 +23,8 @@
 #include <linux/errno.h>
 #include <linux/slab.h>
 #include <linux/blkdev.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include <trace/events/jbd2.h>
 
 /*
@@ -118,12 +120,14 @@ static int __try_to_free_cp_buf(struct journal_head *jh)
 void __jbd2_log_wait_for_space(journal_t *journal)
 {
 	int nblocks, space_left;
+	ktime_t start = ktime_get();
+
 	assert_spin_locked(&journal->j_state_lock);
 
 	nblocks = jbd_space_needed(journal);
 	while (__jbd2_log_space_left(journal) < nblocks) {
 		if (journal->j_flags & JBD2_ABORT)
-			return;
+			break;
 		spin_unlock(&journal->j_state_lock);
 		mutex_lock(&journal->j_checkpoint_mutex);
 
@@ -173,6 +177,110 @@ void __jbd2_log_wait_for_space(journal_t *journal)
 		}
 		mutex_unlock(&journal->j_checkpoint_mutex);
 	}
+
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_space_waits++;
+	journal->j_stats.ts_space_wait_ns +=
+		ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_unlock(&journal->j_history_lock);
+}
+
+/*
+ * Wake up the checkpoint thread if free log space is getting low.
+ *
+ * Called under j_state_lock.
+ */
+void __jbd2_log_kick_checkpoint(journal_t *journal)
+{
+	assert_spin_locked(&journal->j_state_lock);
+
+	if (journal->j_checkpoint_task &&
+	    __jbd2_log_space_left(journal) < jbd2_checkpoint_watermark(journal))
+		wake_up(&journal->j_wait_checkpoint);
+}
+
+static int jbd2_checkpoint_wanted(journal_t *journal)
+{
+	int wanted;
+
+	spin_lock(&journal->j_state_lock);
+	wanted = !(journal->j_flags & JBD2_ABORT) &&
+		 journal->j_checkpoint_transactions != NULL &&
+		 __jbd2_log_space_left(journal) <
+			jbd2_checkpoint_watermark(journal);
+	spin_unlock(&journal->j_state_lock);
+	return wanted;
+}
+
+/*
+ * jbd2_checkpoint_thread: write back checkpointed buffers in the
+ * background once the log fills past jbd2_checkpoint_watermark(), so
+ * that the space is already free by the time start_this_handle() needs
+ * it and handles do not have to wait in __jbd2_log_wait_for_space().
+ * Each round pushes out the oldest transaction in batches of
+ * JBD2_NR_BATCH buffers, just like a synchronous checkpoint.
+ */
+static int jbd2_checkpoint_thread(void *arg)
+{
+	journal_t *journal = arg;
+	int err;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(journal->j_wait_checkpoint,
+				     jbd2_checkpoint_wanted(journal) ||
+				     kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		mutex_lock(&journal->j_checkpoint_mutex);
+		err = 0;
+		if (jbd2_checkpoint_wanted(journal)) {
+			err = jbd2_log_do_checkpoint(journal);
+			/* reclaim the space of the last transaction, too */
+			if (!journal->j_checkpoint_transactions)
+				jbd2_cleanup_journal_tail(journal);
+
+			spin_lock(&journal->j_history_lock);
+			journal->j_stats.ts_async_checkpoints++;
+			spin_unlock(&journal->j_history_lock);
+		}
+		mutex_unlock(&journal->j_checkpoint_mutex);
+
+		/* don't spin on a buffer which keeps failing to write */
+		if (err < 0)
+			schedule_timeout_interruptible(HZ);
+		cond_resched();
+	}
+	return 0;
+}
+
+int jbd2_journal_start_checkpoint_thread(journal_t *journal)
+{
+	struct task_struct *t;
+
+	t = kthread_run(jbd2_checkpoint_thread, journal, "jbd2-cp/%s",
+			journal->j_devname);
+	if (IS_ERR(t))
+		return PTR_ERR(t);
+
+	spin_lock(&journal->j_state_lock);
+	journal->j_checkpoint_task = t;
+	spin_unlock(&journal->j_state_lock);
+	return 0;
+}
+
+void jbd2_journal_stop_checkpoint_thread(journal_t *journal)
+{
+	struct task_struct *t;
+
+	spin_lock(&journal->j_state_lock);
+	t = journal->j_checkpoint_task;
+	journal->j_checkpoint_task = NULL;
+	spin_unlock(&journal->j_state_lock);
+
+	if (t)
+		kthread_stop(t);
 }
 
 /*
@@ -341,6 +341,19 @@ static void write_tag_block(int tag_bytes, journal_block_tag_t *tag,
 		tag->t_blocknr_high = cpu_to_be32((block >> 31) >> 1);
 }
 
+/*
+ * Return the time since *stamp in ns and restart it, for timing the
+ * phases of a commit.
+ */
+static u64 jbd2_phase_time(ktime_t *stamp)
+{
+	ktime_t now = ktime_get();
+	u64 delta = ktime_to_ns(ktime_sub(now, *stamp));
+
+	*stamp = now;
+	return delta;
+}
+
 /*
  * jbd2_journal_commit_transaction
  *
@@ -357,7 +370,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	int flags;
 	int err;
 	unsigned long long blocknr;
-	ktime_t start_time;
+	ktime_t start_time, phase_time;
 	u64 commit_time;
 	char *tagp = NULL;
 	journal_header_t *header;
@@ -495,6 +508,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	journal->j_committing_transaction = commit_transaction;
 	journal->j_running_transaction = NULL;
 	start_time = ktime_get();
+	phase_time = start_time;
 	commit_transaction->t_log_start = journal->j_head;
 	wake_up(&journal->j_wait_transaction_locked);
 	spin_unlock(&journal->j_state_lock);
@@ -511,6 +525,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 
 	jbd2_journal_write_revoke_records(journal, commit_transaction,
 					  write_op);
+	stats.run.rs_submit_data_ns = jbd2_phase_time(&phase_time);
 
 	jbd_debug(3, "JBD: commit phase 2\n");
 
@@ -729,6 +744,7 @@ start_journal_io:
 		if (journal->j_flags & JBD2_BARRIER)
 			blkdev_issue_flush(journal->j_dev, NULL);
 	}
+	stats.run.rs_submit_log_ns = jbd2_phase_time(&phase_time);
 
 	err = journal_finish_inode_data_buffers(journal, commit_transaction);
 	if (err) {
@@ -739,6 +755,7 @@ start_journal_io:
 			jbd2_journal_abort(journal, err);
 		err = 0;
 	}
+	stats.run.rs_wait_data_ns = jbd2_phase_time(&phase_time);
 
 	/* Lo and behold: we have just managed to send a transaction to
            the log.  Before we can commit it, wait for the IO so far to
@@ -839,6 +856,7 @@ wait_for_iobuf:
 
 	if (err)
 		jbd2_journal_abort(journal, err);
+	stats.run.rs_wait_log_ns = jbd2_phase_time(&phase_time);
 
 	jbd_debug(3, "JBD: commit phase 5\n");
 
@@ -854,6 +872,7 @@ wait_for_iobuf:
 
 	if (err)
 		jbd2_journal_abort(journal, err);
+	stats.run.rs_commit_record_ns = jbd2_phase_time(&phase_time);
 
 	/* End of a transaction!  Finally, we can do checkpoint
            processing: any buffers committed as a result of this
@@ -997,6 +1016,7 @@ restart_loop:
 	commit_transaction->t_start = jiffies;
 	stats.run.rs_logging = jbd2_time_diff(stats.run.rs_logging,
 					      commit_transaction->t_start);
+	stats.run.rs_forget_ns = jbd2_phase_time(&phase_time);
 
 	/*
 	 * File the transaction statistics
@@ -1019,6 +1039,13 @@ restart_loop:
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	journal->j_stats.run.rs_submit_data_ns += stats.run.rs_submit_data_ns;
+	journal->j_stats.run.rs_submit_log_ns += stats.run.rs_submit_log_ns;
+	journal->j_stats.run.rs_wait_data_ns += stats.run.rs_wait_data_ns;
+	journal->j_stats.run.rs_wait_log_ns += stats.run.rs_wait_log_ns;
+	journal->j_stats.run.rs_commit_record_ns +=
+		stats.run.rs_commit_record_ns;
+	journal->j_stats.run.rs_forget_ns += stats.run.rs_forget_ns;
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
@@ -1060,6 +1087,11 @@ restart_loop:
 	}
 	spin_unlock(&journal->j_list_lock);
 
+	/* the next commit will find the log space it needs already free */
+	spin_lock(&journal->j_state_lock);
+	__jbd2_log_kick_checkpoint(journal);
+	spin_unlock(&journal->j_state_lock);
+
 	if (journal->j_commit_callback)
 		journal->j_commit_callback(journal, commit_transaction);
 
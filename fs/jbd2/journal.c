@@ -226,11 +226,22 @@ static int jbd2_journal_start_thread(journal_t *journal)
 		return PTR_ERR(t);
 
 	wait_event(journal->j_wait_done_commit, journal->j_task != NULL);
+
+	/*
+	 * Without the checkpoint thread handles simply checkpoint
+	 * synchronously when they run out of log space.
+	 */
+	if (jbd2_journal_start_checkpoint_thread(journal))
+		printk(KERN_WARNING "JBD2: no checkpoint thread for %s\n",
+		       journal->j_devname);
 	return 0;
 }
 
 static void journal_kill_thread(journal_t *journal)
 {
+	/* it may be waiting for a commit, so it has to go first */
+	jbd2_journal_stop_checkpoint_thread(journal);
+
 	spin_lock(&journal->j_state_lock);
 	journal->j_flags |= JBD2_UNMOUNT;
 
@@ -691,6 +702,13 @@ static void *jbd2_seq_info_next(struct seq_file *seq, void *v, loff_t *pos)
 	return NULL;
 }
 
+static unsigned long long jbd2_avg_us(u64 total_ns, unsigned long nr)
+{
+	if (!nr)
+		return 0;
+	return div_u64(div64_u64(total_ns, nr), NSEC_PER_USEC);
+}
+
 static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 {
 	struct jbd2_stats_proc_session *s = seq->private;
@@ -720,6 +738,25 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "average commit phases:\n");
+	seq_printf(seq, "  %lluus submitting data\n",
+	    jbd2_avg_us(s->stats->run.rs_submit_data_ns, s->stats->ts_tid));
+	seq_printf(seq, "  %lluus submitting log blocks\n",
+	    jbd2_avg_us(s->stats->run.rs_submit_log_ns, s->stats->ts_tid));
+	seq_printf(seq, "  %lluus waiting for data\n",
+	    jbd2_avg_us(s->stats->run.rs_wait_data_ns, s->stats->ts_tid));
+	seq_printf(seq, "  %lluus waiting for log blocks\n",
+	    jbd2_avg_us(s->stats->run.rs_wait_log_ns, s->stats->ts_tid));
+	seq_printf(seq, "  %lluus writing commit record\n",
+	    jbd2_avg_us(s->stats->run.rs_commit_record_ns, s->stats->ts_tid));
+	seq_printf(seq, "  %lluus filing buffers for checkpoint\n",
+	    jbd2_avg_us(s->stats->run.rs_forget_ns, s->stats->ts_tid));
+	seq_printf(seq, "log space:\n  %lu background checkpoints\n",
+		   s->stats->ts_async_checkpoints);
+	seq_printf(seq, "  %lu waits for log space, %lluus average wait\n",
+		   s->stats->ts_space_waits,
+		   jbd2_avg_us(s->stats->ts_space_wait_ns,
+			       s->stats->ts_space_waits));
 	return 0;
 }
 
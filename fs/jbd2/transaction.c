@@ -219,6 +219,7 @@ repeat_locked:
 		__jbd2_log_wait_for_space(journal);
 		goto repeat_locked;
 	}
+	__jbd2_log_kick_checkpoint(journal);
 
 	/* OK, account for the buffers that this operation expects to
 	 * use and add the handle to the running transaction. */
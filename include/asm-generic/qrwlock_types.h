@@ -0,0 +1,20 @@
+#ifndef __ASM_GENERIC_QRWLOCK_TYPES_H
+#define __ASM_GENERIC_QRWLOCK_TYPES_H
+
+#include <linux/types.h>
+
+/*
+ * The queue read/write lock data structure.  The arch must have defined
+ * raw_spinlock_t, which serves as the wait queue, before including this.
+ */
+typedef struct qrwlock {
+	atomic_t		cnts;
+	raw_spinlock_t		lock;
+} raw_rwlock_t;
+
+#define	__RAW_RW_LOCK_UNLOCKED {		\
+	.cnts = { 0 },				\
+	.lock = __RAW_SPIN_LOCK_UNLOCKED,	\
+}
+
+#endif /* __ASM_GENERIC_QRWLOCK_TYPES_H */
@@ -38,11 +38,19 @@ typedef int (congested_fn)(void *, int);
 enum bdi_stat_item {
 	BDI_RECLAIMABLE,
 	BDI_WRITEBACK,
+	BDI_DIRTIED,
+	BDI_WRITTEN,
 	NR_BDI_STAT_ITEMS
 };
 
 #define BDI_STAT_BATCH (8*(1+ilog2(nr_cpu_ids)))
 
+/*
+ * Initial write bandwidth guess (100MB/s, in pages per second), used until
+ * the first real estimate is available.
+ */
+#define INIT_BW		(100 << (20 - PAGE_SHIFT))
+
 struct bdi_writeback {
 	struct list_head list;			/* hangs off the bdi */
 
@@ -75,6 +83,20 @@ struct backing_dev_info {
 	struct prop_local_percpu completions;
 	int dirty_exceeded;
 
+	/*
+	 * Write bandwidth estimation and dirty throttling state, updated
+	 * under bw_lock at most once per BANDWIDTH_INTERVAL. Bandwidths
+	 * and rate limits are in pages per second.
+	 */
+	spinlock_t bw_lock;
+	unsigned long bw_time_stamp;	/* last time write bw is updated */
+	unsigned long dirtied_stamp;	/* pages dirtied at bw_time_stamp */
+	unsigned long written_stamp;	/* pages written at bw_time_stamp */
+	unsigned long write_bandwidth;	/* the estimated write bandwidth */
+	unsigned long avg_write_bandwidth; /* further smoothed write bw */
+	unsigned long dirty_ratelimit;	/* base rate for dirtying tasks */
+	unsigned long balanced_dirty_ratelimit; /* last balanced estimate */
+
 	unsigned int min_ratio;
 	unsigned int max_ratio, max_prop_frac;
 
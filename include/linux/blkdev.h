@@ -28,6 +28,7 @@ struct request_queue;
 struct elevator_queue;
 struct request_pm_state;
 struct blk_trace;
+struct rq_wb;
 struct request;
 struct sg_io_hdr;
 
@@ -115,6 +116,7 @@ enum rq_flag_bits {
 	__REQ_NOIDLE,		/* Don't anticipate more IO after this one */
 	__REQ_IO_STAT,		/* account I/O stat */
 	__REQ_MIXED_MERGE,	/* merge of different types, fail separately */
+	__REQ_WB_TRACKED,	/* counted against writeback throttling depth */
 	__REQ_NR_BITS,		/* stops here */
 };
 
@@ -144,6 +146,7 @@ enum rq_flag_bits {
 #define REQ_NOIDLE	(1 << __REQ_NOIDLE)
 #define REQ_IO_STAT	(1 << __REQ_IO_STAT)
 #define REQ_MIXED_MERGE	(1 << __REQ_MIXED_MERGE)
+#define REQ_WB_TRACKED	(1 << __REQ_WB_TRACKED)
 
 #define REQ_FAILFAST_MASK	(REQ_FAILFAST_DEV | REQ_FAILFAST_TRANSPORT | \
 				 REQ_FAILFAST_DRIVER)
@@ -193,6 +196,9 @@ struct request {
 
 	struct gendisk *rq_disk;
 	unsigned long start_time;
+#ifdef CONFIG_BLK_WBT
+	u64 issue_time_ns;	/* when handed to the driver, for wbt */
+#endif
 
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -425,6 +431,7 @@ struct request_queue
 #ifdef CONFIG_BLK_DEV_IO_TRACE
 	struct blk_trace	*blk_trace;
 #endif
+	struct rq_wb		*rq_wb;		/* writeback throttling */
 	/*
 	 * reserved for flush operations
 	 */
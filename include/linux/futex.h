@@ -177,6 +177,8 @@ union futex_key {
 extern void exit_robust_list(struct task_struct *curr);
 extern void exit_pi_state_list(struct task_struct *curr);
 extern int futex_cmpxchg_enabled;
+extern int futex_hash_prctl(unsigned long op, unsigned long slots);
+extern void futex_hash_free(struct mm_struct *mm);
 #else
 static inline void exit_robust_list(struct task_struct *curr)
 {
@@ -184,6 +186,21 @@ static inline void exit_robust_list(struct task_struct *curr)
 static inline void exit_pi_state_list(struct task_struct *curr)
 {
 }
+static inline int futex_hash_prctl(unsigned long op, unsigned long slots)
+{
+	return -EINVAL;
+}
+static inline void futex_hash_free(struct mm_struct *mm)
+{
+}
+#endif
+
+#ifdef CONFIG_FUTEX_HASH_STATS
+struct seq_file;
+struct pid_namespace;
+struct pid;
+extern int proc_pid_futex_hash(struct seq_file *m, struct pid_namespace *ns,
+			       struct pid *pid, struct task_struct *task);
 #endif
 #endif /* __KERNEL__ */
 
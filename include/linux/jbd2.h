@@ -672,11 +672,24 @@ struct transaction_run_stats_s {
 	__u32			rs_handle_count;
 	__u32			rs_blocks;
 	__u32			rs_blocks_logged;
+
+	/* commit phases in nanoseconds; the times above are in jiffies */
+	u64			rs_submit_data_ns;
+	u64			rs_submit_log_ns;
+	u64			rs_wait_data_ns;
+	u64			rs_wait_log_ns;
+	u64			rs_commit_record_ns;
+	u64			rs_forget_ns;
 };
 
 struct transaction_stats_s {
 	unsigned long		ts_tid;
 	struct transaction_run_stats_s run;
+
+	/* log space reclaim */
+	unsigned long		ts_async_checkpoints;
+	unsigned long		ts_space_waits;
+	u64			ts_space_wait_ns;
 };
 
 static inline unsigned long
@@ -738,6 +751,7 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  *     commit
  * @j_uuid: Uuid of client object.
  * @j_task: Pointer to the current commit thread for this journal
+ * @j_checkpoint_task: Thread checkpointing ahead of log space exhaustion
  * @j_max_transaction_buffers:  Maximum number of metadata buffers to allow in a
  *     single compound commit transaction
  * @j_commit_interval: What is the maximum transaction lifetime before we begin
@@ -927,6 +941,13 @@ struct journal_s
 	/* Pointer to the current commit thread for this journal */
 	struct task_struct	*j_task;
 
+	/*
+	 * Background checkpoint thread, woken through j_wait_checkpoint when
+	 * free log space drops below jbd2_checkpoint_watermark().
+	 * [j_state_lock]
+	 */
+	struct task_struct	*j_checkpoint_task;
+
 	/*
 	 * Maximum number of metadata buffers to allow in a single compound
 	 * commit transaction
@@ -1206,6 +1227,9 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
+void __jbd2_log_kick_checkpoint(journal_t *journal);
+int jbd2_journal_start_checkpoint_thread(journal_t *journal);
+void jbd2_journal_stop_checkpoint_thread(journal_t *journal);
 extern void __jbd2_journal_drop_transaction(journal_t *, transaction_t *);
 extern int jbd2_cleanup_journal_tail(journal_t *);
 
@@ -1278,6 +1302,16 @@ static inline int jbd_space_needed(journal_t *journal)
 	return nblocks;
 }
 
+/*
+ * Free log space below which the checkpoint thread starts writing back
+ * checkpointed buffers: one more maximal transaction than new handles
+ * need, so that they normally never have to checkpoint themselves.
+ */
+static inline int jbd2_checkpoint_watermark(journal_t *journal)
+{
+	return jbd_space_needed(journal) + journal->j_max_transaction_buffers;
+}
+
 /*
  * Definitions which augment the buffer_head layer
  */
@@ -107,5 +107,6 @@ extern void account_idle_time(cputime_t);
 extern void account_process_tick(struct task_struct *, int user);
 extern void account_steal_ticks(unsigned long ticks);
 extern void account_idle_ticks(unsigned long ticks);
+extern void account_process_ticks(struct task_struct *, unsigned long ticks);
 
 #endif /* _LINUX_KERNEL_STAT_H */
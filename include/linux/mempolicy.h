@@ -214,6 +214,12 @@ static inline void check_highest_zone(enum zone_type k)
 int do_migrate_pages(struct mm_struct *mm,
 	const nodemask_t *from_nodes, const nodemask_t *to_nodes, int flags);
 
+#ifdef CONFIG_NUMA_BALANCING
+extern unsigned long mpol_numa_sample(struct mm_struct *mm,
+		unsigned long *offset, unsigned long pages,
+		unsigned long *faults, int target_nid);
+#endif
+
 
 #ifdef CONFIG_TMPFS
 extern int mpol_parse_str(char *str, struct mempolicy **mpol, int no_context);
@@ -293,6 +293,17 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_FUTEX
+	/* private futex hash (PR_FUTEX_HASH), NULL: use the global one */
+	struct futex_hash_bucket *futex_hash;
+	unsigned long futex_hash_mask;
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	/* next sampling pass of the address space, in jiffies */
+	unsigned long numa_next_scan;
+	/* where the next sampling pass starts */
+	unsigned long numa_scan_offset;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
@@ -42,6 +42,7 @@
 #include <linux/rculist.h>
 #include <linux/dmaengine.h>
 #include <linux/workqueue.h>
+#include <linux/dynamic_queue_limits.h>
 
 #include <linux/ethtool.h>
 #include <net/net_namespace.h>
@@ -464,8 +465,19 @@ enum netdev_queue_state_t
 {
 	__QUEUE_STATE_XOFF,
 	__QUEUE_STATE_FROZEN,
+	__QUEUE_STATE_STACK_XOFF,
 };
 
+/*
+ * __QUEUE_STATE_XOFF is set by the driver when its ring is full,
+ * __QUEUE_STATE_STACK_XOFF by the stack when the byte queue limit is
+ * reached.  The stack must not transmit while either one is set.
+ */
+#define QUEUE_STATE_ANY_XOFF	((1 << __QUEUE_STATE_XOFF) |		\
+				 (1 << __QUEUE_STATE_STACK_XOFF))
+#define QUEUE_STATE_ANY_XOFF_OR_FROZEN	(QUEUE_STATE_ANY_XOFF |		\
+					 (1 << __QUEUE_STATE_FROZEN))
+
 struct netdev_queue {
 /*
  * read mostly part
@@ -486,8 +498,35 @@ struct netdev_queue {
 	unsigned long		tx_bytes;
 	unsigned long		tx_packets;
 	unsigned long		tx_dropped;
+#ifdef CONFIG_SYSFS
+	struct kobject		kobj;
+#endif
+#ifdef CONFIG_BQL
+	struct dql		dql;
+#endif
 } ____cacheline_aligned_in_smp;
 
+#ifdef CONFIG_XPS
+/*
+ * This structure holds an XPS map which can be of variable length.  The
+ * map is an array of queues.
+ */
+struct xps_map {
+	unsigned int len;
+	u16 queues[0];
+};
+#define XPS_MAP_SIZE(_num) (sizeof(struct xps_map) + ((_num) * sizeof(u16)))
+
+/*
+ * This structure holds all XPS maps for device.  Maps are indexed by CPU.
+ */
+struct xps_dev_maps {
+	struct xps_map *cpu_map[0];
+};
+#define XPS_DEV_MAPS_SIZE (sizeof(struct xps_dev_maps) +		\
+	(nr_cpu_ids * sizeof(struct xps_map *)))
+#endif /* CONFIG_XPS */
+
 
 /*
  * This structure defines the management hooks for network devices.
@@ -732,6 +771,8 @@ struct net_device
 #define NETIF_F_TSO_ECN		(SKB_GSO_TCP_ECN << NETIF_F_GSO_SHIFT)
 #define NETIF_F_TSO6		(SKB_GSO_TCPV6 << NETIF_F_GSO_SHIFT)
 #define NETIF_F_FSO		(SKB_GSO_FCOE << NETIF_F_GSO_SHIFT)
+#define NETIF_F_GSO_GRE		(SKB_GSO_GRE << NETIF_F_GSO_SHIFT)
+#define NETIF_F_GSO_IPIP	(SKB_GSO_IPIP << NETIF_F_GSO_SHIFT)
 
 	/* List of features with software fallbacks. */
 #define NETIF_F_GSO_SOFTWARE	(NETIF_F_TSO | NETIF_F_TSO_ECN | NETIF_F_TSO6)
@@ -919,6 +960,14 @@ struct net_device
 	struct device		dev;
 	/* space for optional statistics and wireless sysfs groups */
 	const struct attribute_group *sysfs_groups[3];
+#ifdef CONFIG_SYSFS
+	/* class/net/name/queues, holds one tx-N entry per TX queue */
+	struct kset		*queues_kset;
+#endif
+#ifdef CONFIG_XPS
+	/* sending CPU to TX queue map, see netif_set_xps_queue() */
+	struct xps_dev_maps	*xps_maps;
+#endif
 
 	/* rtnetlink link ops */
 	const struct rtnl_link_ops *rtnl_link_ops;
@@ -1081,6 +1130,9 @@ struct napi_gro_cb {
 
 	/* Free the skb? */
 	int free;
+
+	/* Set once a tunnel passed the packet to its inner protocol. */
+	int encap_mark;
 };
 
 #define NAPI_GRO_CB(skb) ((struct napi_gro_cb *)(skb)->cb)
@@ -1164,6 +1216,11 @@ extern int		dev_open(struct net_device *dev);
 extern int		dev_close(struct net_device *dev);
 extern void		dev_disable_lro(struct net_device *dev);
 extern int		dev_queue_xmit(struct sk_buff *skb);
+#ifdef CONFIG_XPS
+extern int		netif_set_xps_queue(struct net_device *dev,
+					    const struct cpumask *mask,
+					    u16 index);
+#endif
 extern int		register_netdevice(struct net_device *dev);
 extern void		unregister_netdevice(struct net_device *dev);
 extern void		free_netdev(struct net_device *dev);
@@ -1221,11 +1278,6 @@ static inline void *skb_gro_header_slow(struct sk_buff *skb, unsigned int hlen,
 	return skb->data + offset;
 }
 
-static inline void *skb_gro_mac_header(struct sk_buff *skb)
-{
-	return NAPI_GRO_CB(skb)->frag0 ?: skb_mac_header(skb);
-}
-
 static inline void *skb_gro_network_header(struct sk_buff *skb)
 {
 	return (NAPI_GRO_CB(skb)->frag0 ?: skb->data) +
@@ -1282,7 +1334,7 @@ extern void __netif_schedule(struct Qdisc *q);
 
 static inline void netif_schedule_queue(struct netdev_queue *txq)
 {
-	if (!test_bit(__QUEUE_STATE_XOFF, &txq->state))
+	if (!(txq->state & QUEUE_STATE_ANY_XOFF))
 		__netif_schedule(txq->qdisc);
 }
 
@@ -1402,6 +1454,111 @@ static inline int netif_tx_queue_frozen(const struct netdev_queue *dev_queue)
 	return test_bit(__QUEUE_STATE_FROZEN, &dev_queue->state);
 }
 
+/* Stopped by the driver or by the byte queue limit */
+static inline int netif_xmit_stopped(const struct netdev_queue *dev_queue)
+{
+	return dev_queue->state & QUEUE_STATE_ANY_XOFF;
+}
+
+static inline int
+netif_xmit_frozen_or_stopped(const struct netdev_queue *dev_queue)
+{
+	return dev_queue->state & QUEUE_STATE_ANY_XOFF_OR_FROZEN;
+}
+
+/**
+ *	netdev_tx_sent_queue - report bytes queued to a device TX queue
+ *	@dev_queue: the TX queue
+ *	@bytes: bytes handed to the hardware
+ *
+ *	Called by the driver from ndo_start_xmit once a packet is on the
+ *	ring.  Stops the queue on behalf of the stack when the byte limit
+ *	is exceeded; the driver keeps managing its own ring-full stop.
+ */
+static inline void netdev_tx_sent_queue(struct netdev_queue *dev_queue,
+					unsigned int bytes)
+{
+#ifdef CONFIG_BQL
+	dql_queued(&dev_queue->dql, bytes);
+
+	if (likely(dql_avail(&dev_queue->dql) >= 0))
+		return;
+
+	set_bit(__QUEUE_STATE_STACK_XOFF, &dev_queue->state);
+
+	/*
+	 * The XOFF flag must be set before checking the dql_avail below,
+	 * because in netdev_tx_completed_queue we update the dql_completed
+	 * before checking the XOFF flag.
+	 */
+	smp_mb();
+
+	/* check again in case another CPU has just made room avail */
+	if (unlikely(dql_avail(&dev_queue->dql) >= 0))
+		clear_bit(__QUEUE_STATE_STACK_XOFF, &dev_queue->state);
+#endif
+}
+
+static inline void netdev_sent_queue(struct net_device *dev,
+				     unsigned int bytes)
+{
+	netdev_tx_sent_queue(netdev_get_tx_queue(dev, 0), bytes);
+}
+
+/**
+ *	netdev_tx_completed_queue - report bytes completed by a TX queue
+ *	@dev_queue: the TX queue
+ *	@pkts: packets reclaimed
+ *	@bytes: bytes reclaimed, as reported to netdev_tx_sent_queue()
+ *
+ *	Called by the driver from its TX completion handler.
+ */
+static inline void netdev_tx_completed_queue(struct netdev_queue *dev_queue,
+					     unsigned int pkts,
+					     unsigned int bytes)
+{
+#ifdef CONFIG_BQL
+	if (unlikely(!bytes))
+		return;
+
+	dql_completed(&dev_queue->dql, bytes);
+
+	/*
+	 * Without the memory barrier there is a small possiblity that
+	 * netdev_tx_sent_queue will miss the update and cause the queue to
+	 * be stopped forever
+	 */
+	smp_mb();
+
+	if (dql_avail(&dev_queue->dql) < 0)
+		return;
+
+	if (test_and_clear_bit(__QUEUE_STATE_STACK_XOFF, &dev_queue->state))
+		netif_schedule_queue(dev_queue);
+#endif
+}
+
+static inline void netdev_completed_queue(struct net_device *dev,
+					  unsigned int pkts,
+					  unsigned int bytes)
+{
+	netdev_tx_completed_queue(netdev_get_tx_queue(dev, 0), pkts, bytes);
+}
+
+/* Called by the driver when it drops everything queued on the ring */
+static inline void netdev_tx_reset_queue(struct netdev_queue *dev_queue)
+{
+#ifdef CONFIG_BQL
+	clear_bit(__QUEUE_STATE_STACK_XOFF, &dev_queue->state);
+	dql_reset(&dev_queue->dql);
+#endif
+}
+
+static inline void netdev_reset_queue(struct net_device *dev)
+{
+	netdev_tx_reset_queue(netdev_get_tx_queue(dev, 0));
+}
+
 /**
  *	netif_running - test if up
  *	@dev: network device
@@ -1521,6 +1678,8 @@ extern int		netif_receive_skb(struct sk_buff *skb);
 extern void		napi_gro_flush(struct napi_struct *napi);
 extern int		dev_gro_receive(struct napi_struct *napi,
 					struct sk_buff *skb);
+extern struct packet_type *gro_find_receive_by_type(__be16 type);
+extern struct packet_type *gro_find_complete_by_type(__be16 type);
 extern int		napi_skb_finish(int ret, struct sk_buff *skb);
 extern int		napi_gro_receive(struct napi_struct *napi,
 					 struct sk_buff *skb);
@@ -1971,6 +2130,10 @@ unsigned long netdev_fix_features(unsigned long features, const char *name);
 static inline int net_gso_ok(int features, int gso_type)
 {
 	int feature = gso_type << NETIF_F_GSO_SHIFT;
+
+	/* GSO types past the feature bits have no hardware support */
+	if (gso_type & ~(NETIF_F_GSO_MASK >> NETIF_F_GSO_SHIFT))
+		return 0;
 	return (features & feature) == feature;
 }
 
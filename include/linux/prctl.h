@@ -102,4 +102,13 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Give the (single threaded) process its own hash table for
+ * FUTEX_PRIVATE_FLAG futexes.  SET_SLOTS takes a power of two number
+ * of buckets, 0 means back to the global hash; GET_SLOTS returns it.
+ */
+#define PR_FUTEX_HASH	35
+# define PR_FUTEX_HASH_SET_SLOTS	1
+# define PR_FUTEX_HASH_GET_SLOTS	2
+
 #endif /* _LINUX_PRCTL_H */
@@ -245,6 +245,16 @@ enum {
 	SKB_GSO_TCPV6 = 1 << 4,
 
 	SKB_GSO_FCOE = 1 << 5,
+
+	/* The packet is encapsulated in an IPv4 GRE or IPIP tunnel, the
+	 * inner packet is segmented and the outer headers are copied. */
+	SKB_GSO_GRE = 1 << 6,
+
+	SKB_GSO_IPIP = 1 << 7,
+
+	/* UDP datagrams of gso_size merged by GRO.  There is no device
+	 * feature for this one, they are always segmented in software. */
+	SKB_GSO_UDP_GRO = 1 << 8,
 };
 
 #if BITS_PER_LONG > 32
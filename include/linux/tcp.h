@@ -96,6 +96,7 @@ enum {
 #define TCP_QUICKACK		12	/* Block/reenable quick acks */
 #define TCP_CONGESTION		13	/* Congestion control algorithm */
 #define TCP_MD5SIG		14	/* TCP MD5 Signature (RFC2385) */
+#define TCP_FASTOPEN		23	/* Enable FastOpen on listeners */
 
 #define TCPI_OPT_TIMESTAMPS	1
 #define TCPI_OPT_SACK		2
@@ -229,14 +230,33 @@ struct tcp_options_received {
  * only four options will fit in a standard TCP header */
 #define TCP_NUM_SACKS 4
 
+/* TCP Fast Open cookie, as carried in the SYN and the SYN-ACK */
+#define TCP_FASTOPEN_COOKIE_MIN	4	/* Min Fast Open Cookie size in bytes */
+#define TCP_FASTOPEN_COOKIE_MAX	16	/* Max Fast Open Cookie size in bytes */
+#define TCP_FASTOPEN_COOKIE_SIZE 8	/* the size employed by this impl. */
+
+struct tcp_fastopen_cookie {
+	s8	len;	/* -1 disables the option, 0 requests a cookie */
+	u8	val[TCP_FASTOPEN_COOKIE_MAX];
+};
+
+/* State of a sendmsg(MSG_FASTOPEN) until the SYN is out */
+struct tcp_fastopen_request {
+	struct tcp_fastopen_cookie	cookie;	/* cookie to send in the SYN */
+	struct msghdr			*data;	/* data in MSG_FASTOPEN */
+	int				copied;	/* queued in tcp_connect() */
+};
+
 struct tcp_request_sock {
 	struct inet_request_sock 	req;
 #ifdef CONFIG_TCP_MD5SIG
 	/* Only used by TCP MD5 Signature so far. */
 	const struct tcp_request_sock_ops *af_specific;
 #endif
+	struct sock			*listener; /* Fast Open: held listener */
 	u32			 	rcv_isn;
 	u32			 	snt_isn;
+	u32				rcv_nxt; /* the ack # in the SYN-ACK */
 };
 
 static inline struct tcp_request_sock *tcp_rsk(const struct request_sock *req)
@@ -299,6 +319,9 @@ struct tcp_sock {
 	u16	advmss;		/* Advertised MSS			*/
 	u8	frto_counter;	/* Number of new acks after RTO */
 	u8	nonagle;	/* Disable Nagle algorithm?             */
+	u8	syn_fastopen:1,	/* SYN includes Fast Open option */
+		syn_data:1,	/* SYN includes data */
+		syn_data_acked:1;/* data in SYN is acked by SYN-ACK */
 
 /* RTT measurement */
 	u32	srtt;		/* smoothed round trip time << 3	*/
@@ -399,6 +422,19 @@ struct tcp_sock {
 		u32		  probe_seq_end;
 	} mtu_probe;
 
+/* Fast Open: the client's request until the SYN is sent, and on the
+ * server the request of a child created by a SYN with data, until the
+ * SYN-ACK has been acknowledged.
+ */
+	struct tcp_fastopen_request *fastopen_req;
+	struct request_sock *fastopen_rsk;
+
+/* TCP small queues: the socket waits for its packets below the IP
+ * layer to be freed, see tcp_wfree().
+ */
+	unsigned long	tsq_flags;
+	struct list_head tsq_node;	/* in the per-cpu TSQ tasklet list */
+
 #ifdef CONFIG_TCP_MD5SIG
 /* TCP AF-Specific parts; only used by MD5 Signature support so far */
 	const struct tcp_sock_af_ops	*af_specific;
@@ -408,11 +444,26 @@ struct tcp_sock {
 #endif
 };
 
+enum tsq_flags {
+	TSQ_THROTTLED,		/* sk_wmem_alloc reached the limit */
+	TSQ_QUEUED,		/* queued to the per-cpu TSQ tasklet */
+	TCP_TSQ_DEFERRED,	/* tcp_tasklet_func() found socket was owned */
+};
+
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
 {
 	return (struct tcp_sock *)sk;
 }
 
+/* A server child of Fast Open, that may already be accepted and written
+ * to, while its SYN-ACK is still unacknowledged.
+ */
+static inline int tcp_passive_fastopen(const struct sock *sk)
+{
+	return sk->sk_state == TCP_SYN_RECV &&
+	       tcp_sk(sk)->fastopen_rsk != NULL;
+}
+
 struct tcp_timewait_sock {
 	struct inet_timewait_sock tw_sk;
 	u32			  tw_rcv_nxt;
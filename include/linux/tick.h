@@ -43,6 +43,10 @@ enum tick_nohz_mode {
  * @idle_exittime:	Time when the idle state was left
  * @idle_sleeptime:	Sum of the time slept in idle with sched tick stopped
  * @sleep_length:	Duration of the current idle sleep
+ * @full_stopped:	Indicator that the tick has been stopped on a full
+ *			dynticks CPU running a single task
+ * @full_jiffies:	jiffies up to which the time of that task has been
+ *			accounted
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -64,6 +68,8 @@ struct tick_sched {
 	unsigned long			last_jiffies;
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
+	int				full_stopped;
+	unsigned long			full_jiffies;
 };
 
 extern void __init tick_init(void);
@@ -134,4 +140,42 @@ static inline ktime_t tick_nohz_get_sleep_length(void)
 static inline u64 get_cpu_idle_time_us(int cpu, u64 *unused) { return -1; }
 # endif /* !NO_HZ */
 
+# ifdef CONFIG_NO_HZ_FULL
+extern bool tick_nohz_full_running;
+extern cpumask_var_t tick_nohz_full_mask;
+
+static inline int tick_nohz_full_cpu(int cpu)
+{
+	return tick_nohz_full_running &&
+	       cpumask_test_cpu(cpu, tick_nohz_full_mask);
+}
+
+extern void __tick_nohz_full_check(void);
+extern void __tick_nohz_full_restart(void);
+extern void tick_nohz_full_kick_cpu(int cpu);
+extern void tick_nohz_full_kick_all(void);
+extern void tick_nohz_full_kick_timer(int cpu, unsigned long expires);
+
+/* From irq_exit(): stop the tick if a single task is running. */
+static inline void tick_nohz_full_check(void)
+{
+	if (tick_nohz_full_running)
+		__tick_nohz_full_check();
+}
+
+/* From schedule(): bring the tick back while tasks are switched. */
+static inline void tick_nohz_full_restart(void)
+{
+	if (tick_nohz_full_running)
+		__tick_nohz_full_restart();
+}
+# else
+static inline int tick_nohz_full_cpu(int cpu) { return 0; }
+static inline void tick_nohz_full_check(void) { }
+static inline void tick_nohz_full_restart(void) { }
+static inline void tick_nohz_full_kick_cpu(int cpu) { }
+static inline void tick_nohz_full_kick_all(void) { }
+static inline void tick_nohz_full_kick_timer(int cpu, unsigned long expires) { }
+# endif /* !NO_HZ_FULL */
+
 #endif
@@ -29,6 +29,24 @@ struct timer_list {
 
 extern struct tvec_base boot_tvec_bases;
 
+/*
+ * Per-CPU timer wheel statistics, shown in /proc/timer_list:
+ * @queued:	timers queued in the wheel
+ * @expired:	timers expired
+ * @batches:	non-empty buckets expired
+ * @max_batch:	largest number of timers expired from one bucket
+ * @max_run_ns:	longest run of the timer softirq over the wheel
+ */
+struct timer_wheel_stats {
+	unsigned long	queued;
+	unsigned long	expired;
+	unsigned long	batches;
+	unsigned long	max_batch;
+	u64		max_run_ns;
+};
+
+extern void timer_wheel_get_stats(int cpu, struct timer_wheel_stats *stats);
+
 #ifdef CONFIG_LOCKDEP
 /*
  * NB: because we have to copy the lockdep_map, setting the lockdep_map key
@@ -29,6 +29,7 @@ struct udphdr {
 /* UDP socket options */
 #define UDP_CORK	1	/* Never send partially complete segments */
 #define UDP_ENCAP	100	/* Set the socket to accept encapsulated packets */
+#define UDP_GRO		104	/* Accept merged datagrams, see udp_recvmsg() */
 
 /* UDP encapsulation types */
 #define UDP_ENCAP_ESPINUDP_NON_IKE	1 /* draft-ietf-ipsec-nat-t-ike-00/01 */
@@ -73,7 +74,8 @@ struct udp_sock {
 #define UDPLITE_SEND_CC  0x2  		/* set via udplite setsockopt         */
 #define UDPLITE_RECV_CC  0x4		/* set via udplite setsocktopt        */
 	__u8		 pcflag;        /* marks socket as UDP-Lite if > 0    */
-	__u8		 unused[3];
+	__u8		 gro_enabled;	/* reads merged datagrams, UDP_GRO    */
+	__u8		 unused[2];
 	/*
 	 * For encapsulation sockets.
 	 */
@@ -87,6 +89,15 @@ static inline struct udp_sock *udp_sk(const struct sock *sk)
 
 #define IS_UDPLITE(__sk) (udp_sk(__sk)->pcflag)
 
+/*
+ * Datagrams merged by udp4_gro_receive() keep a gso_size, the size of
+ * all but the last one.
+ */
+static inline int udp_skb_is_gro(const struct sk_buff *skb)
+{
+	return skb_shinfo(skb)->gso_type & SKB_GSO_UDP_GRO;
+}
+
 #endif
 
 #endif	/* _LINUX_UDP_H */
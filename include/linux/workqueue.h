@@ -22,11 +22,37 @@ typedef void (*work_func_t)(struct work_struct *work);
  */
 #define work_data_bits(work) ((unsigned long *)(&(work)->data))
 
+/*
+ * While a work item is queued, ->data points to the cpu_workqueue_struct
+ * it is queued on (WORK_STRUCT_CWQ is set).  Once it has started
+ * executing, ->data holds the id of the worker pool it last ran on, so
+ * that a requeue can be sent to the same pool for non-reentrancy.
+ */
+#define WORK_STRUCT_PENDING_BIT	0	/* work item is pending execution */
+#define WORK_STRUCT_DELAYED_BIT	1	/* work item is delayed */
+#define WORK_STRUCT_CWQ_BIT	2	/* data points to cwq */
+#define WORK_STRUCT_LINKED_BIT	3	/* next work is linked to this one */
+#define WORK_STRUCT_COLOR_SHIFT	4	/* color for workqueue flushing */
+#define WORK_STRUCT_COLOR_BITS	2
+
+#define WORK_STRUCT_PENDING	(1UL << WORK_STRUCT_PENDING_BIT)
+#define WORK_STRUCT_DELAYED	(1UL << WORK_STRUCT_DELAYED_BIT)
+#define WORK_STRUCT_CWQ		(1UL << WORK_STRUCT_CWQ_BIT)
+#define WORK_STRUCT_LINKED	(1UL << WORK_STRUCT_LINKED_BIT)
+
+/*
+ * Flush colors: two for flush_workqueue() to alternate between and one
+ * for barriers, which are not waited for by flush_workqueue().
+ */
+#define WORK_NR_COLORS		2
+#define WORK_NO_COLOR		((1 << WORK_STRUCT_COLOR_BITS) - 1)
+
+#define WORK_STRUCT_FLAG_BITS	(WORK_STRUCT_COLOR_SHIFT + WORK_STRUCT_COLOR_BITS)
+#define WORK_STRUCT_FLAG_MASK	((1UL << WORK_STRUCT_FLAG_BITS) - 1)
+#define WORK_STRUCT_WQ_DATA_MASK (~WORK_STRUCT_FLAG_MASK)
+
 struct work_struct {
 	atomic_long_t data;
-#define WORK_STRUCT_PENDING 0		/* T if work item pending execution */
-#define WORK_STRUCT_FLAG_MASK (3UL)
-#define WORK_STRUCT_WQ_DATA_MASK (~WORK_STRUCT_FLAG_MASK)
 	struct list_head entry;
 	work_func_t func;
 #ifdef CONFIG_LOCKDEP
@@ -146,7 +172,7 @@ struct execute_work {
  * @work: The work item in question
  */
 #define work_pending(work) \
-	test_bit(WORK_STRUCT_PENDING, work_data_bits(work))
+	test_bit(WORK_STRUCT_PENDING_BIT, work_data_bits(work))
 
 /**
  * delayed_work_pending - Find out whether a delayable work item is currently
@@ -161,16 +187,57 @@ struct execute_work {
  * @work: The work item in question
  */
 #define work_clear_pending(work) \
-	clear_bit(WORK_STRUCT_PENDING, work_data_bits(work))
+	clear_bit(WORK_STRUCT_PENDING_BIT, work_data_bits(work))
 
+/*
+ * Workqueue flags and constants.  For details, please refer to
+ * Documentation/workqueue.txt.
+ */
+enum {
+	WQ_UNBOUND		= 1 << 0, /* not bound to any cpu */
+	WQ_FREEZEABLE		= 1 << 1, /* freeze during suspend */
+	WQ_RESCUER		= 1 << 2, /* has a rescue worker */
+	WQ_HIGHPRI		= 1 << 3, /* high priority */
+	WQ_CPU_INTENSIVE	= 1 << 4, /* cpu intensive workqueue */
+	WQ_RT			= 1 << 5, /* run works with SCHED_FIFO */
+
+	__WQ_ORDERED		= 1 << 16, /* internal: workqueue is ordered */
+
+	WQ_MAX_ACTIVE		= 512,	  /* upper limit of max_active */
+	WQ_MAX_UNBOUND_PER_CPU	= 4,	  /* 4 * #cpus for unbound wq */
+	WQ_DFL_ACTIVE		= WQ_MAX_ACTIVE / 2,
+};
+
+/* unbound wq's aren't per-cpu, scale max_active according to #cpus */
+#define WQ_UNBOUND_MAX_ACTIVE	\
+	max_t(int, WQ_MAX_ACTIVE, num_possible_cpus() * WQ_MAX_UNBOUND_PER_CPU)
+
+/*
+ * System-wide workqueues which are always present.
+ *
+ * system_wq is the one used by schedule[_delayed]_work[_on]().
+ * Multi-CPU multi-threaded.  There are users which expect relatively
+ * short queue flush time.  Don't queue works which can run for too
+ * long.
+ *
+ * system_long_wq is similar to system_wq but may host long running
+ * works.  Queue flushing might take relatively long.
+ *
+ * system_unbound_wq is unbound workqueue.  Workers are not bound to
+ * any specific CPU, not concurrency managed, and all queued works are
+ * executed immediately as long as max_active limit is not reached and
+ * resources are available.
+ */
+extern struct workqueue_struct *system_wq;
+extern struct workqueue_struct *system_long_wq;
+extern struct workqueue_struct *system_unbound_wq;
 
 extern struct workqueue_struct *
-__create_workqueue_key(const char *name, int singlethread,
-		       int freezeable, int rt, struct lock_class_key *key,
-		       const char *lock_name);
+__alloc_workqueue_key(const char *name, unsigned int flags, int max_active,
+		      struct lock_class_key *key, const char *lock_name);
 
 #ifdef CONFIG_LOCKDEP
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
+#define alloc_workqueue(name, flags, max_active)		\
 ({								\
 	static struct lock_class_key __key;			\
 	const char *__lock_name;				\
@@ -180,20 +247,36 @@ __create_workqueue_key(const char *name, int singlethread,
 	else							\
 		__lock_name = #name;				\
 								\
-	__create_workqueue_key((name), (singlethread),		\
-			       (freezeable), (rt), &__key,	\
-			       __lock_name);			\
+	__alloc_workqueue_key((name), (flags), (max_active),	\
+			      &__key, __lock_name);		\
 })
 #else
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
-	__create_workqueue_key((name), (singlethread), (freezeable), (rt), \
-			       NULL, NULL)
+#define alloc_workqueue(name, flags, max_active)		\
+	__alloc_workqueue_key((name), (flags), (max_active), NULL, NULL)
 #endif
 
-#define create_workqueue(name) __create_workqueue((name), 0, 0, 0)
-#define create_rt_workqueue(name) __create_workqueue((name), 0, 0, 1)
-#define create_freezeable_workqueue(name) __create_workqueue((name), 1, 1, 0)
-#define create_singlethread_workqueue(name) __create_workqueue((name), 1, 0, 0)
+/**
+ * alloc_ordered_workqueue - allocate an ordered workqueue
+ * @name: name of the workqueue
+ * @flags: WQ_* flags (only WQ_FREEZEABLE and WQ_RESCUER are meaningful)
+ *
+ * Allocate an ordered workqueue.  An ordered workqueue executes at
+ * most one work item at any given time in the queued order.
+ *
+ * RETURNS:
+ * Pointer to the allocated workqueue on success, %NULL on failure.
+ */
+#define alloc_ordered_workqueue(name, flags)			\
+	alloc_workqueue((name), WQ_UNBOUND | __WQ_ORDERED | (flags), 1)
+
+#define create_workqueue(name)					\
+	alloc_workqueue((name), WQ_RESCUER, 1)
+#define create_rt_workqueue(name)				\
+	alloc_workqueue((name), WQ_RESCUER | WQ_RT, 1)
+#define create_freezeable_workqueue(name)			\
+	alloc_ordered_workqueue((name), WQ_FREEZEABLE | WQ_RESCUER)
+#define create_singlethread_workqueue(name)			\
+	alloc_ordered_workqueue((name), WQ_RESCUER)
 
 extern void destroy_workqueue(struct workqueue_struct *wq);
 
@@ -206,6 +289,9 @@ extern int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 			struct delayed_work *work, unsigned long delay);
 
 extern void flush_workqueue(struct workqueue_struct *wq);
+extern void workqueue_set_max_active(struct workqueue_struct *wq,
+				     int max_active);
+extern bool workqueue_congested(unsigned int cpu, struct workqueue_struct *wq);
 extern void flush_scheduled_work(void);
 extern void flush_delayed_work(struct delayed_work *work);
 
@@ -231,30 +317,14 @@ extern int cancel_work_sync(struct work_struct *work);
  * it returns 1 and the work doesn't re-arm itself. Run flush_workqueue() or
  * cancel_work_sync() to wait on it.
  */
-static inline int cancel_delayed_work(struct delayed_work *work)
-{
-	int ret;
-
-	ret = del_timer_sync(&work->timer);
-	if (ret)
-		work_clear_pending(&work->work);
-	return ret;
-}
+extern int cancel_delayed_work(struct delayed_work *work);
 
 /*
  * Like above, but uses del_timer() instead of del_timer_sync(). This means,
  * if it returns 0 the timer function may be running and the queueing is in
  * progress.
  */
-static inline int __cancel_delayed_work(struct delayed_work *work)
-{
-	int ret;
-
-	ret = del_timer(&work->timer);
-	if (ret)
-		work_clear_pending(&work->work);
-	return ret;
-}
+extern int __cancel_delayed_work(struct delayed_work *work);
 
 extern int cancel_delayed_work_sync(struct delayed_work *work);
 
@@ -273,6 +343,12 @@ void cancel_rearming_delayed_work(struct delayed_work *work)
 	cancel_delayed_work_sync(work);
 }
 
+#ifdef CONFIG_FREEZER
+extern void freeze_workqueues_begin(void);
+extern bool freeze_workqueues_busy(void);
+extern void thaw_workqueues(void);
+#endif /* CONFIG_FREEZER */
+
 #ifndef CONFIG_SMP
 static inline long work_on_cpu(unsigned int cpu, long (*fn)(void *), void *arg)
 {
@@ -240,8 +240,7 @@ static inline void inet_csk_reset_xmit_timer(struct sock *sk, const int what,
 
 extern struct sock *inet_csk_accept(struct sock *sk, int flags, int *err);
 
-extern struct request_sock *inet_csk_search_req(const struct sock *sk,
-						struct request_sock ***prevp,
+extern struct request_sock *inet_csk_search_req(struct sock *sk,
 						const __be16 rport,
 						const __be32 raddr,
 						const __be32 laddr);
@@ -252,30 +251,16 @@ extern int inet_csk_get_port(struct sock *sk, unsigned short snum);
 extern struct dst_entry* inet_csk_route_req(struct sock *sk,
 					    const struct request_sock *req);
 
-static inline void inet_csk_reqsk_queue_add(struct sock *sk,
-					    struct request_sock *req,
-					    struct sock *child)
+static inline int inet_csk_reqsk_queue_add(struct sock *sk,
+					   struct request_sock *req,
+					   struct sock *child)
 {
-	reqsk_queue_add(&inet_csk(sk)->icsk_accept_queue, req, sk, child);
+	return reqsk_queue_add(&inet_csk(sk)->icsk_accept_queue, req, sk, child);
 }
 
-extern void inet_csk_reqsk_queue_hash_add(struct sock *sk,
-					  struct request_sock *req,
-					  unsigned long timeout);
-
-static inline void inet_csk_reqsk_queue_removed(struct sock *sk,
-						struct request_sock *req)
-{
-	if (reqsk_queue_removed(&inet_csk(sk)->icsk_accept_queue, req) == 0)
-		inet_csk_delete_keepalive_timer(sk);
-}
-
-static inline void inet_csk_reqsk_queue_added(struct sock *sk,
-					      const unsigned long timeout)
-{
-	if (reqsk_queue_added(&inet_csk(sk)->icsk_accept_queue) == 0)
-		inet_csk_reset_keepalive_timer(sk, timeout);
-}
+extern int inet_csk_reqsk_queue_hash_add(struct sock *sk,
+					 struct request_sock *req,
+					 unsigned long timeout);
 
 static inline int inet_csk_reqsk_queue_len(const struct sock *sk)
 {
@@ -292,22 +277,24 @@ static inline int inet_csk_reqsk_queue_is_full(const struct sock *sk)
 	return reqsk_queue_is_full(&inet_csk(sk)->icsk_accept_queue);
 }
 
-static inline void inet_csk_reqsk_queue_unlink(struct sock *sk,
-					       struct request_sock *req,
-					       struct request_sock **prev)
+static inline int inet_csk_reqsk_queue_unlink(struct sock *sk,
+					      struct request_sock *req)
 {
-	reqsk_queue_unlink(&inet_csk(sk)->icsk_accept_queue, req, prev);
+	return reqsk_queue_unlink(&inet_csk(sk)->icsk_accept_queue, req);
 }
 
 static inline void inet_csk_reqsk_queue_drop(struct sock *sk,
-					     struct request_sock *req,
-					     struct request_sock **prev)
+					     struct request_sock *req)
 {
-	inet_csk_reqsk_queue_unlink(sk, req, prev);
-	inet_csk_reqsk_queue_removed(sk, req);
-	reqsk_free(req);
+	if (inet_csk_reqsk_queue_unlink(sk, req))
+		reqsk_put(req);
 }
 
+extern struct sock *inet_csk_complete_hashdance(struct sock *sk,
+						struct sock *child,
+						struct request_sock *req,
+						int own_req);
+
 extern void inet_csk_reqsk_queue_prune(struct sock *parent,
 				       const unsigned long interval,
 				       const unsigned long timeout,
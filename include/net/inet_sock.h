@@ -85,7 +85,7 @@ struct inet_request_sock {
 				acked	   : 1,
 				no_srccheck: 1;
 	kmemcheck_bitfield_end(flags);
-	struct ip_options_rcu	*opt;
+	struct ip_options_rcu	__rcu *opt;
 };
 
 static inline struct inet_request_sock *inet_rsk(const struct request_sock *sk)
@@ -130,7 +130,7 @@ struct inet_sock {
 	__be32			saddr;
 	__s16			uc_ttl;
 	__u16			cmsg_flags;
-	struct ip_options_rcu	*inet_opt;
+	struct ip_options_rcu	__rcu *inet_opt;
 	__be16			sport;
 	__u16			id;
 	__u8			tos;
@@ -220,6 +220,18 @@ static inline struct request_sock *inet_reqsk_alloc(struct request_sock_ops *ops
 	return req;
 }
 
+/*
+ * IP options to answer @req with, under rcu_read_lock().  A Fast Open
+ * child @sk has already taken them over from the request.
+ */
+static inline struct ip_options_rcu *inet_req_opt(const struct sock *sk,
+						  const struct request_sock *req)
+{
+	if (sk->sk_state != TCP_LISTEN)
+		return rcu_dereference(inet_sk(sk)->inet_opt);
+	return rcu_dereference(inet_rsk(req)->opt);
+}
+
 static inline __u8 inet_sk_flowi_flags(const struct sock *sk)
 {
 	return inet_sk(sk)->transparent ? FLOWI_FLAG_ANYSRC : 0;
@@ -27,6 +27,12 @@ struct inet_peer
 	atomic_t		rid;		/* Frag reception counter */
 	__u32			tcp_ts;
 	unsigned long		tcp_ts_stamp;
+	/* TCP Fast Open client cache, see tcp_fastopen_cache_get() */
+	__u16			tcp_fastopen_mss;
+	__u8			tcp_fastopen_syn_loss;	/* recurring losses */
+	__s8			tcp_fastopen_cookie_len;
+	unsigned long		tcp_fastopen_last_syn_loss;
+	__u8			tcp_fastopen_cookie[16];
 };
 
 void			inet_initpeers(void) __init;
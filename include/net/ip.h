@@ -188,6 +188,17 @@ extern struct local_ports {
 } sysctl_local_ports;
 extern void inet_get_local_port_range(int *low, int *high);
 
+extern struct sk_buff *inet_tunnel_gso_segment(struct sk_buff *skb,
+					       int features,
+					       unsigned int tnl_hlen,
+					       __be16 protocol, int gso_type);
+extern struct sk_buff **inet_tunnel_gro_receive(struct sk_buff **head,
+						struct sk_buff *skb,
+						unsigned int tnl_hlen,
+						__be16 protocol);
+extern int inet_tunnel_gro_complete(struct sk_buff *skb, unsigned int off,
+				    __be16 protocol, int gso_type);
+
 extern int sysctl_ip_default_ttl;
 extern int sysctl_ip_nonlocal_bind;
 
@@ -373,6 +384,7 @@ extern int ip_options_get(struct net *net, struct ip_options_rcu **optp,
 extern int ip_options_get_from_user(struct net *net, struct ip_options_rcu **optp,
 				    unsigned char __user *data, int optlen);
 extern void ip_options_undo(struct ip_options * opt);
+extern void ip_options_free_rcu(struct ip_options_rcu *opt);
 extern void ip_forward_options(struct sk_buff *skb);
 extern int ip_options_rcv_srr(struct sk_buff *skb);
 
@@ -65,6 +65,7 @@ struct fib6_node
 	__u16			fn_flags;
 	__u32			fn_sernum;
 	struct rt6_info		*rr_ptr;
+	struct rcu_head		rcu;
 };
 
 #ifndef CONFIG_IPV6_SUBTREES
@@ -157,10 +158,17 @@ struct rt6_statistics {
  */
 
 
+/*
+ * Writers modify the tree under tb6_lock and inside a tb6_seq write
+ * section.  Route lookups only take rcu_read_lock_bh() and retry when
+ * tb6_seq changed under them; nodes and routes unlinked from the tree
+ * are freed after an RCU-bh grace period.
+ */
 struct fib6_table {
 	struct hlist_node	tb6_hlist;
 	u32			tb6_id;
 	rwlock_t		tb6_lock;
+	seqcount_t		tb6_seq;
 	struct fib6_node	tb6_root;
 };
 
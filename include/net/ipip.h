@@ -34,12 +34,77 @@ struct ip_tunnel_prl_entry
 	u16				flags;
 };
 
+/*
+ * Offloads advertised by GRE and IPIP devices: a GSO packet is only
+ * segmented once it reaches the underlying device, see
+ * inet_tunnel_gso_segment().
+ */
+#define IPTUNNEL_FEATURES	(NETIF_F_SG | NETIF_F_HW_CSUM |		\
+				 NETIF_F_HIGHDMA | NETIF_F_GSO_SOFTWARE | \
+				 NETIF_F_UFO)
+
+/*
+ * Called once the tunnel owns @skb, before the outer headers are built:
+ * a GSO packet is flagged with the tunnel's @gso_type, otherwise a
+ * pending checksum is resolved if @csum_help says the underlying
+ * device can not compute it past the outer headers.
+ */
+static inline int iptunnel_handle_offloads(struct sk_buff *skb,
+					   bool csum_help, int gso_type)
+{
+	if (skb_is_gso(skb)) {
+		skb_shinfo(skb)->gso_type |= gso_type;
+		return 0;
+	}
+
+	if (skb->ip_summed == CHECKSUM_PARTIAL && csum_help)
+		return skb_checksum_help(skb);
+
+	return 0;
+}
+
+/*
+ * One SKB_GSO_* flag can not describe two levels of the same tunnel, so
+ * a GSO packet that already carries @gso_type is segmented in software
+ * and the segments go through @xmit one by one.
+ */
+static inline bool iptunnel_gso_nested(const struct sk_buff *skb,
+				       int gso_type)
+{
+	return skb_is_gso(skb) && (skb_shinfo(skb)->gso_type & gso_type);
+}
+
+static inline netdev_tx_t iptunnel_xmit_segs(struct sk_buff *skb,
+					     struct net_device *dev,
+					     netdev_tx_t (*xmit)(struct sk_buff *,
+								 struct net_device *))
+{
+	struct sk_buff *segs, *next;
+
+	segs = skb_gso_segment(skb, 0);
+	kfree_skb(skb);
+	if (IS_ERR(segs) || !segs) {
+		dev->stats.tx_dropped++;
+		return NETDEV_TX_OK;
+	}
+
+	for (; segs; segs = next) {
+		next = segs->next;
+		segs->next = NULL;
+		xmit(segs, dev);
+	}
+	return NETDEV_TX_OK;
+}
+
 #define IPTUNNEL_XMIT() do {						\
 	int err;							\
 	int pkt_len = skb->len - skb_transport_offset(skb);		\
 									\
-	skb->ip_summed = CHECKSUM_NONE;					\
-	ip_select_ident(iph, &rt->u.dst, NULL);				\
+	if (skb->ip_summed != CHECKSUM_PARTIAL)				\
+		skb->ip_summed = CHECKSUM_NONE;				\
+	ip_select_ident_more(iph, &rt->u.dst, NULL,			\
+			     skb_shinfo(skb)->gso_segs ?		\
+			     skb_shinfo(skb)->gso_segs - 1 : 0);	\
 									\
 	err = ip_local_out(skb);					\
 	if (net_xmit_eval(err) == 0) {					\
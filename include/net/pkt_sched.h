@@ -66,8 +66,14 @@ struct qdisc_watchdog {
 };
 
 extern void qdisc_watchdog_init(struct qdisc_watchdog *wd, struct Qdisc *qdisc);
-extern void qdisc_watchdog_schedule(struct qdisc_watchdog *wd,
-				    psched_time_t expires);
+extern void qdisc_watchdog_schedule_ns(struct qdisc_watchdog *wd, u64 expires);
+
+static inline void qdisc_watchdog_schedule(struct qdisc_watchdog *wd,
+					   psched_time_t expires)
+{
+	qdisc_watchdog_schedule_ns(wd, PSCHED_TICKS2NS(expires));
+}
+
 extern void qdisc_watchdog_cancel(struct qdisc_watchdog *wd);
 
 extern struct Qdisc_ops pfifo_qdisc_ops;
@@ -99,6 +105,18 @@ static inline void qdisc_run(struct Qdisc *q)
 		__qdisc_run(q);
 }
 
+/*
+ * Give up dequeue ownership.  Packets other CPUs deferred after our
+ * last dequeue would be stranded, hand them to net_tx_action().
+ */
+static inline void qdisc_run_end(struct Qdisc *q)
+{
+	clear_bit(__QDISC_STATE_RUNNING, &q->state);
+	smp_mb__after_clear_bit();
+	if (unlikely(q->defer_list))
+		__netif_schedule(q);
+}
+
 extern int tc_classify_compat(struct sk_buff *skb, struct tcf_proto *tp,
 			      struct tcf_result *res);
 extern int tc_classify(struct sk_buff *skb, struct tcf_proto *tp,
@@ -21,6 +21,7 @@
 #include <linux/bug.h>
 
 #include <net/sock.h>
+#include <net/tcp_states.h>
 
 struct request_sock;
 struct sk_buff;
@@ -52,6 +53,8 @@ struct request_sock {
 	u32				window_clamp; /* window clamp at creation time */
 	u32				rcv_wnd;	  /* rcv_wnd offered first time */
 	u32				ts_recent;
+	atomic_t			rsk_refcnt;
+	u32				rsk_hash;	  /* syn_table bucket */
 	unsigned long			expires;
 	const struct request_sock_ops	*rsk_ops;
 	struct sock			*sk;
@@ -63,8 +66,10 @@ static inline struct request_sock *reqsk_alloc(const struct request_sock_ops *op
 {
 	struct request_sock *req = kmem_cache_alloc(ops->slab, GFP_ATOMIC);
 
-	if (req != NULL)
+	if (req != NULL) {
 		req->rsk_ops = ops;
+		atomic_set(&req->rsk_refcnt, 1);
+	}
 
 	return req;
 }
@@ -80,6 +85,17 @@ static inline void reqsk_free(struct request_sock *req)
 	__reqsk_free(req);
 }
 
+/*
+ * A hashed request is referenced by the syn_table and, while a packet for
+ * it is being processed, by the CPU that looked it up: whoever unlinks it
+ * from the table inherits the table's reference.
+ */
+static inline void reqsk_put(struct request_sock *req)
+{
+	if (atomic_dec_and_test(&req->rsk_refcnt))
+		reqsk_free(req);
+}
+
 extern int sysctl_max_syn_backlog;
 
 /** struct listen_sock - listen state
@@ -101,24 +117,35 @@ struct listen_sock {
  *
  * @rskq_accept_head - FIFO head of established children
  * @rskq_accept_tail - FIFO tail of established children
+ * @rskq_lock - serializer of the accept queue
  * @rskq_defer_accept - User waits for some data after accept()
- * @syn_wait_lock - serializer
+ * @syn_wait_lock - serializer of the syn_table
+ * @fastopen_qlen - TCP Fast Open children whose SYN-ACK is not acked yet
+ * @fastopen_max_qlen - limit of @fastopen_qlen, 0 disables Fast Open
  *
- * %syn_wait_lock is necessary only to avoid proc interface having to grab the main
- * lock sock while browsing the listening hash (otherwise it's deadlock prone).
+ * SYNs and handshake ACKs for a listening socket may be processed without
+ * the main sock lock, so the queues have locks of their own.
  *
- * This lock is acquired in read mode only from listening_get_next() seq_file
- * op and it's acquired in write mode _only_ from code that is actively
- * changing rskq_accept_head. All readers that are holding the master sock lock
- * don't need to grab this lock in read mode too as rskq_accept_head. writes
- * are always protected from the main sock lock.
+ * %syn_wait_lock is acquired in write mode by whoever links or unlinks a
+ * request_sock or changes the queue lengths, and in read mode to look up a
+ * request_sock (the lookup takes a reference on it) and from the proc and
+ * inet_diag interfaces.  It also protects @listen_opt against
+ * reqsk_queue_destroy(), which frees it only after an RCU grace period so
+ * that the lockless queue length checks stay safe.
+ *
+ * %rskq_lock protects the accept queue and sk_ack_backlog.  Appending a
+ * child is the only step of a passive open that serializes with the other
+ * CPUs; it fails once the parent stopped listening.
  */
 struct request_sock_queue {
 	struct request_sock	*rskq_accept_head;
 	struct request_sock	*rskq_accept_tail;
+	spinlock_t		rskq_lock;
 	rwlock_t		syn_wait_lock;
 	u8			rskq_defer_accept;
 	/* 3 bytes hole, try to pack */
+	atomic_t		fastopen_qlen;
+	int			fastopen_max_qlen;
 	struct listen_sock	*listen_opt;
 };
 
@@ -131,9 +158,12 @@ extern void reqsk_queue_destroy(struct request_sock_queue *queue);
 static inline struct request_sock *
 	reqsk_queue_yank_acceptq(struct request_sock_queue *queue)
 {
-	struct request_sock *req = queue->rskq_accept_head;
+	struct request_sock *req;
 
+	spin_lock_bh(&queue->rskq_lock);
+	req = queue->rskq_accept_head;
 	queue->rskq_accept_head = NULL;
+	spin_unlock_bh(&queue->rskq_lock);
 	return req;
 }
 
@@ -142,20 +172,49 @@ static inline int reqsk_queue_empty(struct request_sock_queue *queue)
 	return queue->rskq_accept_head == NULL;
 }
 
-static inline void reqsk_queue_unlink(struct request_sock_queue *queue,
-				      struct request_sock *req,
-				      struct request_sock **prev_req)
+/*
+ * Returns 1 if @req was still hashed, in which case the caller now owns the
+ * reference the syn_table held on it, 0 if somebody else unlinked it first.
+ */
+static inline int reqsk_queue_unlink(struct request_sock_queue *queue,
+				     struct request_sock *req)
 {
+	struct listen_sock *lopt;
+	struct request_sock **prev;
+	int found = 0;
+
 	write_lock(&queue->syn_wait_lock);
-	*prev_req = req->dl_next;
+	lopt = queue->listen_opt;
+	if (lopt == NULL)
+		goto out;
+
+	for (prev = &lopt->syn_table[req->rsk_hash]; *prev != NULL;
+	     prev = &(*prev)->dl_next) {
+		if (*prev == req) {
+			*prev = req->dl_next;
+			if (req->retrans == 0)
+				lopt->qlen_young--;
+			lopt->qlen--;
+			found = 1;
+			break;
+		}
+	}
+out:
 	write_unlock(&queue->syn_wait_lock);
+	return found;
 }
 
-static inline void reqsk_queue_add(struct request_sock_queue *queue,
-				   struct request_sock *req,
-				   struct sock *parent,
-				   struct sock *child)
+static inline int reqsk_queue_add(struct request_sock_queue *queue,
+				  struct request_sock *req,
+				  struct sock *parent,
+				  struct sock *child)
 {
+	spin_lock(&queue->rskq_lock);
+	if (unlikely(parent->sk_state != TCP_LISTEN)) {
+		spin_unlock(&queue->rskq_lock);
+		return 0;
+	}
+
 	req->sk = child;
 	sk_acceptq_added(parent);
 
@@ -166,6 +225,8 @@ static inline void reqsk_queue_add(struct request_sock_queue *queue,
 
 	queue->rskq_accept_tail = req;
 	req->dl_next = NULL;
+	spin_unlock(&queue->rskq_lock);
+	return 1;
 }
 
 static inline struct request_sock *reqsk_queue_remove(struct request_sock_queue *queue)
@@ -184,66 +245,60 @@ static inline struct request_sock *reqsk_queue_remove(struct request_sock_queue
 static inline struct sock *reqsk_queue_get_child(struct request_sock_queue *queue,
 						 struct sock *parent)
 {
-	struct request_sock *req = reqsk_queue_remove(queue);
-	struct sock *child = req->sk;
-
-	WARN_ON(child == NULL);
+	struct request_sock *req;
+	struct sock *child;
 
+	spin_lock_bh(&queue->rskq_lock);
+	req = reqsk_queue_remove(queue);
 	sk_acceptq_removed(parent);
-	__reqsk_free(req);
-	return child;
-}
-
-static inline int reqsk_queue_removed(struct request_sock_queue *queue,
-				      struct request_sock *req)
-{
-	struct listen_sock *lopt = queue->listen_opt;
+	spin_unlock_bh(&queue->rskq_lock);
 
-	if (req->retrans == 0)
-		--lopt->qlen_young;
-
-	return --lopt->qlen;
-}
-
-static inline int reqsk_queue_added(struct request_sock_queue *queue)
-{
-	struct listen_sock *lopt = queue->listen_opt;
-	const int prev_qlen = lopt->qlen;
+	child = req->sk;
+	WARN_ON(child == NULL);
 
-	lopt->qlen_young++;
-	lopt->qlen++;
-	return prev_qlen;
+	reqsk_put(req);
+	return child;
 }
 
 static inline int reqsk_queue_len(const struct request_sock_queue *queue)
 {
-	return queue->listen_opt != NULL ? queue->listen_opt->qlen : 0;
+	const struct listen_sock *lopt = ACCESS_ONCE(queue->listen_opt);
+
+	return lopt != NULL ? lopt->qlen : 0;
 }
 
 static inline int reqsk_queue_len_young(const struct request_sock_queue *queue)
 {
-	return queue->listen_opt->qlen_young;
+	const struct listen_sock *lopt = ACCESS_ONCE(queue->listen_opt);
+
+	return lopt != NULL ? lopt->qlen_young : 0;
 }
 
 static inline int reqsk_queue_is_full(const struct request_sock_queue *queue)
 {
-	return queue->listen_opt->qlen >> queue->listen_opt->max_qlen_log;
+	const struct listen_sock *lopt = ACCESS_ONCE(queue->listen_opt);
+
+	return lopt != NULL ? lopt->qlen >> lopt->max_qlen_log : 0;
 }
 
-static inline void reqsk_queue_hash_req(struct request_sock_queue *queue,
-					u32 hash, struct request_sock *req,
-					unsigned long timeout)
+/*
+ * Link @req into bucket @hash of @lopt, the caller holds syn_wait_lock in
+ * write mode.  The syn_table takes over the caller's reference.  Returns
+ * the queue length before the insertion.
+ */
+static inline int reqsk_queue_hash_req(struct listen_sock *lopt,
+				       u32 hash, struct request_sock *req,
+				       unsigned long timeout)
 {
-	struct listen_sock *lopt = queue->listen_opt;
-
 	req->expires = jiffies + timeout;
 	req->retrans = 0;
 	req->sk = NULL;
+	req->rsk_hash = hash;
 	req->dl_next = lopt->syn_table[hash];
-
-	write_lock(&queue->syn_wait_lock);
 	lopt->syn_table[hash] = req;
-	write_unlock(&queue->syn_wait_lock);
+
+	lopt->qlen_young++;
+	return lopt->qlen++;
 }
 
 #endif /* _REQUEST_SOCK_H */
@@ -47,6 +47,7 @@ struct Qdisc
 #define TCQ_F_INGRESS		4
 #define TCQ_F_CAN_BYPASS	8
 #define TCQ_F_MQROOT		16
+#define TCQ_F_DEFER		32 /* enqueue may be deferred, see qdisc_defer_skb() */
 #define TCQ_F_WARN_NONWC	(1 << 16)
 	int			padded;
 	struct Qdisc_ops	*ops;
@@ -76,6 +77,8 @@ struct Qdisc
 	struct sk_buff_head	q;
 	struct gnet_stats_basic_packed bstats;
 	struct gnet_stats_queue	qstats;
+	struct sk_buff		*defer_list;
+	spinlock_t		busylock;
 };
 
 struct Qdisc_class_ops
@@ -400,6 +403,38 @@ static inline int qdisc_enqueue_root(struct sk_buff *skb, struct Qdisc *sch)
 	return qdisc_enqueue(skb, sch) & NET_XMIT_MASK;
 }
 
+/*
+ * Lockless enqueue for TCQ_F_DEFER qdiscs while another CPU owns the
+ * dequeue side (__QDISC_STATE_RUNNING): the skb is pushed on
+ * sch->defer_list and the owner splices it into the queue under the
+ * root lock before its next dequeue.
+ *
+ * Returns false if the owner stopped running meanwhile; the skb is on
+ * the list then, and the caller must splice and run the qdisc itself.
+ */
+static inline bool qdisc_defer_skb(struct sk_buff *skb, struct Qdisc *sch)
+{
+	struct sk_buff *head;
+
+	do {
+		head = ACCESS_ONCE(sch->defer_list);
+		skb->next = head;
+	} while (cmpxchg(&sch->defer_list, head, skb) != head);
+
+	/* Pairs with the barrier in qdisc_run_end() */
+	smp_mb();
+	return test_bit(__QDISC_STATE_RUNNING, &sch->state);
+}
+
+extern void __qdisc_splice_deferred(struct Qdisc *sch);
+
+/* Under qdisc_lock(sch) */
+static inline void qdisc_splice_deferred(struct Qdisc *sch)
+{
+	if (unlikely(sch->defer_list))
+		__qdisc_splice_deferred(sch);
+}
+
 static inline void __qdisc_update_bstats(struct Qdisc *sch, unsigned int len)
 {
 	sch->bstats.bytes += len;
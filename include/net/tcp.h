@@ -167,6 +167,11 @@ extern void tcp_time_wait(struct sock *sk, int state, int timeo);
 #define TCPOPT_SACK             5       /* SACK Block */
 #define TCPOPT_TIMESTAMP	8	/* Better RTT estimations/PAWS */
 #define TCPOPT_MD5SIG		19	/* MD5 Signature (RFC2385) */
+#define TCPOPT_EXP		254	/* Experimental */
+/* Magic number to be after the option value for sharing TCP
+ * experimental options. See draft-ietf-tcpm-experimental-options-00.txt
+ */
+#define TCPOPT_FASTOPEN_MAGIC	0xF989
 
 /*
  *     TCP option lengths
@@ -177,6 +182,7 @@ extern void tcp_time_wait(struct sock *sk, int state, int timeo);
 #define TCPOLEN_SACK_PERM      2
 #define TCPOLEN_TIMESTAMP      10
 #define TCPOLEN_MD5SIG         18
+#define TCPOLEN_EXP_FASTOPEN_BASE  4
 
 /* But this is what stacks really send out. */
 #define TCPOLEN_TSTAMP_ALIGNED		12
@@ -237,6 +243,8 @@ extern int sysctl_tcp_base_mss;
 extern int sysctl_tcp_workaround_signed_windows;
 extern int sysctl_tcp_slow_start_after_idle;
 extern int sysctl_tcp_max_ssthresh;
+extern int sysctl_tcp_fastopen;
+extern int sysctl_tcp_limit_output_bytes;
 
 extern atomic_t tcp_memory_allocated;
 extern struct percpu_counter tcp_sockets_allocated;
@@ -384,7 +392,7 @@ extern enum tcp_tw_status	tcp_timewait_state_process(struct inet_timewait_sock *
 
 extern struct sock *		tcp_check_req(struct sock *sk,struct sk_buff *skb,
 					      struct request_sock *req,
-					      struct request_sock **prev);
+					      int fastopen);
 extern int			tcp_child_process(struct sock *parent,
 						  struct sock *child,
 						  struct sk_buff *skb);
@@ -419,7 +427,8 @@ extern int			tcp_recvmsg(struct kiocb *iocb, struct sock *sk,
 
 extern void			tcp_parse_options(struct sk_buff *skb,
 						  struct tcp_options_received *opt_rx,
-						  int estab);
+						  int estab,
+						  struct tcp_fastopen_cookie *foc);
 
 extern u8			*tcp_parse_md5sig_option(struct tcphdr *th);
 
@@ -453,7 +462,8 @@ extern int			tcp_connect(struct sock *sk);
 
 extern struct sk_buff *		tcp_make_synack(struct sock *sk,
 						struct dst_entry *dst,
-						struct request_sock *req);
+						struct request_sock *req,
+						struct tcp_fastopen_cookie *foc);
 
 extern int			tcp_disconnect(struct sock *sk, int flags);
 
@@ -473,6 +483,30 @@ extern struct sock *cookie_v6_check(struct sock *sk, struct sk_buff *skb);
 extern __u32 cookie_v6_init_sequence(struct sock *sk, struct sk_buff *skb,
 				     __u16 *mss);
 
+/* From tcp_fastopen.c, bits of sysctl_tcp_fastopen */
+#define TFO_CLIENT_ENABLE	1	/* sendmsg(MSG_FASTOPEN) sends SYN data */
+#define TFO_SERVER_ENABLE	2	/* TCP_FASTOPEN listeners accept it */
+#define TFO_CLIENT_NO_COOKIE	4	/* Data in SYN w/o cookie option */
+/* Process SYN data but skip cookie validation */
+#define TFO_SERVER_COOKIE_NOT_CHKED	0x100
+/* Accept SYN data w/o any cookie option */
+#define TFO_SERVER_COOKIE_NOT_REQD	0x200
+
+#define TCP_FASTOPEN_KEY_LENGTH	16
+
+extern void tcp_fastopen_get_key(u32 *key);
+extern int tcp_fastopen_reset_cipher(void *key, unsigned int len);
+extern void tcp_fastopen_cookie_gen(__be32 addr,
+				    struct tcp_fastopen_cookie *foc);
+extern void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+				   struct tcp_fastopen_cookie *cookie,
+				   int *syn_loss, unsigned long *last_syn_loss);
+extern void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+				   struct tcp_fastopen_cookie *cookie,
+				   int syn_lost);
+extern void tcp_fastopen_remove_req(struct sock *sk);
+extern void tcp_free_fastopen_req(struct tcp_sock *tp);
+
 /* tcp_output.c */
 
 extern void __tcp_push_pending_frames(struct sock *sk, unsigned int cur_mss,
@@ -494,6 +528,8 @@ extern int  tcp_send_synack(struct sock *);
 extern void tcp_push_one(struct sock *, unsigned int mss_now);
 extern void tcp_send_ack(struct sock *sk);
 extern void tcp_send_delayed_ack(struct sock *sk);
+extern void tcp_release_cb(struct sock *sk);
+extern void __init tcp_tasklet_init(void);
 
 /* tcp_input.c */
 extern void tcp_cwnd_application_limited(struct sock *sk);
@@ -541,6 +577,8 @@ extern int tcp_read_sock(struct sock *sk, read_descriptor_t *desc,
 			 sk_read_actor_t recv_actor);
 
 extern void tcp_initialize_rcv_mss(struct sock *sk);
+extern void tcp_init_buffer_space(struct sock *sk);
+extern void tcp_reset(struct sock *sk);
 
 extern int tcp_mtu_to_mss(struct sock *sk, int pmtu);
 extern int tcp_mss_to_mtu(struct sock *sk, int mss);
@@ -1026,6 +1064,8 @@ static inline void tcp_openreq_init(struct request_sock *req,
 	req->rcv_wnd = 0;		/* So that tcp_send_synack() knows! */
 	req->cookie_ts = 0;
 	tcp_rsk(req)->rcv_isn = TCP_SKB_CB(skb)->seq;
+	tcp_rsk(req)->rcv_nxt = TCP_SKB_CB(skb)->seq + 1;
+	tcp_rsk(req)->listener = NULL;
 	req->mss = rx_opt->mss_clamp;
 	req->ts_recent = rx_opt->saw_tstamp ? rx_opt->rcv_tsval : 0;
 	ireq->tstamp_ok = rx_opt->tstamp_ok;
@@ -1244,6 +1284,22 @@ static inline void		tcp_put_md5sig_pool(void)
 	put_cpu();
 }
 
+/*
+ * SYNs and handshake ACKs for a listener are processed without the socket
+ * lock, unless it has TCP-MD5 keys: those only change under the socket lock.
+ * md5sig_info is never freed before the socket is destroyed, and the
+ * setsockopt that installs it on a listener waits for the lockless packet
+ * processing already in flight.
+ */
+static inline int tcp_listen_lockless(const struct sock *sk)
+{
+#ifdef CONFIG_TCP_MD5SIG
+	if (tcp_sk(sk)->md5sig_info)
+		return 0;
+#endif
+	return sk->sk_state == TCP_LISTEN;
+}
+
 /* write queue abstraction */
 static inline void tcp_write_queue_purge(struct sock *sk)
 {
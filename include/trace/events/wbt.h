@@ -0,0 +1,124 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM wbt
+
+#if !defined(_TRACE_WBT_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_WBT_H
+
+#include <linux/tracepoint.h>
+#include <linux/backing-dev.h>
+#include <linux/device.h>
+
+#define wbt_bdi_name(bdi)	((bdi)->dev ? dev_name((bdi)->dev) : "none")
+
+TRACE_EVENT(wbt_stat,
+
+	TP_PROTO(struct backing_dev_info *bdi, u64 rmin, u64 rmax,
+		 unsigned int nr_read, unsigned int nr_write),
+
+	TP_ARGS(bdi, rmin, rmax, nr_read, nr_write),
+
+	TP_STRUCT__entry(
+		__array(	char,		name,	32	)
+		__field(	u64,		rmin		)
+		__field(	u64,		rmax		)
+		__field(	unsigned int,	nr_read		)
+		__field(	unsigned int,	nr_write	)
+	),
+
+	TP_fast_assign(
+		strncpy(__entry->name, wbt_bdi_name(bdi), 32);
+		__entry->rmin		= rmin;
+		__entry->rmax		= rmax;
+		__entry->nr_read	= nr_read;
+		__entry->nr_write	= nr_write;
+	),
+
+	TP_printk("%s: rmin=%llu, rmax=%llu, reads=%u, writes=%u",
+		  __entry->name, (unsigned long long)__entry->rmin,
+		  (unsigned long long)__entry->rmax,
+		  __entry->nr_read, __entry->nr_write)
+);
+
+TRACE_EVENT(wbt_lat,
+
+	TP_PROTO(struct backing_dev_info *bdi, u64 lat),
+
+	TP_ARGS(bdi, lat),
+
+	TP_STRUCT__entry(
+		__array(	char,	name,	32	)
+		__field(	u64,	lat		)
+	),
+
+	TP_fast_assign(
+		strncpy(__entry->name, wbt_bdi_name(bdi), 32);
+		__entry->lat = lat;
+	),
+
+	TP_printk("%s: latency %lluns", __entry->name,
+		  (unsigned long long)__entry->lat)
+);
+
+TRACE_EVENT(wbt_step,
+
+	TP_PROTO(struct backing_dev_info *bdi, const char *msg,
+		 int step, u64 window, unsigned int bg, unsigned int normal,
+		 unsigned int max),
+
+	TP_ARGS(bdi, msg, step, window, bg, normal, max),
+
+	TP_STRUCT__entry(
+		__array(	char,		name,	32	)
+		__field(	const char *,	msg		)
+		__field(	int,		step		)
+		__field(	u64,		window		)
+		__field(	unsigned int,	bg		)
+		__field(	unsigned int,	normal		)
+		__field(	unsigned int,	max		)
+	),
+
+	TP_fast_assign(
+		strncpy(__entry->name, wbt_bdi_name(bdi), 32);
+		__entry->msg	= msg;
+		__entry->step	= step;
+		__entry->window	= window;
+		__entry->bg	= bg;
+		__entry->normal	= normal;
+		__entry->max	= max;
+	),
+
+	TP_printk("%s: %s: step=%d, window=%lluns, background=%u, normal=%u, max=%u",
+		  __entry->name, __entry->msg, __entry->step,
+		  (unsigned long long)__entry->window,
+		  __entry->bg, __entry->normal, __entry->max)
+);
+
+TRACE_EVENT(wbt_timer,
+
+	TP_PROTO(struct backing_dev_info *bdi, unsigned int status,
+		 int step, unsigned int inflight),
+
+	TP_ARGS(bdi, status, step, inflight),
+
+	TP_STRUCT__entry(
+		__array(	char,		name,	32	)
+		__field(	unsigned int,	status		)
+		__field(	int,		step		)
+		__field(	unsigned int,	inflight	)
+	),
+
+	TP_fast_assign(
+		strncpy(__entry->name, wbt_bdi_name(bdi), 32);
+		__entry->status		= status;
+		__entry->step		= step;
+		__entry->inflight	= inflight;
+	),
+
+	TP_printk("%s: status=%u, step=%d, inflight=%u", __entry->name,
+		  __entry->status, __entry->step, __entry->inflight)
+);
+
+#endif /* _TRACE_WBT_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -985,6 +985,7 @@ NORET_TYPE void do_exit(long code)
 	check_stack_usage();
 	exit_thread();
 	cgroup_exit(tsk, 1);
+	sched_autogroup_exit_task(tsk);
 
 	if (group_dead && tsk->signal->leader)
 		disassociate_ctty(1);
@@ -155,6 +155,7 @@ void free_task(struct task_struct *tsk)
 	free_thread_info(tsk->stack);
 	rt_mutex_debug_task_free(tsk);
 	ftrace_graph_exit_task(tsk);
+	task_numa_free(tsk);
 	free_task_struct(tsk);
 }
 EXPORT_SYMBOL(free_task);
@@ -273,6 +274,9 @@ static struct task_struct *dup_task_struct(struct task_struct *orig)
 	tsk->btrace_seq = 0;
 #endif
 	tsk->splice_pipe = NULL;
+#ifdef CONFIG_NUMA_BALANCING
+	tsk->numa_faults = NULL;
+#endif
 
 	account_kernel_stack(ti, 1);
 
@@ -455,6 +459,23 @@ static void mm_init_aio(struct mm_struct *mm)
 #endif
 }
 
+static void mm_init_futex(struct mm_struct *mm)
+{
+#ifdef CONFIG_FUTEX
+	mm->futex_hash = NULL;
+	mm->futex_hash_mask = 0;
+#endif
+}
+
+static void mm_init_numa(struct mm_struct *mm)
+{
+#ifdef CONFIG_NUMA_BALANCING
+	mm->numa_next_scan = jiffies +
+		msecs_to_jiffies(sysctl_numa_balancing_scan_delay);
+	mm->numa_scan_offset = 0;
+#endif
+}
+
 static struct mm_struct * mm_init(struct mm_struct * mm, struct task_struct *p)
 {
 	atomic_set(&mm->mm_users, 1);
@@ -471,6 +492,8 @@ static struct mm_struct * mm_init(struct mm_struct * mm, struct task_struct *p)
 	mm->free_area_cache = TASK_UNMAPPED_BASE;
 	mm->cached_hole_size = ~0UL;
 	mm_init_aio(mm);
+	mm_init_futex(mm);
+	mm_init_numa(mm);
 	mm_init_owner(mm, p);
 
 	if (likely(!mm_alloc_pgd(mm))) {
@@ -524,6 +547,7 @@ void mmput(struct mm_struct *mm)
 		exit_aio(mm);
 		ksm_exit(mm);
 		exit_mmap(mm);
+		futex_hash_free(mm);
 		set_mm_exe_file(mm, NULL);
 		if (!list_empty(&mm->mmlist)) {
 			spin_lock(&mmlist_lock);
@@ -922,6 +946,8 @@ static int copy_signal(unsigned long clone_flags, struct task_struct *tsk)
 
 	sig->oom_adj = current->signal->oom_adj;
 
+	sched_autogroup_fork(sig);
+
 	return 0;
 }
 
@@ -929,6 +955,7 @@ void __cleanup_signal(struct signal_struct *sig)
 {
 	thread_group_cputime_free(sig);
 	tty_kref_put(sig->tty);
+	sched_autogroup_exit(sig);
 	kmem_cache_free(signal_cachep, sig);
 }
 
@@ -1102,6 +1129,10 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 	task_io_accounting_init(&p->ioac);
 	acct_clear_integrals(p);
 
+	p->nr_dirtied = 0;
+	p->nr_dirtied_pause = 128 >> (PAGE_SHIFT - 10);
+	p->dirty_paused_when = 0;
+
 	posix_cpu_timers_init(p);
 
 	p->lock_depth = -1;		/* -1 = no lock */
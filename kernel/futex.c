@@ -59,6 +59,12 @@
 #include <linux/magic.h>
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
+#include <linux/bootmem.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/prctl.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include <asm/futex.h>
 
@@ -66,7 +72,11 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
+/* Buckets per possible CPU in the global hash */
+#define FUTEX_HASH_PER_CPU	(CONFIG_BASE_SMALL ? 16 : 256)
+
+/* Upper bound for a process private hash, see futex_hash_prctl() */
+#define FUTEX_PRIVATE_HASH_MAX	4096
 
 /*
  * Priority Inheritance state:
@@ -130,19 +140,60 @@ struct futex_q {
 struct futex_hash_bucket {
 	spinlock_t lock;
 	struct plist_head chain;
-};
+#ifdef CONFIG_FUTEX_HASH_STATS
+	unsigned long locks;		/* times the lock was taken */
+	unsigned long contended;	/* ... and was found busy */
+#endif
+} ____cacheline_aligned_in_smp;
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/*
+ * The global hash is sized at boot from the number of possible CPUs.
+ * On NUMA machines alloc_large_system_hash() spreads it over the nodes.
+ */
+static struct futex_hash_bucket *futex_queues __read_mostly;
+static unsigned long futex_hashsize __read_mostly;
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
+ *
+ * Private keys (FUTEX_PRIVATE_FLAG) of a process that asked for its
+ * own hash with PR_FUTEX_HASH go to mm->futex_hash instead of the
+ * global table.  The private hash can only be replaced while the mm
+ * has a single user, so nobody can be queued on it at that point.
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
+	struct futex_hash_bucket *queues = futex_queues;
+	unsigned long mask = futex_hashsize - 1;
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED)) &&
+	    key->private.mm->futex_hash) {
+		queues = key->private.mm->futex_hash;
+		mask = key->private.mm->futex_hash_mask;
+	}
+	return &queues[hash & mask];
+}
+
+static inline void
+__futex_hb_lock(struct futex_hash_bucket *hb, int subclass)
+{
+#ifdef CONFIG_FUTEX_HASH_STATS
+	if (!spin_trylock(&hb->lock)) {
+		spin_lock_nested(&hb->lock, subclass);
+		hb->contended++;
+	}
+	hb->locks++;
+#else
+	spin_lock_nested(&hb->lock, subclass);
+#endif
+}
+
+static inline void futex_hb_lock(struct futex_hash_bucket *hb)
+{
+	__futex_hb_lock(hb, 0);
 }
 
 /*
@@ -509,7 +560,7 @@ void exit_pi_state_list(struct task_struct *curr)
 		hb = hash_futex(&key);
 		spin_unlock_irq(&curr->pi_lock);
 
-		spin_lock(&hb->lock);
+		futex_hb_lock(hb);
 
 		spin_lock_irq(&curr->pi_lock);
 		/*
@@ -989,12 +1040,12 @@ static inline void
 double_lock_hb(struct futex_hash_bucket *hb1, struct futex_hash_bucket *hb2)
 {
 	if (hb1 <= hb2) {
-		spin_lock(&hb1->lock);
+		futex_hb_lock(hb1);
 		if (hb1 < hb2)
-			spin_lock_nested(&hb2->lock, SINGLE_DEPTH_NESTING);
+			__futex_hb_lock(hb2, SINGLE_DEPTH_NESTING);
 	} else { /* hb1 > hb2 */
-		spin_lock(&hb2->lock);
-		spin_lock_nested(&hb1->lock, SINGLE_DEPTH_NESTING);
+		futex_hb_lock(hb2);
+		__futex_hb_lock(hb1, SINGLE_DEPTH_NESTING);
 	}
 }
 
@@ -1025,7 +1076,7 @@ static int futex_wake(u32 __user *uaddr, int fshared, int nr_wake, u32 bitset)
 		goto out;
 
 	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	futex_hb_lock(hb);
 	head = &hb->chain;
 
 	plist_for_each_entry_safe(this, next, head, list) {
@@ -1533,7 +1584,7 @@ static inline struct futex_hash_bucket *queue_lock(struct futex_q *q)
 	hb = hash_futex(&q->key);
 	q->lock_ptr = &hb->lock;
 
-	spin_lock(&hb->lock);
+	futex_hb_lock(hb);
 	return hb;
 }
 
@@ -2203,7 +2254,7 @@ retry:
 		goto out;
 
 	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	futex_hb_lock(hb);
 
 	/*
 	 * To avoid races, try to do the TID -> 0 atomic transition
@@ -2422,7 +2473,7 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, int fshared,
 	/* Queue the futex_q, drop the hb lock, wait for wakeup. */
 	futex_wait_queue_me(hb, &q, to);
 
-	spin_lock(&hb->lock);
+	futex_hb_lock(hb);
 	ret = handle_early_requeue_pi_wakeup(hb, &q, &key2, to);
 	spin_unlock(&hb->lock);
 	if (ret)
@@ -2815,10 +2866,171 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	return do_futex(uaddr, op, val, tp, uaddr2, val2, val3);
 }
 
+static void futex_queues_init(struct futex_hash_bucket *queues,
+			      unsigned long size)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i++) {
+		plist_head_init(&queues[i].chain, &queues[i].lock);
+		spin_lock_init(&queues[i].lock);
+#ifdef CONFIG_FUTEX_HASH_STATS
+		queues[i].locks = 0;
+		queues[i].contended = 0;
+#endif
+	}
+}
+
+static struct futex_hash_bucket *futex_queues_alloc(unsigned long size)
+{
+	struct futex_hash_bucket *queues;
+	size_t bytes = size * sizeof(*queues);
+
+	if (bytes > PAGE_SIZE)
+		queues = vmalloc(bytes);
+	else
+		queues = kmalloc(bytes, GFP_KERNEL);
+	if (queues)
+		futex_queues_init(queues, size);
+	return queues;
+}
+
+static void futex_queues_free(struct futex_hash_bucket *queues)
+{
+	if (is_vmalloc_addr(queues))
+		vfree(queues);
+	else
+		kfree(queues);
+}
+
+/*
+ * Give the current process a private hash of @slots buckets for its
+ * FUTEX_PRIVATE_FLAG futexes, so that contention in other processes
+ * can't slow it down; @slots == 0 goes back to the global hash.  The
+ * hash can only be changed while the process is single threaded.
+ */
+static int futex_hash_allocate(unsigned long slots)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_hash_bucket *new = NULL, *old;
+
+	if (slots && (slots < 2 || slots > FUTEX_PRIVATE_HASH_MAX ||
+		      !is_power_of_2(slots)))
+		return -EINVAL;
+
+	if (slots) {
+		new = futex_queues_alloc(slots);
+		if (!new)
+			return -ENOMEM;
+	}
+
+	down_write(&mm->mmap_sem);
+	if (atomic_read(&mm->mm_users) != 1) {
+		up_write(&mm->mmap_sem);
+		if (new)
+			futex_queues_free(new);
+		return -EBUSY;
+	}
+	old = mm->futex_hash;
+	mm->futex_hash = new;
+	mm->futex_hash_mask = slots ? slots - 1 : 0;
+	up_write(&mm->mmap_sem);
+
+	if (old)
+		futex_queues_free(old);
+	return 0;
+}
+
+int futex_hash_prctl(unsigned long op, unsigned long slots)
+{
+	struct mm_struct *mm = current->mm;
+
+	if (!mm)
+		return -EINVAL;
+
+	switch (op) {
+	case PR_FUTEX_HASH_SET_SLOTS:
+		return futex_hash_allocate(slots);
+	case PR_FUTEX_HASH_GET_SLOTS:
+		if (slots)
+			return -EINVAL;
+		return mm->futex_hash ? mm->futex_hash_mask + 1 : 0;
+	}
+	return -EINVAL;
+}
+
+/* Called from mmput() once the last user of @mm is gone */
+void futex_hash_free(struct mm_struct *mm)
+{
+	if (mm->futex_hash) {
+		futex_queues_free(mm->futex_hash);
+		mm->futex_hash = NULL;
+	}
+}
+
+#ifdef CONFIG_FUTEX_HASH_STATS
+static void futex_hash_show(struct seq_file *m,
+			    struct futex_hash_bucket *queues,
+			    unsigned long size)
+{
+	unsigned long i, locks = 0, contended = 0;
+
+	seq_printf(m, "buckets: %lu\n", size);
+	seq_printf(m, "%-8s %14s %14s\n", "bucket", "locks", "contended");
+	for (i = 0; i < size; i++) {
+		if (!queues[i].locks)
+			continue;
+		seq_printf(m, "%-8lu %14lu %14lu\n", i,
+			   queues[i].locks, queues[i].contended);
+		locks += queues[i].locks;
+		contended += queues[i].contended;
+	}
+	seq_printf(m, "%-8s %14lu %14lu\n", "total", locks, contended);
+}
+
+/* /proc/<pid>/futex_hash: statistics of the process private hash */
+int proc_pid_futex_hash(struct seq_file *m, struct pid_namespace *ns,
+			struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm = get_task_mm(task);
+
+	if (!mm)
+		return 0;
+
+	down_read(&mm->mmap_sem);
+	if (mm->futex_hash)
+		futex_hash_show(m, mm->futex_hash, mm->futex_hash_mask + 1);
+	else
+		seq_puts(m, "buckets: 0\n");
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+	return 0;
+}
+
+/* /proc/futex_hash: statistics of the global hash */
+static int futex_hash_proc_show(struct seq_file *m, void *v)
+{
+	futex_hash_show(m, futex_queues, futex_hashsize);
+	return 0;
+}
+
+static int futex_hash_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, futex_hash_proc_show, NULL);
+}
+
+static const struct file_operations futex_hash_proc_fops = {
+	.open		= futex_hash_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif /* CONFIG_FUTEX_HASH_STATS */
+
 static int __init futex_init(void)
 {
+	unsigned int futex_shift;
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2834,11 +3046,19 @@ static int __init futex_init(void)
 	if (curval == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
-		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
-		spin_lock_init(&futex_queues[i].lock);
-	}
-
+	futex_hashsize = roundup_pow_of_two(FUTEX_HASH_PER_CPU *
+					    num_possible_cpus());
+	futex_queues = alloc_large_system_hash("futex",
+					       sizeof(*futex_queues),
+					       futex_hashsize, 0, 0,
+					       &futex_shift, NULL,
+					       futex_hashsize);
+	futex_hashsize = 1UL << futex_shift;
+	futex_queues_init(futex_queues, futex_hashsize);
+
+#ifdef CONFIG_FUTEX_HASH_STATS
+	proc_create("futex_hash", S_IRUSR, NULL, &futex_hash_proc_fops);
+#endif
 	return 0;
 }
 __initcall(futex_init);
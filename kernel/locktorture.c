@@ -0,0 +1,601 @@
+/*
+ * Module-based stress test for the sleeping and spinning locks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Modelled after kernel/rcutorture.c: a set of writer (and, for the
+ * reader/writer locks, reader) kthreads hammer a single lock, check
+ * that mutual exclusion holds and count acquisitions and context
+ * switches, so that lock implementations can be compared.
+ *
+ * See also:  Documentation/locktorture.txt
+ */
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/rtmutex.h>
+#include <linux/sched.h>
+#include <linux/delay.h>
+#include <linux/random.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <asm/atomic.h>
+
+MODULE_LICENSE("GPL");
+
+static int nwriters_stress = -1; /* # writer threads, defaults to 2*ncpus */
+static int nreaders_stress = -1; /* # reader threads, defaults to ncpus */
+static int stat_interval = 60;	/* Interval between stats, in seconds. */
+				/*  0 means "only at end of test". */
+static int hold_us = 10;	/* Usual time spent holding the lock. */
+static int long_hold_ms = 2;	/* Occasional long hold to force contention. */
+static int verbose;		/* Print more debug info. */
+static char *torture_type = "rwsem_lock"; /* What lock to torture. */
+
+module_param(nwriters_stress, int, 0444);
+MODULE_PARM_DESC(nwriters_stress, "Number of write-locking stress-test threads");
+module_param(nreaders_stress, int, 0444);
+MODULE_PARM_DESC(nreaders_stress, "Number of read-locking stress-test threads");
+module_param(stat_interval, int, 0444);
+MODULE_PARM_DESC(stat_interval, "Number of seconds between stats printk()s");
+module_param(hold_us, int, 0444);
+MODULE_PARM_DESC(hold_us, "Microseconds the lock is normally held for");
+module_param(long_hold_ms, int, 0444);
+MODULE_PARM_DESC(long_hold_ms, "Milliseconds of the occasional long hold");
+module_param(verbose, bool, 0444);
+MODULE_PARM_DESC(verbose, "Enable verbose debugging printk()s");
+module_param(torture_type, charp, 0444);
+MODULE_PARM_DESC(torture_type,
+		 "Type of lock to torture (spin_lock, rw_lock, mutex_lock, rwsem_lock, rtmutex_lock)");
+
+#define TORTURE_FLAG "-torture:"
+#define PRINTK_STRING(s) \
+	do { printk(KERN_ALERT "%s" TORTURE_FLAG s "\n", torture_type); } while (0)
+#define VERBOSE_PRINTK_STRING(s) \
+	do { if (verbose) printk(KERN_ALERT "%s" TORTURE_FLAG s "\n", torture_type); } while (0)
+#define VERBOSE_PRINTK_ERRSTRING(s) \
+	do { if (verbose) printk(KERN_ALERT "%s" TORTURE_FLAG "!!! " s "\n", torture_type); } while (0)
+
+static char printk_buf[4096];
+
+static int nrealwriters_stress;
+static int nrealreaders_stress;
+static struct task_struct **writer_tasks;
+static struct task_struct **reader_tasks;
+static struct task_struct *stats_task;
+
+static int lock_is_write_held;
+static atomic_t lock_is_read_held;
+
+struct lock_stress_stats {
+	long n_lock_fail;
+	long n_lock_acquired;
+};
+
+static struct lock_stress_stats *lwsa;	/* writer statistics */
+static struct lock_stress_stats *lrsa;	/* reader statistics */
+
+/*
+ * Operations vector for selecting different types of tests.
+ */
+struct lock_torture_ops {
+	void (*init)(void);
+	int (*writelock)(void);
+	void (*write_delay)(void);
+	void (*writeunlock)(void);
+	int (*readlock)(void);
+	void (*read_delay)(void);
+	void (*readunlock)(void);
+	char *name;
+};
+
+static struct lock_torture_ops *cur_ops;
+
+/*
+ * Hold the lock for hold_us, and once in a while for long_hold_ms so
+ * that waiters pile up and have to go to sleep (or keep spinning).
+ */
+static void torture_lock_delay(int nthreads)
+{
+	if (long_hold_ms &&
+	    !(random32() % (nthreads * 2000 * long_hold_ms)))
+		mdelay(long_hold_ms);
+	else if (hold_us)
+		udelay(hold_us);
+}
+
+static void torture_write_delay(void)
+{
+	torture_lock_delay(nrealwriters_stress);
+}
+
+static void torture_read_delay(void)
+{
+	torture_lock_delay(nrealreaders_stress);
+}
+
+static DEFINE_SPINLOCK(torture_spinlock);
+
+static int torture_spin_lock_write_lock(void) __acquires(torture_spinlock)
+{
+	spin_lock(&torture_spinlock);
+	return 0;
+}
+
+static void torture_spin_lock_write_delay(void)
+{
+	/* No long holds with a spinning lock held, just the usual short one. */
+	if (hold_us)
+		udelay(hold_us);
+}
+
+static void torture_spin_lock_write_unlock(void) __releases(torture_spinlock)
+{
+	spin_unlock(&torture_spinlock);
+}
+
+static struct lock_torture_ops spin_lock_ops = {
+	.writelock	= torture_spin_lock_write_lock,
+	.write_delay	= torture_spin_lock_write_delay,
+	.writeunlock	= torture_spin_lock_write_unlock,
+	.name		= "spin_lock"
+};
+
+static DEFINE_RWLOCK(torture_rwlock);
+
+static int torture_rwlock_write_lock(void) __acquires(torture_rwlock)
+{
+	write_lock(&torture_rwlock);
+	return 0;
+}
+
+static void torture_rwlock_write_unlock(void) __releases(torture_rwlock)
+{
+	write_unlock(&torture_rwlock);
+}
+
+static int torture_rwlock_read_lock(void) __acquires(torture_rwlock)
+{
+	read_lock(&torture_rwlock);
+	return 0;
+}
+
+static void torture_rwlock_read_unlock(void) __releases(torture_rwlock)
+{
+	read_unlock(&torture_rwlock);
+}
+
+static struct lock_torture_ops rw_lock_ops = {
+	.writelock	= torture_rwlock_write_lock,
+	.write_delay	= torture_spin_lock_write_delay,
+	.writeunlock	= torture_rwlock_write_unlock,
+	.readlock	= torture_rwlock_read_lock,
+	.read_delay	= torture_spin_lock_write_delay,
+	.readunlock	= torture_rwlock_read_unlock,
+	.name		= "rw_lock"
+};
+
+static DEFINE_MUTEX(torture_mutex);
+
+static int torture_mutex_lock(void) __acquires(torture_mutex)
+{
+	mutex_lock(&torture_mutex);
+	return 0;
+}
+
+static void torture_mutex_unlock(void) __releases(torture_mutex)
+{
+	mutex_unlock(&torture_mutex);
+}
+
+static struct lock_torture_ops mutex_lock_ops = {
+	.writelock	= torture_mutex_lock,
+	.write_delay	= torture_write_delay,
+	.writeunlock	= torture_mutex_unlock,
+	.name		= "mutex_lock"
+};
+
+static DECLARE_RWSEM(torture_rwsem);
+
+static int torture_rwsem_down_write(void) __acquires(torture_rwsem)
+{
+	down_write(&torture_rwsem);
+	return 0;
+}
+
+static void torture_rwsem_up_write(void) __releases(torture_rwsem)
+{
+	up_write(&torture_rwsem);
+}
+
+static int torture_rwsem_down_read(void) __acquires(torture_rwsem)
+{
+	down_read(&torture_rwsem);
+	return 0;
+}
+
+static void torture_rwsem_up_read(void) __releases(torture_rwsem)
+{
+	up_read(&torture_rwsem);
+}
+
+static struct lock_torture_ops rwsem_lock_ops = {
+	.writelock	= torture_rwsem_down_write,
+	.write_delay	= torture_write_delay,
+	.writeunlock	= torture_rwsem_up_write,
+	.readlock	= torture_rwsem_down_read,
+	.read_delay	= torture_read_delay,
+	.readunlock	= torture_rwsem_up_read,
+	.name		= "rwsem_lock"
+};
+
+#ifdef CONFIG_RT_MUTEXES
+static DEFINE_RT_MUTEX(torture_rtmutex);
+
+static int torture_rtmutex_lock(void) __acquires(torture_rtmutex)
+{
+	rt_mutex_lock(&torture_rtmutex);
+	return 0;
+}
+
+static void torture_rtmutex_unlock(void) __releases(torture_rtmutex)
+{
+	rt_mutex_unlock(&torture_rtmutex);
+}
+
+static struct lock_torture_ops rtmutex_lock_ops = {
+	.writelock	= torture_rtmutex_lock,
+	.write_delay	= torture_write_delay,
+	.writeunlock	= torture_rtmutex_unlock,
+	.name		= "rtmutex_lock"
+};
+#endif
+
+/*
+ * Lock torture writer kthread.  Repeatedly acquires and releases
+ * the lock, checking for duplicate acquisitions.
+ */
+static int lock_torture_writer(void *arg)
+{
+	struct lock_stress_stats *lwsp = arg;
+
+	VERBOSE_PRINTK_STRING("lock_torture_writer task started");
+	set_user_nice(current, 19);
+
+	do {
+		cur_ops->writelock();
+		if (lock_is_write_held || atomic_read(&lock_is_read_held))
+			lwsp->n_lock_fail++;
+		lock_is_write_held = 1;
+		lwsp->n_lock_acquired++;
+		cur_ops->write_delay();
+		lock_is_write_held = 0;
+		cur_ops->writeunlock();
+		cond_resched();
+	} while (!kthread_should_stop());
+
+	VERBOSE_PRINTK_STRING("lock_torture_writer task stopping");
+
+	return 0;
+}
+
+/*
+ * Lock torture reader kthread.  Repeatedly acquires and releases
+ * the reader lock, checking that no writer holds it concurrently.
+ */
+static int lock_torture_reader(void *arg)
+{
+	struct lock_stress_stats *lrsp = arg;
+
+	VERBOSE_PRINTK_STRING("lock_torture_reader task started");
+	set_user_nice(current, 19);
+
+	do {
+		cur_ops->readlock();
+		atomic_inc(&lock_is_read_held);
+		if (lock_is_write_held)
+			lrsp->n_lock_fail++;
+		lrsp->n_lock_acquired++;
+		cur_ops->read_delay();
+		atomic_dec(&lock_is_read_held);
+		cur_ops->readunlock();
+		cond_resched();
+	} while (!kthread_should_stop());
+
+	VERBOSE_PRINTK_STRING("lock_torture_reader task stopping");
+
+	return 0;
+}
+
+/*
+ * Sum up the context switches of a set of stress threads: the point of
+ * the spinning lock slowpaths is to avoid them.
+ */
+static unsigned long lock_torture_nr_switches(struct task_struct **tasks, int n)
+{
+	unsigned long sum = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (tasks[i])
+			sum += tasks[i]->nvcsw + tasks[i]->nivcsw;
+
+	return sum;
+}
+
+/*
+ * Create a lock-torture-statistics message in the specified buffer.
+ */
+static int __lock_torture_stats_print(char *page,
+		struct lock_stress_stats *statp, struct task_struct **tasks,
+		int n, bool write)
+{
+	bool fail = false;
+	int i, cnt = 0;
+	long max = 0, min = n ? statp[0].n_lock_acquired : 0;
+	long long sum = 0;
+
+	for (i = 0; i < n; i++) {
+		if (statp[i].n_lock_fail)
+			fail = true;
+		sum += statp[i].n_lock_acquired;
+		if (max < statp[i].n_lock_acquired)
+			max = statp[i].n_lock_acquired;
+		if (min > statp[i].n_lock_acquired)
+			min = statp[i].n_lock_acquired;
+	}
+	cnt += sprintf(&page[cnt], "%s%s ", torture_type, TORTURE_FLAG);
+	cnt += sprintf(&page[cnt],
+		       "%s:  Total: %lld  Max/Min: %ld/%ld %s  Fail: %d  Switches: %lu %s\n",
+		       write ? "Writes" : "Reads ",
+		       sum, max, min, max / 2 > min ? "???" : "",
+		       fail, lock_torture_nr_switches(tasks, n),
+		       fail ? "!!!" : "");
+	if (fail)
+		printk(KERN_ALERT "%s" TORTURE_FLAG
+		       "!!! mutual exclusion violated\n", torture_type);
+
+	return cnt;
+}
+
+/*
+ * Print torture statistics.  Caller must ensure that there is only one
+ * call to this function at a given time!!!  This is normally accomplished
+ * by relying on the module system to only have one copy of the module
+ * loaded, and then by giving the lock_torture_stats kthread full control
+ * (or the init/cleanup functions when lock_torture_stats thread is not
+ * running).
+ */
+static void lock_torture_stats_print(void)
+{
+	int cnt;
+
+	cnt = __lock_torture_stats_print(printk_buf, lwsa, writer_tasks,
+					 nrealwriters_stress, true);
+	if (cur_ops->readlock)
+		__lock_torture_stats_print(&printk_buf[cnt], lrsa, reader_tasks,
+					   nrealreaders_stress, false);
+	printk(KERN_ALERT "%s", printk_buf);
+}
+
+/*
+ * Periodically prints torture statistics, if periodic statistics printing
+ * was specified via the stat_interval module parameter.
+ */
+static int lock_torture_stats(void *arg)
+{
+	VERBOSE_PRINTK_STRING("lock_torture_stats task started");
+	do {
+		schedule_timeout_interruptible(stat_interval * HZ);
+		lock_torture_stats_print();
+	} while (!kthread_should_stop());
+	VERBOSE_PRINTK_STRING("lock_torture_stats task stopping");
+
+	return 0;
+}
+
+static inline void
+lock_torture_print_module_parms(struct lock_torture_ops *cur_ops, char *tag)
+{
+	printk(KERN_ALERT "%s" TORTURE_FLAG
+	       "--- %s: nwriters_stress=%d nreaders_stress=%d stat_interval=%d "
+	       "hold_us=%d long_hold_ms=%d verbose=%d\n",
+	       torture_type, tag, nrealwriters_stress, nrealreaders_stress,
+	       stat_interval, hold_us, long_hold_ms, verbose);
+}
+
+static void lock_torture_cleanup(void)
+{
+	int i;
+
+	if (writer_tasks) {
+		for (i = 0; i < nrealwriters_stress; i++) {
+			if (writer_tasks[i]) {
+				VERBOSE_PRINTK_STRING("Stopping lock_torture_writer task");
+				kthread_stop(writer_tasks[i]);
+			}
+		}
+	}
+	if (reader_tasks) {
+		for (i = 0; i < nrealreaders_stress; i++) {
+			if (reader_tasks[i]) {
+				VERBOSE_PRINTK_STRING("Stopping lock_torture_reader task");
+				kthread_stop(reader_tasks[i]);
+			}
+		}
+	}
+
+	if (stats_task) {
+		VERBOSE_PRINTK_STRING("Stopping lock_torture_stats task");
+		kthread_stop(stats_task);
+		stats_task = NULL;
+	}
+
+	/* Final stats, the stopped threads still count their switches. */
+	if (lwsa && (!cur_ops->readlock || lrsa))
+		lock_torture_stats_print();
+
+	if (writer_tasks) {
+		for (i = 0; i < nrealwriters_stress; i++)
+			if (writer_tasks[i])
+				put_task_struct(writer_tasks[i]);
+		kfree(writer_tasks);
+		writer_tasks = NULL;
+	}
+	if (reader_tasks) {
+		for (i = 0; i < nrealreaders_stress; i++)
+			if (reader_tasks[i])
+				put_task_struct(reader_tasks[i]);
+		kfree(reader_tasks);
+		reader_tasks = NULL;
+	}
+
+	kfree(lwsa);
+	lwsa = NULL;
+	kfree(lrsa);
+	lrsa = NULL;
+
+	lock_torture_print_module_parms(cur_ops, "End of test");
+}
+
+static struct task_struct *lock_torture_create(int (*fn)(void *), void *arg,
+					       const char *name)
+{
+	struct task_struct *t;
+
+	t = kthread_run(fn, arg, name);
+	if (IS_ERR(t))
+		return t;
+
+	/* Keep the task_struct around for the final statistics. */
+	get_task_struct(t);
+
+	return t;
+}
+
+static int __init lock_torture_init(void)
+{
+	int i;
+	int firsterr = 0;
+	static struct lock_torture_ops *torture_ops[] = {
+		&spin_lock_ops, &rw_lock_ops, &mutex_lock_ops, &rwsem_lock_ops,
+#ifdef CONFIG_RT_MUTEXES
+		&rtmutex_lock_ops,
+#endif
+	};
+
+	/* Process args and tell the world that the torturer is on the job. */
+	for (i = 0; i < ARRAY_SIZE(torture_ops); i++) {
+		cur_ops = torture_ops[i];
+		if (strcmp(torture_type, cur_ops->name) == 0)
+			break;
+	}
+	if (i == ARRAY_SIZE(torture_ops)) {
+		printk(KERN_ALERT "lock-torture: invalid torture type: \"%s\"\n",
+		       torture_type);
+		printk(KERN_ALERT "lock-torture types:");
+		for (i = 0; i < ARRAY_SIZE(torture_ops); i++)
+			printk(KERN_ALERT " %s", torture_ops[i]->name);
+		printk(KERN_ALERT "\n");
+		return -EINVAL;
+	}
+	if (cur_ops->init)
+		cur_ops->init();
+
+	if (nwriters_stress >= 0)
+		nrealwriters_stress = nwriters_stress;
+	else
+		nrealwriters_stress = 2 * num_online_cpus();
+	if (!cur_ops->readlock)
+		nrealreaders_stress = 0;
+	else if (nreaders_stress >= 0)
+		nrealreaders_stress = nreaders_stress;
+	else
+		nrealreaders_stress = num_online_cpus();
+	lock_torture_print_module_parms(cur_ops, "Start of test");
+
+	/* Initialize the statistics so that each run gets its own numbers. */
+	lock_is_write_held = 0;
+	atomic_set(&lock_is_read_held, 0);
+
+	lwsa = kcalloc(nrealwriters_stress, sizeof(*lwsa), GFP_KERNEL);
+	writer_tasks = kcalloc(nrealwriters_stress, sizeof(writer_tasks[0]),
+			       GFP_KERNEL);
+	if (!lwsa || !writer_tasks) {
+		VERBOSE_PRINTK_ERRSTRING("out of memory");
+		firsterr = -ENOMEM;
+		goto unwind;
+	}
+	if (nrealreaders_stress) {
+		lrsa = kcalloc(nrealreaders_stress, sizeof(*lrsa), GFP_KERNEL);
+		reader_tasks = kcalloc(nrealreaders_stress,
+				       sizeof(reader_tasks[0]), GFP_KERNEL);
+		if (!lrsa || !reader_tasks) {
+			VERBOSE_PRINTK_ERRSTRING("out of memory");
+			firsterr = -ENOMEM;
+			goto unwind;
+		}
+	}
+
+	for (i = 0; i < nrealwriters_stress; i++) {
+		struct task_struct *t;
+
+		VERBOSE_PRINTK_STRING("Creating lock_torture_writer task");
+		t = lock_torture_create(lock_torture_writer, &lwsa[i],
+					"lock_torture_writer");
+		if (IS_ERR(t)) {
+			VERBOSE_PRINTK_ERRSTRING("Failed to create writer");
+			firsterr = PTR_ERR(t);
+			goto unwind;
+		}
+		writer_tasks[i] = t;
+	}
+	for (i = 0; i < nrealreaders_stress; i++) {
+		struct task_struct *t;
+
+		VERBOSE_PRINTK_STRING("Creating lock_torture_reader task");
+		t = lock_torture_create(lock_torture_reader, &lrsa[i],
+					"lock_torture_reader");
+		if (IS_ERR(t)) {
+			VERBOSE_PRINTK_ERRSTRING("Failed to create reader");
+			firsterr = PTR_ERR(t);
+			goto unwind;
+		}
+		reader_tasks[i] = t;
+	}
+	if (stat_interval > 0) {
+		/* Start up the kthread that periodically prints stats. */
+		VERBOSE_PRINTK_STRING("Creating lock_torture_stats task");
+		stats_task = kthread_run(lock_torture_stats, NULL,
+					 "lock_torture_stats");
+		if (IS_ERR(stats_task)) {
+			firsterr = PTR_ERR(stats_task);
+			VERBOSE_PRINTK_ERRSTRING("Failed to create stats");
+			stats_task = NULL;
+			goto unwind;
+		}
+	}
+
+	return 0;
+
+unwind:
+	lock_torture_cleanup();
+	return firsterr;
+}
+
+module_init(lock_torture_init);
+module_exit(lock_torture_cleanup);
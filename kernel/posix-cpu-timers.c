@@ -8,6 +8,7 @@
 #include <linux/math64.h>
 #include <asm/uaccess.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 #include <trace/events/timer.h>
 
 /*
@@ -595,7 +596,10 @@ static void arm_timer(struct k_itimer *timer, union cpu_time_count now)
 		 * We are the new earliest-expiring timer.
 		 * If we are a thread timer, there can always
 		 * be a process timer telling us to stop earlier.
+		 * A full dynticks CPU running the task needs its
+		 * tick back to notice the expiry.
 		 */
+		tick_nohz_full_kick_all();
 
 		if (CPUCLOCK_PERTHREAD(timer->it_clock)) {
 			union cpu_time_count *exp = &nt->expires;
@@ -1386,6 +1390,31 @@ static inline int fastpath_timer_check(struct task_struct *tsk)
 	return sig->rlim[RLIMIT_CPU].rlim_cur != RLIM_INFINITY;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/**
+ * posix_cpu_timers_can_stop_tick - check whether @tsk needs the tick
+ *
+ * @tsk:	The task (thread) running on a full dynticks CPU.
+ *
+ * The CPU timers and RLIMIT_CPU of the task and of its thread group
+ * only expire from the tick.  Return true if none of them is armed.
+ */
+int posix_cpu_timers_can_stop_tick(struct task_struct *tsk)
+{
+	struct signal_struct *sig;
+
+	if (unlikely(tsk->exit_state))
+		return 0;
+	if (!task_cputime_zero(&tsk->cputime_expires))
+		return 0;
+
+	sig = tsk->signal;
+	if (!task_cputime_zero(&sig->cputime_expires))
+		return 0;
+	return sig->rlim[RLIMIT_CPU].rlim_cur == RLIM_INFINITY;
+}
+#endif
+
 /*
  * This is called from the timer interrupt handler.  The irq handler has
  * already updated our counts.  We need to check if any timers fire now.
@@ -1503,6 +1532,7 @@ void set_process_cpu_timer(struct task_struct *tsk, unsigned int clock_idx,
 			tsk->signal->cputime_expires.virt_exp = *newval;
 			break;
 		}
+		tick_nohz_full_kick_all();
 	}
 }
 
@@ -46,6 +46,8 @@
 #include <linux/cpu.h>
 #include <linux/mutex.h>
 #include <linux/time.h>
+#include <linux/kthread.h>
+#include <linux/tick.h>
 
 #include "rcutree.h"
 
@@ -220,6 +222,17 @@ static int rcu_implicit_offline_qs(struct rcu_data *rdp)
 		return 1;
 	}
 
+	/*
+	 * A full dynticks CPU may have its tick stopped: make it
+	 * reschedule, which reports a quiescent state for RCU-sched
+	 * and brings the tick back for the others.
+	 */
+	if (tick_nohz_full_cpu(rdp->cpu)) {
+		tick_nohz_full_kick_cpu(rdp->cpu);
+		rdp->resched_ipi++;
+		return 0;
+	}
+
 	/* If preemptable RCU, no point in sending reschedule IPI. */
 	if (rdp->preemptable)
 		return 0;
@@ -1018,6 +1031,7 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 {
 	unsigned long flags;
 	struct rcu_head *next, *list, **tail;
+	unsigned long long start, duration;
 	int count;
 
 	/* If no callbacks are ready, just return.*/
@@ -1040,6 +1054,7 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 
 	/* Invoke callbacks. */
 	count = 0;
+	start = cpu_clock(rdp->cpu);
 	while (list) {
 		next = list->next;
 		prefetch(next);
@@ -1048,9 +1063,15 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 		if (++count >= rdp->blimit)
 			break;
 	}
+	duration = cpu_clock(rdp->cpu) - start;
 
 	local_irq_save(flags);
 
+	/* Account for rcutree_trace. */
+	rdp->n_cbs_invoked += count;
+	if (duration > rdp->batch_max_ns)
+		rdp->batch_max_ns = duration;
+
 	/* Update count, and requeue any remaining callbacks. */
 	rdp->qlen -= count;
 	if (list != NULL) {
@@ -1325,26 +1346,20 @@ static void rcu_process_callbacks(struct softirq_action *unused)
 	smp_mb(); /* See above block comment. */
 }
 
+/*
+ * Queue a callback on the specified CPU-local rcu_data and get a grace
+ * period going for it.  Must be called with irqs disabled.
+ */
 static void
-__call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
-	   struct rcu_state *rsp)
+__call_rcu_core(struct rcu_head *head, struct rcu_state *rsp,
+		struct rcu_data *rdp)
 {
-	unsigned long flags;
-	struct rcu_data *rdp;
-
-	head->func = func;
-	head->next = NULL;
-
-	smp_mb(); /* Ensure RCU update seen before callback registry. */
-
 	/*
 	 * Opportunistically note grace-period endings and beginnings.
 	 * Note that we might see a beginning right after we see an
 	 * end, but never vice versa, since this CPU has to pass through
 	 * a quiescent state betweentimes.
 	 */
-	local_irq_save(flags);
-	rdp = rsp->rda[smp_processor_id()];
 	rcu_process_gp_end(rsp, rdp);
 	check_for_new_grace_period(rsp, rdp);
 
@@ -1377,6 +1392,24 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 		rdp->qlen_last_fqs_check = rdp->qlen;
 	} else if ((long)(ACCESS_ONCE(rsp->jiffies_force_qs) - jiffies) < 0)
 		force_quiescent_state(rsp, 1);
+}
+
+static void
+__call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
+	   struct rcu_state *rsp)
+{
+	unsigned long flags;
+	struct rcu_data *rdp;
+
+	head->func = func;
+	head->next = NULL;
+
+	smp_mb(); /* Ensure RCU update seen before callback registry. */
+
+	local_irq_save(flags);
+	rdp = rsp->rda[smp_processor_id()];
+	if (!rcu_nocb_enqueue(rdp, head))
+		__call_rcu_core(head, rsp, rdp);
 	local_irq_restore(flags);
 }
 
@@ -1480,6 +1513,17 @@ int rcu_needs_cpu(int cpu)
 	       rcu_preempt_needs_cpu(cpu);
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Check whether RCU needs the scheduling-clock interrupt of a busy CPU,
+ * either to report a quiescent state or to advance its callbacks.
+ */
+int rcu_cpu_needs_tick(int cpu)
+{
+	return rcu_pending(cpu) || rcu_needs_cpu(cpu);
+}
+#endif
+
 static DEFINE_PER_CPU(struct rcu_head, rcu_barrier_head) = {NULL};
 static atomic_t rcu_barrier_cpu_count;
 static DEFINE_MUTEX(rcu_barrier_mutex);
@@ -1578,6 +1622,8 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->dynticks = &per_cpu(rcu_dynticks, cpu);
 #endif /* #ifdef CONFIG_NO_HZ */
 	rdp->cpu = cpu;
+	rdp->rsp = rsp;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -175,6 +176,9 @@ struct rcu_data {
 	unsigned long	n_force_qs_snap;
 					/* did other CPU force QS recently? */
 	long		blimit;		/* Upper limit on a processed batch */
+	unsigned long	n_cbs_invoked;	/* # callbacks invoked from softirq. */
+	unsigned long long batch_max_ns;
+					/* Longest rcu_do_batch() run. */
 
 #ifdef CONFIG_NO_HZ
 	/* 3) dynticks interface. */
@@ -200,7 +204,22 @@ struct rcu_data {
 	long n_rp_need_fqs;
 	long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) Callback offloading, see rcu_nocb_kthread(). */
+	struct rcu_head *nocb_head;	/* CBs waiting for kthread. */
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;	/* # CBs waiting for kthread. */
+	wait_queue_head_t nocb_wq;	/* For nocb kthread to sleep on. */
+	struct task_struct *nocb_kthread;
+					/* NULL unless offloading. */
+	unsigned long n_nocb_invoked;	/* # CBs invoked by kthread. */
+	unsigned long n_nocb_batches;	/* # grace periods kthread waited. */
+	unsigned long long nocb_gp_max_ns;
+					/* Longest such grace-period wait. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
+	struct rcu_state *rsp;
 };
 
 /* Values for signaled field in struct rcu_state. */
@@ -323,5 +342,7 @@ static int rcu_preempt_needs_cpu(int cpu);
 static void __cpuinit rcu_preempt_init_percpu_data(int cpu);
 static void rcu_preempt_send_cbs_to_orphanage(void);
 static void __init __rcu_init_preempt(void);
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
 
 #endif /* #else #ifdef RCU_TREE_NONCORE */
@@ -643,3 +643,208 @@ static void __init __rcu_init_preempt(void)
 }
 
 #endif /* #else #ifdef CONFIG_TREE_PREEMPT_RCU */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Callback offloading.  On the CPUs given by the rcu_nocbs= boot
+ * parameter, call_rcu() and friends hand their callbacks to a per-CPU
+ * kthread of the matching flavor ("rcuos/N", "rcuob/N", "rcuop/N")
+ * instead of leaving them to RCU_SOFTIRQ.  The kthread waits for a
+ * grace period covering everything queued so far and then invokes the
+ * whole batch in process context, so the CPU that queued the callbacks
+ * no longer pays for them.  The kthreads start out affine to the CPUs
+ * that are not offloaded and may be moved around like any other task.
+ */
+
+static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
+
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/*
+ * Hand a callback to the offload kthread of the CPU owning rdp, which
+ * must be the current CPU, with irqs disabled.  Returns false if the
+ * callback should be queued normally: this CPU is not offloaded, or
+ * its kthread has not been spawned yet.
+ */
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head)
+{
+	struct rcu_head **old_tail;
+
+	if (!rdp->nocb_kthread)
+		return false;
+	old_tail = xchg(&rdp->nocb_tail, &head->next);
+	ACCESS_ONCE(*old_tail) = head;
+	atomic_long_inc(&rdp->nocb_q_count);
+
+	/* Only the first callback of a batch needs to wake the kthread. */
+	if (old_tail == &rdp->nocb_head)
+		wake_up(&rdp->nocb_wq);
+	return true;
+}
+
+/*
+ * Wait for a grace period of rdp's flavor.  The wakeup callback goes
+ * on the normal list of whatever CPU we are running on, never on an
+ * offload queue, or the kthread could end up waiting on itself.
+ */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	struct rcu_synchronize rcu;
+	struct rcu_state *rsp = rdp->rsp;
+	unsigned long flags;
+
+	init_completion(&rcu.completion);
+	rcu.head.func = wakeme_after_rcu;
+	rcu.head.next = NULL;
+	smp_mb(); /* Detached callbacks before wakeup callback registry. */
+	local_irq_save(flags);
+	__call_rcu_core(&rcu.head, rsp, rsp->rda[smp_processor_id()]);
+	local_irq_restore(flags);
+	wait_for_completion(&rcu.completion);
+}
+
+/*
+ * Per-CPU offload kthread: detach the queued callbacks, wait for a
+ * grace period, and invoke them.  Everything queued while we wait for
+ * one grace period is handled as the next batch, so the number of
+ * grace periods waited for does not grow with the callback rate.
+ * The CPU is given up every blimit callbacks.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list, *next, **tail;
+	unsigned long long waited;
+	ktime_t start;
+	long count;
+	int n;
+
+	for (;;) {
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head));
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list)
+			continue;
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+
+		start = ktime_get();
+		rcu_nocb_wait_gp(rdp);
+		waited = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		count = 0;
+		n = 0;
+		while (list) {
+			next = list->next;
+			/* Wait for enqueuers still linking in the tail. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = list->next;
+			}
+			local_bh_disable();
+			list->func(list);
+			local_bh_enable();
+			list = next;
+			count++;
+			if (++n >= blimit) {
+				n = 0;
+				cond_resched();
+			}
+		}
+		atomic_long_sub(count, &rdp->nocb_q_count);
+
+		/* Account for rcutree_trace. */
+		rdp->n_nocb_invoked += count;
+		rdp->n_nocb_batches++;
+		if (waited > rdp->nocb_gp_max_ns)
+			rdp->nocb_gp_max_ns = waited;
+	}
+	return 0;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = &rdp->nocb_head;
+	atomic_long_set(&rdp->nocb_q_count, 0);
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+static void __init
+rcu_spawn_one_nocb_kthreads(struct rcu_state *rsp, char abbr,
+			    const struct cpumask *housekeeping)
+{
+	int cpu;
+	struct rcu_data *rdp;
+	struct task_struct *t;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = rsp->rda[cpu];
+		t = kthread_create(rcu_nocb_kthread, rdp,
+				   "rcuo%c/%d", abbr, cpu);
+		if (IS_ERR(t)) {
+			printk(KERN_ERR "RCU: no offload kthread for CPU %d\n",
+			       cpu);
+			continue;
+		}
+		if (!cpumask_empty(housekeeping))
+			set_cpus_allowed_ptr(t, housekeeping);
+		wake_up_process(t);
+		smp_wmb(); /* Kthread fully set up before callbacks flow in. */
+		rdp->nocb_kthread = t;
+	}
+}
+
+/*
+ * Spawn the offload kthreads once all boot CPUs are up, so that they
+ * can be moved off the offloaded CPUs.  Callbacks queued before then
+ * are handled by RCU_SOFTIRQ as usual.
+ */
+static int __init rcu_spawn_nocb_kthreads(void)
+{
+	cpumask_var_t housekeeping;
+	char buf[80];
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	cpumask_and(rcu_nocb_mask, rcu_nocb_mask, cpu_possible_mask);
+	if (cpumask_empty(rcu_nocb_mask))
+		return 0;
+	if (!alloc_cpumask_var(&housekeeping, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_andnot(housekeeping, cpu_possible_mask, rcu_nocb_mask);
+
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "RCU: offloading callbacks from CPUs %s\n", buf);
+	rcu_spawn_one_nocb_kthreads(&rcu_sched_state, 's', housekeeping);
+	rcu_spawn_one_nocb_kthreads(&rcu_bh_state, 'b', housekeeping);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_one_nocb_kthreads(&rcu_preempt_state, 'p', housekeeping);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+
+	free_cpumask_var(housekeeping);
+	return 0;
+}
+core_initcall(rcu_spawn_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head)
+{
+	return false;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -46,6 +46,13 @@
 #define RCU_TREE_NONCORE
 #include "rcutree.h"
 
+/* Nanoseconds to microseconds, without 64-bit division on 32-bit. */
+static unsigned long long ns_to_us(unsigned long long ns)
+{
+	do_div(ns, NSEC_PER_USEC);
+	return ns;
+}
+
 static void print_one_rcu_data(struct seq_file *m, struct rcu_data *rdp)
 {
 	if (!rdp->beenonline)
@@ -64,7 +71,15 @@ static void print_one_rcu_data(struct seq_file *m, struct rcu_data *rdp)
 		   rdp->dynticks_fqs);
 #endif /* #ifdef CONFIG_NO_HZ */
 	seq_printf(m, " of=%lu ri=%lu", rdp->offline_fqs, rdp->resched_ipi);
-	seq_printf(m, " ql=%ld b=%ld\n", rdp->qlen, rdp->blimit);
+	seq_printf(m, " ql=%ld b=%ld", rdp->qlen, rdp->blimit);
+	seq_printf(m, " ci=%lu bmax=%llu", rdp->n_cbs_invoked,
+		   ns_to_us(rdp->batch_max_ns));
+#ifdef CONFIG_RCU_NOCB_CPU
+	seq_printf(m, " nq=%ld ni=%lu nb=%lu ngp=%llu",
+		   atomic_long_read(&rdp->nocb_q_count), rdp->n_nocb_invoked,
+		   rdp->n_nocb_batches, ns_to_us(rdp->nocb_gp_max_ns));
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+	seq_putc(m, '\n');
 }
 
 #define PRINT_RCU_DATA(name, func, m) \
@@ -119,7 +134,15 @@ static void print_one_rcu_data_csv(struct seq_file *m, struct rcu_data *rdp)
 		   rdp->dynticks_fqs);
 #endif /* #ifdef CONFIG_NO_HZ */
 	seq_printf(m, ",%lu,%lu", rdp->offline_fqs, rdp->resched_ipi);
-	seq_printf(m, ",%ld,%ld\n", rdp->qlen, rdp->blimit);
+	seq_printf(m, ",%ld,%ld", rdp->qlen, rdp->blimit);
+	seq_printf(m, ",%lu,%llu", rdp->n_cbs_invoked,
+		   ns_to_us(rdp->batch_max_ns));
+#ifdef CONFIG_RCU_NOCB_CPU
+	seq_printf(m, ",%ld,%lu,%lu,%llu",
+		   atomic_long_read(&rdp->nocb_q_count), rdp->n_nocb_invoked,
+		   rdp->n_nocb_batches, ns_to_us(rdp->nocb_gp_max_ns));
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+	seq_putc(m, '\n');
 }
 
 static int show_rcudata_csv(struct seq_file *m, void *unused)
@@ -128,7 +151,11 @@ static int show_rcudata_csv(struct seq_file *m, void *unused)
 #ifdef CONFIG_NO_HZ
 	seq_puts(m, "\"dt\",\"dt nesting\",\"dn\",\"df\",");
 #endif /* #ifdef CONFIG_NO_HZ */
-	seq_puts(m, "\"of\",\"ri\",\"ql\",\"b\"\n");
+	seq_puts(m, "\"of\",\"ri\",\"ql\",\"b\",\"ci\",\"bmax\"");
+#ifdef CONFIG_RCU_NOCB_CPU
+	seq_puts(m, ",\"nq\",\"ni\",\"nb\",\"ngp\"");
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+	seq_puts(m, "\n");
 #ifdef CONFIG_TREE_PREEMPT_RCU
 	seq_puts(m, "\"rcu_preempt:\"\n");
 	PRINT_RCU_DATA(rcu_preempt_data, print_one_rcu_data_csv, m);
@@ -607,6 +607,55 @@ void rt_mutex_adjust_pi(struct task_struct *task)
 	rt_mutex_adjust_prio_chain(task, 0, NULL, NULL, task);
 }
 
+#if defined(CONFIG_SMP) && !defined(CONFIG_RT_MUTEX_TESTER)
+/*
+ * Optimistic spinning: when the top waiter finds the lock owner running
+ * on another cpu, the lock is likely to be released soon, so busy-wait
+ * for that instead of going through a sleep/wakeup cycle. The waiter is
+ * already enqueued, so the owner is boosted as usual while we spin.
+ *
+ * Returns 1 when the owner released the lock (or handed it to us) and
+ * the caller should retry, 0 when it should block.
+ */
+static int rt_mutex_spin_on_owner(struct rt_mutex *lock,
+				  struct rt_mutex_waiter *waiter)
+{
+	struct task_struct *owner;
+	int ret = 1;
+
+	rcu_read_lock();
+	owner = rt_mutex_owner(lock);
+	if (!owner || owner == current) {
+		ret = 0;
+		goto out;
+	}
+
+	/*
+	 * The owner's task_struct stays valid under rcu_read_lock() for
+	 * as long as it owns the lock. Stop when we got woken up, be it
+	 * for the lock, a signal or a timeout.
+	 */
+	while (ACCESS_ONCE(waiter->task) && rt_mutex_owner(lock) == owner &&
+	       current->state != TASK_RUNNING) {
+		if (!task_curr(owner) || need_resched()) {
+			ret = 0;
+			break;
+		}
+		cpu_relax();
+	}
+out:
+	rcu_read_unlock();
+
+	return ret;
+}
+#else
+static inline int rt_mutex_spin_on_owner(struct rt_mutex *lock,
+					 struct rt_mutex_waiter *waiter)
+{
+	return 0;
+}
+#endif
+
 /**
  * __rt_mutex_slowlock() - Perform the wait-wake-try-to-take loop
  * @lock:		 the rt_mutex to take
@@ -624,7 +673,7 @@ __rt_mutex_slowlock(struct rt_mutex *lock, int state,
 		    struct rt_mutex_waiter *waiter,
 		    int detect_deadlock)
 {
-	int ret = 0;
+	int ret = 0, top_waiter;
 
 	for (;;) {
 		/* Try to acquire the lock: */
@@ -672,11 +721,13 @@ __rt_mutex_slowlock(struct rt_mutex *lock, int state,
 				break;
 		}
 
+		top_waiter = rt_mutex_top_waiter(lock) == waiter;
 		spin_unlock(&lock->wait_lock);
 
 		debug_rt_mutex_print_deadlock(waiter);
 
-		if (waiter->task)
+		if (waiter->task &&
+		    !(top_waiter && rt_mutex_spin_on_owner(lock, waiter)))
 			schedule_rt_mutex(lock);
 
 		spin_lock(&lock->wait_lock);
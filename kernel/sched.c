@@ -71,11 +71,14 @@
 #include <linux/debugfs.h>
 #include <linux/ctype.h>
 #include <linux/ftrace.h>
+#include <linux/tracehook.h>
+#include <linux/mempolicy.h>
 
 #include <asm/tlb.h>
 #include <asm/irq_regs.h>
 
 #include "sched_cpupri.h"
+#include "workqueue_sched.h"
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/sched.h>
@@ -190,10 +193,28 @@ static inline int rt_bandwidth_enabled(void)
 	return sysctl_sched_rt_runtime >= 0;
 }
 
-static void start_rt_bandwidth(struct rt_bandwidth *rt_b)
+static void start_bandwidth_timer(struct hrtimer *period_timer, ktime_t period)
 {
-	ktime_t now;
+	unsigned long delta;
+	ktime_t soft, hard, now;
+
+	for (;;) {
+		if (hrtimer_active(period_timer))
+			break;
+
+		now = hrtimer_cb_get_time(period_timer);
+		hrtimer_forward(period_timer, now, period);
 
+		soft = hrtimer_get_softexpires(period_timer);
+		hard = hrtimer_get_expires(period_timer);
+		delta = ktime_to_ns(ktime_sub(hard, soft));
+		__hrtimer_start_range_ns(period_timer, soft, delta,
+					 HRTIMER_MODE_ABS_PINNED, 0);
+	}
+}
+
+static void start_rt_bandwidth(struct rt_bandwidth *rt_b)
+{
 	if (!rt_bandwidth_enabled() || rt_b->rt_runtime == RUNTIME_INF)
 		return;
 
@@ -201,22 +222,7 @@ static void start_rt_bandwidth(struct rt_bandwidth *rt_b)
 		return;
 
 	spin_lock(&rt_b->rt_runtime_lock);
-	for (;;) {
-		unsigned long delta;
-		ktime_t soft, hard;
-
-		if (hrtimer_active(&rt_b->rt_period_timer))
-			break;
-
-		now = hrtimer_cb_get_time(&rt_b->rt_period_timer);
-		hrtimer_forward(&rt_b->rt_period_timer, now, rt_b->rt_period);
-
-		soft = hrtimer_get_softexpires(&rt_b->rt_period_timer);
-		hard = hrtimer_get_expires(&rt_b->rt_period_timer);
-		delta = ktime_to_ns(ktime_sub(hard, soft));
-		__hrtimer_start_range_ns(&rt_b->rt_period_timer, soft, delta,
-				HRTIMER_MODE_ABS_PINNED, 0);
-	}
+	start_bandwidth_timer(&rt_b->rt_period_timer, rt_b->rt_period);
 	spin_unlock(&rt_b->rt_runtime_lock);
 }
 
@@ -241,6 +247,25 @@ struct cfs_rq;
 
 static LIST_HEAD(task_groups);
 
+struct cfs_bandwidth {
+#ifdef CONFIG_CFS_BANDWIDTH
+	/* nests inside the rq lock: */
+	spinlock_t lock;
+	ktime_t period;
+	u64 quota, runtime;
+	s64 hierarchal_quota;
+	u64 runtime_expires;
+
+	int idle, timer_active;
+	struct hrtimer period_timer, slack_timer;
+	struct list_head throttled_cfs_rq;
+
+	/* statistics */
+	int nr_periods, nr_throttled;
+	u64 throttled_time;
+#endif
+};
+
 /* task group related information */
 struct task_group {
 	struct cgroup_subsys_state css;
@@ -266,6 +291,12 @@ struct task_group {
 	struct task_group *parent;
 	struct list_head siblings;
 	struct list_head children;
+
+#ifdef CONFIG_SCHED_AUTOGROUP
+	struct autogroup *autogroup;
+#endif
+
+	struct cfs_bandwidth cfs_bandwidth;
 };
 
 #define root_task_group init_task_group
@@ -305,6 +336,8 @@ static int init_task_group_load = INIT_TASK_GROUP_LOAD;
  */
 struct task_group init_task_group;
 
+#include "sched_autogroup.h"
+
 /* return group to which a task belongs */
 static inline struct task_group *task_group(struct task_struct *p)
 {
@@ -316,7 +349,7 @@ static inline struct task_group *task_group(struct task_struct *p)
 #else
 	tg = &init_task_group;
 #endif
-	return tg;
+	return autogroup_task_group(p, tg);
 }
 
 /* Change a task's cfs_rq and parent entity if it moves across CPUs/groups */
@@ -343,10 +376,18 @@ static inline struct task_group *task_group(struct task_struct *p)
 
 #endif	/* CONFIG_CGROUP_SCHED */
 
+/*
+ * Scheduling latency histogram: bucket 0 counts delays below 1024ns,
+ * bucket i delays in [2^(i+9), 2^(i+10)) ns, the last one everything
+ * from about 4.3s on.
+ */
+#define RUN_DELAY_HIST_SHIFT	10
+#define RUN_DELAY_HIST_BUCKETS	24
+
 /* CFS-related fields in a runqueue */
 struct cfs_rq {
 	struct load_weight load;
-	unsigned long nr_running;
+	unsigned long nr_running, h_nr_running;
 
 	u64 exec_clock;
 	u64 min_vruntime;
@@ -403,9 +444,34 @@ struct cfs_rq {
 	 */
 	unsigned long rq_weight;
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	int runtime_enabled;
+	u64 runtime_expires;
+	s64 runtime_remaining;
+
+	u64 throttled_timestamp;
+	int throttled, throttle_count;
+	struct list_head throttled_list;
+#endif
 #endif
 };
 
+#ifdef CONFIG_CGROUP_SCHED
+static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
+{
+	return &tg->cfs_bandwidth;
+}
+
+#ifdef CONFIG_CFS_BANDWIDTH
+static void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
+static void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
+static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
+#else
+static inline void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b) {}
+static inline void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b) {}
+#endif
+#endif /* CONFIG_CGROUP_SCHED */
+
 /* Real-Time classes' related field in a runqueue: */
 struct rt_rq {
 	struct rt_prio_array active;
@@ -576,6 +642,7 @@ struct rq {
 	struct sched_info rq_sched_info;
 	unsigned long long rq_cpu_time;
 	/* could above be rq->cfs_rq.exec_clock + rq->rt_rq.rt_runtime ? */
+	unsigned int run_delay_hist[RUN_DELAY_HIST_BUCKETS];
 
 	/* sys_sched_yield() stats */
 	unsigned int yld_count;
@@ -1179,7 +1246,7 @@ static void resched_task(struct task_struct *p)
 		smp_send_reschedule(cpu);
 }
 
-static void resched_cpu(int cpu)
+void resched_cpu(int cpu)
 {
 	struct rq *rq = cpu_rq(cpu);
 	unsigned long flags;
@@ -1437,20 +1504,22 @@ static inline void dec_cpu_load(struct rq *rq, unsigned long load)
 	update_load_sub(&rq->load, load);
 }
 
-#if (defined(CONFIG_SMP) && defined(CONFIG_FAIR_GROUP_SCHED)) || defined(CONFIG_RT_GROUP_SCHED)
+#if (defined(CONFIG_SMP) && defined(CONFIG_FAIR_GROUP_SCHED)) || \
+	defined(CONFIG_RT_GROUP_SCHED) || defined(CONFIG_CFS_BANDWIDTH)
 typedef int (*tg_visitor)(struct task_group *, void *);
 
 /*
- * Iterate the full tree, calling @down when first entering a node and @up when
- * leaving it for the final time.
+ * Iterate task_group tree rooted at *from, calling @down when first entering a
+ * node and @up when leaving it for the final time.
  */
-static int walk_tg_tree(tg_visitor down, tg_visitor up, void *data)
+static int walk_tg_tree_from(struct task_group *from,
+			     tg_visitor down, tg_visitor up, void *data)
 {
 	struct task_group *parent, *child;
 	int ret;
 
 	rcu_read_lock();
-	parent = &root_task_group;
+	parent = from;
 down:
 	ret = (*down)(parent, data);
 	if (ret)
@@ -1463,7 +1532,7 @@ up:
 		continue;
 	}
 	ret = (*up)(parent, data);
-	if (ret)
+	if (ret || parent == from)
 		goto out_unlock;
 
 	child = parent;
@@ -1476,6 +1545,15 @@ out_unlock:
 	return ret;
 }
 
+/*
+ * Iterate the full tree, calling @down when first entering a node and @up when
+ * leaving it for the final time.
+ */
+static inline int walk_tg_tree(tg_visitor down, tg_visitor up, void *data)
+{
+	return walk_tg_tree_from(&root_task_group, down, up, data);
+}
+
 static int tg_nop(struct task_group *tg, void *data)
 {
 	return 0;
@@ -1894,10 +1972,33 @@ static void sched_irq_time_avg_update(struct rq *rq, u64 curr_irq_time) { }
 
 #endif
 
+/*
+ * The scheduling classes account rq->nr_running themselves, so that
+ * tasks of throttled CFS groups don't count as runnable.
+ */
+static void inc_nr_running(struct rq *rq)
+{
+	rq->nr_running++;
+#ifdef CONFIG_NO_HZ_FULL
+	/*
+	 * A second task on a full dynticks CPU: make it reschedule, which
+	 * brings its tick back for the time slices.
+	 */
+	if (rq->nr_running == 2 && tick_nohz_full_cpu(cpu_of(rq)))
+		resched_task(rq->curr);
+#endif
+}
+
+static void dec_nr_running(struct rq *rq)
+{
+	rq->nr_running--;
+}
+
 #include "sched_stats.h"
 #include "sched_idletask.c"
 #include "sched_fair.c"
 #include "sched_rt.c"
+#include "sched_autogroup.c"
 #ifdef CONFIG_SCHED_DEBUG
 # include "sched_debug.c"
 #endif
@@ -1906,16 +2007,6 @@ static void sched_irq_time_avg_update(struct rq *rq, u64 curr_irq_time) { }
 #define for_each_class(class) \
    for (class = sched_class_highest; class; class = class->next)
 
-static void inc_nr_running(struct rq *rq)
-{
-	rq->nr_running++;
-}
-
-static void dec_nr_running(struct rq *rq)
-{
-	rq->nr_running--;
-}
-
 static void set_load_weight(struct task_struct *p)
 {
 	if (task_has_rt_policy(p)) {
@@ -2027,7 +2118,6 @@ static void activate_task(struct rq *rq, struct task_struct *p, int wakeup)
 		rq->nr_uninterruptible--;
 
 	enqueue_task(rq, p, wakeup, false);
-	inc_nr_running(rq);
 }
 
 /*
@@ -2039,7 +2129,6 @@ static void deactivate_task(struct rq *rq, struct task_struct *p, int sleep)
 		rq->nr_uninterruptible++;
 
 	dequeue_task(rq, p, sleep);
-	dec_nr_running(rq);
 }
 
 /**
@@ -2562,6 +2651,10 @@ out_activate:
 	activate_task(rq, p, 1);
 	success = 1;
 
+	/* if a worker is waking up, notify workqueue */
+	if (p->flags & PF_WQ_WORKER)
+		wq_worker_waking_up(p, cpu_of(rq));
+
 	/*
 	 * Only attribute actual wakeups done by this task.
 	 */
@@ -2605,6 +2698,46 @@ out:
 	return success;
 }
 
+/**
+ * try_to_wake_up_local - try to wake up a local task with rq lock held
+ * @p: the thread to be awakened
+ *
+ * Put @p on the run-queue if it's not already there.  The caller must
+ * ensure that this_rq() is locked, @p is bound to this_rq() and not
+ * the current task.  this_rq() stays locked over invocation.
+ */
+static void try_to_wake_up_local(struct task_struct *p)
+{
+	struct rq *rq = task_rq(p);
+	int success = 0;
+
+	BUG_ON(rq != this_rq());
+	BUG_ON(p == current);
+
+	if (!(p->state & TASK_NORMAL))
+		return;
+
+	if (!p->se.on_rq) {
+		if (likely(!task_running(rq, p))) {
+			schedstat_inc(rq, ttwu_count);
+			schedstat_inc(rq, ttwu_local);
+		}
+		schedstat_inc(p, se.nr_wakeups);
+		schedstat_inc(p, se.nr_wakeups_local);
+		activate_task(rq, p, 1);
+		success = 1;
+	}
+
+	trace_sched_wakeup(rq, p, success);
+	check_preempt_curr(rq, p, 0);
+
+	p->state = TASK_RUNNING;
+#ifdef CONFIG_SMP
+	if (p->sched_class->task_woken)
+		p->sched_class->task_woken(rq, p);
+#endif
+}
+
 /**
  * wake_up_process - Wake up a specific process
  * @p: The process to be woken up.
@@ -2679,6 +2812,13 @@ static void __sched_fork(struct task_struct *p)
 
 #endif
 
+#ifdef CONFIG_NUMA_BALANCING
+	p->numa_preferred_nid			= -1;
+	p->numa_scan_seq			= 0;
+	p->numa_migrations			= 0;
+	p->numa_pages_migrated			= 0;
+#endif
+
 	INIT_LIST_HEAD(&p->rt.run_list);
 	p->se.on_rq = 0;
 	INIT_LIST_HEAD(&p->se.group_node);
@@ -3326,6 +3466,166 @@ unlock:
 	task_rq_unlock(rq, &flags);
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * Automatic NUMA balancing: once per sampling period, a thread of each
+ * process samples the accessed bits of the next part of its address
+ * space (see mpol_numa_sample()).  The node holding a clear majority
+ * of the pages accessed recently becomes the preferred node of the
+ * thread: it is moved there if a CPU of the node is less loaded, the
+ * load balancer leaves it there, and once it runs there its hot private
+ * pages follow it.
+ */
+unsigned int sysctl_numa_balancing = 1;
+unsigned int sysctl_numa_balancing_scan_delay = 1000;	/* ms */
+unsigned int sysctl_numa_balancing_scan_period = 1000;	/* ms */
+unsigned int sysctl_numa_balancing_scan_size = 256;	/* MB */
+
+static void task_numa_placement(struct task_struct *p)
+{
+	unsigned long faults, max_faults = 0, total = 0;
+	int nid, max_nid = -1;
+
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		faults = p->numa_faults[nid];
+		total += faults;
+		if (faults > max_faults) {
+			max_faults = faults;
+			max_nid = nid;
+		}
+	}
+	if (!total)
+		return;
+
+	/* Memory spread over the nodes does not pull the task anywhere */
+	p->numa_preferred_nid = max_faults * 2 > total ? max_nid : -1;
+}
+
+/*
+ * Move the current task to the least loaded CPU of node @nid, if that
+ * does not make the load of the CPUs worse.
+ */
+static void task_numa_migrate(struct task_struct *p, int nid)
+{
+	unsigned long load, min_load = ULONG_MAX;
+	int cpu, dest_cpu = -1;
+	struct migration_req req;
+	unsigned long flags;
+	struct rq *rq;
+
+	for_each_cpu_and(cpu, cpumask_of_node(nid), &p->cpus_allowed) {
+		if (!cpu_active(cpu))
+			continue;
+		load = weighted_cpuload(cpu);
+		if (load < min_load) {
+			min_load = load;
+			dest_cpu = cpu;
+		}
+	}
+	if (dest_cpu < 0)
+		return;
+
+	rq = task_rq_lock(p, &flags);
+	if (min_load + p->se.load.weight > rq->load.weight)
+		goto unlock;
+
+	if (cpumask_test_cpu(dest_cpu, &p->cpus_allowed) &&
+	    likely(cpu_active(dest_cpu))) {
+		p->numa_migrations++;
+		if (migrate_task(p, dest_cpu, &req)) {
+			/* Wait for the migration thread, as sched_exec() */
+			struct task_struct *mt = rq->migration_thread;
+
+			get_task_struct(mt);
+			task_rq_unlock(rq, &flags);
+			wake_up_process(mt);
+			put_task_struct(mt);
+			wait_for_completion(&req.done);
+			return;
+		}
+	}
+unlock:
+	task_rq_unlock(rq, &flags);
+}
+
+/*
+ * Called on the way back to user space, see task_tick_numa().
+ */
+void task_numa_work(void)
+{
+	struct task_struct *p = current;
+	struct mm_struct *mm = p->mm;
+	unsigned long now = jiffies, next, migrated;
+	int nid, target_nid = -1;
+
+	if (!sysctl_numa_balancing || !mm ||
+	    (p->flags & (PF_EXITING | PF_KTHREAD)))
+		return;
+
+	/* One thread samples the address space per period */
+	next = mm->numa_next_scan;
+	if (time_before(now, next))
+		return;
+	if (cmpxchg(&mm->numa_next_scan, next, now +
+		    msecs_to_jiffies(sysctl_numa_balancing_scan_period)) != next)
+		return;
+
+	if (!p->numa_faults) {
+		p->numa_faults = kzalloc(sizeof(*p->numa_faults) * nr_node_ids,
+					 GFP_KERNEL);
+		if (!p->numa_faults)
+			return;
+	}
+	/* Older samples weigh half as much at each pass */
+	for (nid = 0; nid < nr_node_ids; nid++)
+		p->numa_faults[nid] >>= 1;
+
+	if (p->numa_preferred_nid == numa_node_id())
+		target_nid = p->numa_preferred_nid;
+
+	down_read(&mm->mmap_sem);
+	migrated = mpol_numa_sample(mm, &mm->numa_scan_offset,
+			sysctl_numa_balancing_scan_size << (20 - PAGE_SHIFT),
+			p->numa_faults, target_nid);
+	up_read(&mm->mmap_sem);
+
+	p->numa_scan_seq++;
+	p->numa_pages_migrated += migrated;
+
+	task_numa_placement(p);
+	nid = p->numa_preferred_nid;
+	if (nid >= 0 && nid != numa_node_id())
+		task_numa_migrate(p, nid);
+}
+
+void task_numa_free(struct task_struct *p)
+{
+	kfree(p->numa_faults);
+}
+
+/*
+ * Would moving @p from @rq to @this_cpu take it away from the node of
+ * its memory?  Balancing still wins once it keeps failing.
+ */
+static int migrate_degrades_locality(struct task_struct *p, struct rq *rq,
+				     int this_cpu, struct sched_domain *sd)
+{
+	int nid = p->numa_preferred_nid;
+
+	if (!sysctl_numa_balancing || nid < 0)
+		return 0;
+	if (sd->nr_balance_failed > sd->cache_nice_tries)
+		return 0;
+	return cpu_to_node(cpu_of(rq)) == nid && cpu_to_node(this_cpu) != nid;
+}
+#else
+static inline int migrate_degrades_locality(struct task_struct *p,
+		struct rq *rq, int this_cpu, struct sched_domain *sd)
+{
+	return 0;
+}
+#endif
+
 /*
  * pull_task - move a task from a remote runqueue to the local runqueue.
  * Both runqueues must be locked.
@@ -3365,6 +3665,9 @@ int can_migrate_task(struct task_struct *p, struct rq *rq, int this_cpu,
 		return 0;
 	}
 
+	if (migrate_degrades_locality(p, rq, this_cpu, sd))
+		return 0;
+
 	/*
 	 * Aggressive migration if:
 	 * 1) task is cache cold, or
@@ -5419,6 +5722,26 @@ void account_idle_ticks(unsigned long ticks)
 	account_idle_time(jiffies_to_cputime(ticks));
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Account multiple ticks a task ran through while a full dynticks CPU
+ * had its tick stopped.  Nothing tells where they were spent: user
+ * space for user tasks, system time for kernel threads.
+ * @p: the process that the cpu time gets accounted to
+ * @ticks: number of ticks
+ */
+void account_process_ticks(struct task_struct *p, unsigned long ticks)
+{
+	cputime_t cputime = jiffies_to_cputime(ticks);
+	cputime_t scaled = cputime_to_scaled(cputime);
+
+	if (p->mm)
+		account_user_time(p, cputime, scaled);
+	else
+		account_system_time(p, hardirq_count(), cputime, scaled);
+}
+#endif
+
 #endif
 
 /*
@@ -5746,6 +6069,7 @@ need_resched:
 	cpu = smp_processor_id();
 	rq = cpu_rq(cpu);
 	rcu_sched_qs(cpu);
+	tick_nohz_full_restart();
 	prev = rq->curr;
 	switch_count = &prev->nivcsw;
 
@@ -5764,8 +6088,22 @@ need_resched_nonpreemptible:
 	if (prev->state && !(preempt_count() & PREEMPT_ACTIVE)) {
 		if (unlikely(signal_pending_state(prev->state, prev)))
 			prev->state = TASK_RUNNING;
-		else
+		else {
+			/*
+			 * If a worker is going to sleep, notify and
+			 * ask workqueue whether it wants to wake up a
+			 * task to maintain concurrency.  If so, wake
+			 * up the task.
+			 */
+			if (prev->flags & PF_WQ_WORKER) {
+				struct task_struct *to_wakeup;
+
+				to_wakeup = wq_worker_sleeping(prev, cpu);
+				if (to_wakeup)
+					try_to_wake_up_local(to_wakeup);
+			}
 			deactivate_task(rq, prev, 1);
+		}
 		switch_count = &prev->nvcsw;
 	}
 
@@ -6485,6 +6823,21 @@ int idle_cpu(int cpu)
 	return cpu_curr(cpu) == cpu_rq(cpu)->idle;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * sched_can_stop_tick - may the tick of this cpu be stopped?
+ *
+ * Only while a single task runs: with more, the tick drives the time
+ * slices.  Called with interrupts disabled.
+ */
+int sched_can_stop_tick(void)
+{
+	struct rq *rq = this_rq();
+
+	return rq->nr_running == 1 && rq->curr != rq->idle;
+}
+#endif
+
 /**
  * idle_task - return the idle task for a given cpu.
  * @cpu: the processor in question.
@@ -9602,6 +9955,7 @@ static void init_cfs_rq(struct cfs_rq *cfs_rq, struct rq *rq)
 	INIT_LIST_HEAD(&cfs_rq->tasks);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	cfs_rq->rq = rq;
+	init_cfs_rq_runtime(cfs_rq);
 #endif
 	cfs_rq->min_vruntime = (u64)(-(1LL << 20));
 }
@@ -9761,7 +10115,8 @@ void __init sched_init(void)
 #ifdef CONFIG_CGROUP_SCHED
 	list_add(&init_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&init_task_group.children);
-
+	init_cfs_bandwidth(tg_cfs_bandwidth(&init_task_group));
+	autogroup_init(&init_task);
 #endif /* CONFIG_CGROUP_SCHED */
 
 #if defined CONFIG_FAIR_GROUP_SCHED && defined CONFIG_SMP
@@ -10040,6 +10395,8 @@ static void free_fair_sched_group(struct task_group *tg)
 {
 	int i;
 
+	destroy_cfs_bandwidth(tg_cfs_bandwidth(tg));
+
 	for_each_possible_cpu(i) {
 		if (tg->cfs_rq)
 			kfree(tg->cfs_rq[i]);
@@ -10059,6 +10416,8 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	struct rq *rq;
 	int i;
 
+	init_cfs_bandwidth(tg_cfs_bandwidth(tg));
+
 	tg->cfs_rq = kzalloc(sizeof(cfs_rq) * nr_cpu_ids, GFP_KERNEL);
 	if (!tg->cfs_rq)
 		goto err;
@@ -10213,6 +10572,7 @@ static void free_sched_group(struct task_group *tg)
 {
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
+	autogroup_free(tg);
 	kfree(tg);
 }
 
@@ -10411,12 +10771,7 @@ unsigned long sched_group_shares(struct task_group *tg)
 }
 #endif
 
-#ifdef CONFIG_RT_GROUP_SCHED
-/*
- * Ensure that the real time constraints are schedulable.
- */
-static DEFINE_MUTEX(rt_constraints_mutex);
-
+#if defined(CONFIG_RT_GROUP_SCHED) || defined(CONFIG_CFS_BANDWIDTH)
 static unsigned long to_ratio(u64 period, u64 runtime)
 {
 	if (runtime == RUNTIME_INF)
@@ -10424,6 +10779,13 @@ static unsigned long to_ratio(u64 period, u64 runtime)
 
 	return div64_u64(runtime << 20, period);
 }
+#endif
+
+#ifdef CONFIG_RT_GROUP_SCHED
+/*
+ * Ensure that the real time constraints are schedulable.
+ */
+static DEFINE_MUTEX(rt_constraints_mutex);
 
 /* Must be called with tasklist_lock held */
 static inline int tg_has_rt_tasks(struct task_group *tg)
@@ -10782,6 +11144,233 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) tg->shares;
 }
+
+#ifdef CONFIG_CFS_BANDWIDTH
+static DEFINE_MUTEX(cfs_constraints_mutex);
+
+static const u64 max_cfs_quota_period = 1 * NSEC_PER_SEC; /* 1s */
+static const u64 min_cfs_quota_period = 1 * NSEC_PER_MSEC; /* 1ms */
+
+static int __cfs_schedulable(struct task_group *tg, u64 period, u64 runtime);
+
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+{
+	int i, ret = 0, runtime_enabled;
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	/*
+	 * Ensure we have at some amount of bandwidth every period.  This is
+	 * to prevent reaching a state of large arrears when throttled via
+	 * entity_tick() resulting in prolonged exit starvation.
+	 */
+	if (quota < min_cfs_quota_period || period < min_cfs_quota_period)
+		return -EINVAL;
+
+	/*
+	 * Likewise, bound things on the otherside by preventing insane quota
+	 * periods.  This also allows us to normalize in computing quota
+	 * feasibility.
+	 */
+	if (period > max_cfs_quota_period)
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+	ret = __cfs_schedulable(tg, period, quota);
+	if (ret)
+		goto out_unlock;
+
+	runtime_enabled = quota != RUNTIME_INF;
+	spin_lock_irq(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(period);
+	cfs_b->quota = quota;
+
+	__refill_cfs_bandwidth_runtime(cfs_b);
+	/* restart the period timer (if active) to handle new period expiry */
+	if (runtime_enabled && cfs_b->timer_active) {
+		/* force a reprogram */
+		cfs_b->timer_active = 0;
+		__start_cfs_bandwidth(cfs_b);
+	}
+	spin_unlock_irq(&cfs_b->lock);
+
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+
+		spin_lock_irq(&rq->lock);
+		cfs_rq->runtime_enabled = runtime_enabled;
+		cfs_rq->runtime_remaining = 0;
+
+		if (cfs_rq_throttled(cfs_rq))
+			unthrottle_cfs_rq(cfs_rq);
+		spin_unlock_irq(&rq->lock);
+	}
+out_unlock:
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return ret;
+}
+
+static int tg_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
+{
+	u64 quota, period;
+
+	period = ktime_to_ns(tg_cfs_bandwidth(tg)->period);
+	if (cfs_quota_us < 0)
+		quota = RUNTIME_INF;
+	else
+		quota = (u64)cfs_quota_us * NSEC_PER_USEC;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static long tg_get_cfs_quota(struct task_group *tg)
+{
+	u64 quota_us;
+
+	if (tg_cfs_bandwidth(tg)->quota == RUNTIME_INF)
+		return -1;
+
+	quota_us = tg_cfs_bandwidth(tg)->quota;
+	do_div(quota_us, NSEC_PER_USEC);
+
+	return quota_us;
+}
+
+static int tg_set_cfs_period(struct task_group *tg, long cfs_period_us)
+{
+	u64 quota, period;
+
+	if (cfs_period_us <= 0)
+		return -EINVAL;
+
+	period = (u64)cfs_period_us * NSEC_PER_USEC;
+	quota = tg_cfs_bandwidth(tg)->quota;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static long tg_get_cfs_period(struct task_group *tg)
+{
+	u64 cfs_period_us;
+
+	cfs_period_us = ktime_to_ns(tg_cfs_bandwidth(tg)->period);
+	do_div(cfs_period_us, NSEC_PER_USEC);
+
+	return cfs_period_us;
+}
+
+static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_quota(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_quota_write_s64(struct cgroup *cgrp, struct cftype *cftype,
+				s64 cfs_quota_us)
+{
+	return tg_set_cfs_quota(cgroup_tg(cgrp), cfs_quota_us);
+}
+
+static u64 cpu_cfs_period_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_period(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_period_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				u64 cfs_period_us)
+{
+	return tg_set_cfs_period(cgroup_tg(cgrp), cfs_period_us);
+}
+
+struct cfs_schedulable_data {
+	struct task_group *tg;
+	u64 period, quota;
+};
+
+/*
+ * normalize group quota/period to be quota/max_period
+ * note: units are usecs
+ */
+static u64 normalize_cfs_quota(struct task_group *tg,
+			       struct cfs_schedulable_data *d)
+{
+	u64 quota, period;
+
+	if (tg == d->tg) {
+		period = d->period;
+		quota = d->quota;
+	} else {
+		period = tg_get_cfs_period(tg);
+		quota = tg_get_cfs_quota(tg);
+	}
+
+	/* note: these should typically be equivalent */
+	if (quota == RUNTIME_INF || quota == -1)
+		return RUNTIME_INF;
+
+	return to_ratio(period, quota);
+}
+
+static int tg_cfs_schedulable_down(struct task_group *tg, void *data)
+{
+	struct cfs_schedulable_data *d = data;
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
+	s64 quota = 0, parent_quota = -1;
+
+	if (!tg->parent) {
+		quota = RUNTIME_INF;
+	} else {
+		struct cfs_bandwidth *parent_b = tg_cfs_bandwidth(tg->parent);
+
+		quota = normalize_cfs_quota(tg, d);
+		parent_quota = parent_b->hierarchal_quota;
+
+		/*
+		 * ensure max(child_quota) <= parent_quota, inherit when no
+		 * limit is set
+		 */
+		if (quota == RUNTIME_INF)
+			quota = parent_quota;
+		else if (parent_quota != RUNTIME_INF && quota > parent_quota)
+			return -EINVAL;
+	}
+	cfs_b->hierarchal_quota = quota;
+
+	return 0;
+}
+
+static int __cfs_schedulable(struct task_group *tg, u64 period, u64 quota)
+{
+	struct cfs_schedulable_data data = {
+		.tg = tg,
+		.period = period,
+		.quota = quota,
+	};
+
+	if (quota != RUNTIME_INF) {
+		do_div(data.period, NSEC_PER_USEC);
+		do_div(data.quota, NSEC_PER_USEC);
+	}
+
+	return walk_tg_tree(tg_cfs_schedulable_down, tg_nop, &data);
+}
+
+static int cpu_stats_show(struct cgroup *cgrp, struct cftype *cft,
+		struct cgroup_map_cb *cb)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
+
+	cb->fill(cb, "nr_periods", cfs_b->nr_periods);
+	cb->fill(cb, "nr_throttled", cfs_b->nr_throttled);
+	cb->fill(cb, "throttled_time", cfs_b->throttled_time);
+
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -10816,6 +11405,22 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_shares_write_u64,
 	},
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		.name = "cfs_quota_us",
+		.read_s64 = cpu_cfs_quota_read_s64,
+		.write_s64 = cpu_cfs_quota_write_s64,
+	},
+	{
+		.name = "cfs_period_us",
+		.read_u64 = cpu_cfs_period_read_u64,
+		.write_u64 = cpu_cfs_period_write_u64,
+	},
+	{
+		.name = "stat",
+		.read_map = cpu_stats_show,
+	},
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
 		.name = "rt_runtime_us",
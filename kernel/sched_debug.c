@@ -87,6 +87,21 @@ static void print_cfs_group_stats(struct seq_file *m, int cpu,
 }
 #endif
 
+#ifdef CONFIG_CGROUP_SCHED
+static void task_group_path(struct task_group *tg, char *buf, int buflen)
+{
+	if (autogroup_path(tg, buf, buflen))
+		return;
+
+	/* may be NULL if the underlying cgroup isn't fully-created yet */
+	if (!tg->css.cgroup) {
+		buf[0] = '\0';
+		return;
+	}
+	cgroup_path(tg->css.cgroup, buf, buflen);
+}
+#endif
+
 static void
 print_task(struct seq_file *m, struct rq *rq, struct task_struct *p)
 {
@@ -114,7 +129,7 @@ print_task(struct seq_file *m, struct rq *rq, struct task_struct *p)
 	{
 		char path[64];
 
-		cgroup_path(task_group(p)->css.cgroup, path, sizeof(path));
+		task_group_path(task_group(p), path, sizeof(path));
 		SEQ_printf(m, " %s", path);
 	}
 #endif
@@ -145,19 +160,6 @@ static void print_rq(struct seq_file *m, struct rq *rq, int rq_cpu)
 	read_unlock_irqrestore(&tasklist_lock, flags);
 }
 
-#if defined(CONFIG_CGROUP_SCHED) && \
-	(defined(CONFIG_FAIR_GROUP_SCHED) || defined(CONFIG_RT_GROUP_SCHED))
-static void task_group_path(struct task_group *tg, char *buf, int buflen)
-{
-	/* may be NULL if the underlying cgroup isn't fully-created yet */
-	if (!tg->css.cgroup) {
-		buf[0] = '\0';
-		return;
-	}
-	cgroup_path(tg->css.cgroup, buf, buflen);
-}
-#endif
-
 void print_cfs_rq(struct seq_file *m, int cpu, struct cfs_rq *cfs_rq)
 {
 	s64 MIN_vruntime = -1, min_vruntime, max_vruntime = -1,
@@ -211,6 +213,12 @@ void print_cfs_rq(struct seq_file *m, int cpu, struct cfs_rq *cfs_rq)
 #endif
 	print_cfs_group_stats(m, cpu, cfs_rq->tg);
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	SEQ_printf(m, "  .%-30s: %d\n", "throttled",
+			cfs_rq->throttled);
+	SEQ_printf(m, "  .%-30s: %d\n", "throttle_count",
+			cfs_rq->throttle_count);
+#endif
 }
 
 void print_rt_rq(struct seq_file *m, int cpu, struct rt_rq *rt_rq)
@@ -241,6 +249,30 @@ void print_rt_rq(struct seq_file *m, int cpu, struct rt_rq *rt_rq)
 #undef P
 }
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Distribution of the time tasks spent runnable on this cpu before
+ * getting to run, in nanoseconds.
+ */
+static void print_run_delay_hist(struct seq_file *m, struct rq *rq)
+{
+	unsigned long long lo, hi;
+	int i;
+
+	SEQ_printf(m, "  .%-30s:\n", "run_delay_hist");
+	for (i = 0; i < RUN_DELAY_HIST_BUCKETS; i++) {
+		lo = i ? 1ULL << (i + RUN_DELAY_HIST_SHIFT - 1) : 0;
+		hi = (1ULL << (i + RUN_DELAY_HIST_SHIFT)) - 1;
+		if (i == RUN_DELAY_HIST_BUCKETS - 1)
+			SEQ_printf(m, "    %12Lu - %12s : %u\n",
+				   lo, "", rq->run_delay_hist[i]);
+		else
+			SEQ_printf(m, "    %12Lu - %12Lu : %u\n",
+				   lo, hi, rq->run_delay_hist[i]);
+	}
+}
+#endif
+
 static void print_cpu(struct seq_file *m, int cpu)
 {
 	struct rq *rq = cpu_rq(cpu);
@@ -297,6 +329,7 @@ static void print_cpu(struct seq_file *m, int cpu)
 	P(bkl_count);
 
 #undef P
+	print_run_delay_hist(m, rq);
 #endif
 	print_cfs_stats(m, cpu);
 	print_rt_stats(m, cpu);
@@ -309,7 +342,7 @@ static int sched_debug_show(struct seq_file *m, void *v)
 	u64 now = ktime_to_ns(ktime_get());
 	int cpu;
 
-	SEQ_printf(m, "Sched Debug Version: v0.09, %s %.*s\n",
+	SEQ_printf(m, "Sched Debug Version: v0.10, %s %.*s\n",
 		init_utsname()->release,
 		(int)strcspn(init_utsname()->version, " "),
 		init_utsname()->version);
@@ -458,6 +491,19 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.load.weight);
 	P(policy);
 	P(prio);
+#ifdef CONFIG_NUMA_BALANCING
+	P(numa_preferred_nid);
+	P(numa_scan_seq);
+	P(numa_migrations);
+	P(numa_pages_migrated);
+	if (p->numa_faults) {
+		int nid;
+
+		for (nid = 0; nid < nr_node_ids; nid++)
+			SEQ_printf(m, "numa_faults node%-26d:%21Ld\n", nid,
+				   (long long)p->numa_faults[nid]);
+	}
+#endif
 #undef PN
 #undef __PN
 #undef P
@@ -503,6 +549,10 @@ void proc_sched_set_task(struct task_struct *p)
 	p->se.nr_wakeups_passive		= 0;
 	p->se.nr_wakeups_idle			= 0;
 	p->sched_info.bkl_count			= 0;
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	p->numa_migrations			= 0;
+	p->numa_pages_migrated			= 0;
 #endif
 	p->se.sum_exec_runtime			= 0;
 	p->se.prev_sum_exec_runtime		= 0;
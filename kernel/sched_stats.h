@@ -111,8 +111,11 @@ static inline void
 rq_sched_info_arrive(struct rq *rq, unsigned long long delta)
 {
 	if (rq) {
+		int idx = fls64(delta >> RUN_DELAY_HIST_SHIFT);
+
 		rq->rq_sched_info.run_delay += delta;
 		rq->rq_sched_info.pcount++;
+		rq->run_delay_hist[min(idx, RUN_DELAY_HIST_BUCKETS - 1)]++;
 	}
 }
 
@@ -41,6 +41,7 @@
 #include <linux/syscalls.h>
 #include <linux/kprobes.h>
 #include <linux/user_namespace.h>
+#include <linux/futex.h>
 
 #include <asm/uaccess.h>
 #include <asm/io.h>
@@ -1107,8 +1108,10 @@ SYSCALL_DEFINE0(setsid)
 	err = session;
 out:
 	write_unlock_irq(&tasklist_lock);
-	if (err > 0)
+	if (err > 0) {
 		proc_sid_connector(group_leader);
+		sched_autogroup_create_attach(group_leader);
+	}
 	return err;
 }
 
@@ -1575,6 +1578,11 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			else
 				error = PR_MCE_KILL_DEFAULT;
 			break;
+		case PR_FUTEX_HASH:
+			if (arg4 | arg5)
+				return -EINVAL;
+			error = futex_hash_prctl(arg2, arg3);
+			break;
 		default:
 			error = -EINVAL;
 			break;
@@ -17,6 +17,7 @@
 #include <linux/interrupt.h>
 #include <linux/kernel_stat.h>
 #include <linux/percpu.h>
+#include <linux/posix-timers.h>
 #include <linux/profile.h>
 #include <linux/sched.h>
 #include <linux/tick.h>
@@ -195,6 +196,23 @@ u64 get_cpu_idle_time_us(int cpu, u64 *last_update_time)
 }
 EXPORT_SYMBOL_GPL(get_cpu_idle_time_us);
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * With full dynticks CPUs around, the CPU in charge of do_timer() keeps
+ * its tick while idle: the full dynticks CPUs never take the duty over,
+ * so the jiffies could otherwise stall.  Until some CPU has the duty,
+ * nobody stops its tick.
+ */
+static int tick_nohz_full_keep_tick(int cpu)
+{
+	return tick_nohz_full_running &&
+	       (cpu == tick_do_timer_cpu ||
+		tick_do_timer_cpu == TICK_DO_TIMER_NONE);
+}
+#else
+static inline int tick_nohz_full_keep_tick(int cpu) { return 0; }
+#endif
+
 /**
  * tick_nohz_stop_sched_tick - stop the idle tick from the idle task
  *
@@ -282,7 +300,7 @@ void tick_nohz_stop_sched_tick(int inidle)
 	} while (read_seqretry(&xtime_lock, seq));
 
 	if (rcu_needs_cpu(cpu) || printk_needs_cpu(cpu) ||
-	    arch_needs_cpu(cpu)) {
+	    arch_needs_cpu(cpu) || tick_nohz_full_keep_tick(cpu)) {
 		next_jiffies = last_jiffies + 1;
 		delta_jiffies = 1;
 	} else {
@@ -502,6 +520,195 @@ void tick_nohz_restart_sched_tick(void)
 	local_irq_enable();
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Full dynticks: on the CPUs given by nohz_full=, the tick is also
+ * stopped while a single task runs, down to a residual tick per second
+ * which keeps the scheduler statistics going.  The tick comes back
+ * whenever the CPU schedules, and CPU timers, timer wheel timers and
+ * RCU kick it back on through a reschedule when they need it.
+ */
+cpumask_var_t tick_nohz_full_mask;
+bool tick_nohz_full_running;
+
+static int __init tick_nohz_full_setup(char *str)
+{
+	int cpu;
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		printk(KERN_WARNING "NOHZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+
+	/* The boot CPU keeps the do_timer() duty. */
+	cpu = smp_processor_id();
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		printk(KERN_WARNING "NOHZ: Clearing %d from nohz_full range "
+		       "for timekeeping\n", cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+	tick_nohz_full_running = !cpumask_empty(tick_nohz_full_mask);
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+
+static int tick_nohz_full_can_stop(int cpu)
+{
+	if (cpu == tick_do_timer_cpu)
+		return 0;
+	if (!sched_can_stop_tick())
+		return 0;
+	if (!posix_cpu_timers_can_stop_tick(current))
+		return 0;
+	if (rcu_cpu_needs_tick(cpu) || printk_needs_cpu(cpu) ||
+	    arch_needs_cpu(cpu))
+		return 0;
+	return !local_softirq_pending();
+}
+
+/*
+ * Account the ticks the current task ran through with the tick stopped,
+ * but the @accounted ones the tick handler takes care of.
+ */
+static void tick_nohz_full_account(struct tick_sched *ts,
+				   unsigned long accounted)
+{
+	unsigned long ticks = jiffies - ts->full_jiffies;
+
+	if (ticks > accounted && ticks < LONG_MAX)
+		account_process_ticks(current, ticks - accounted);
+	ts->full_jiffies = jiffies;
+}
+
+static void tick_nohz_full_restart_tick(struct tick_sched *ts)
+{
+	tick_nohz_full_account(ts, 0);
+	ts->full_stopped = 0;
+	tick_nohz_restart(ts, ktime_get());
+}
+
+static void tick_nohz_full_stop_tick(struct tick_sched *ts)
+{
+	struct clock_event_device *dev = __get_cpu_var(tick_cpu_device).evtdev;
+	unsigned long seq, last_jiffies, next_jiffies, delta_jiffies;
+	ktime_t last_update, expires;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		last_update = last_jiffies_update;
+		last_jiffies = jiffies;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	next_jiffies = get_next_timer_interrupt(last_jiffies);
+	delta_jiffies = next_jiffies - last_jiffies;
+	if ((long)delta_jiffies <= 1) {
+		if (ts->full_stopped)
+			tick_nohz_full_restart_tick(ts);
+		return;
+	}
+	if (delta_jiffies > HZ)
+		delta_jiffies = HZ;
+	expires = ktime_add_ns(last_update, tick_period.tv64 * delta_jiffies);
+
+	if (ts->full_stopped && ktime_equal(expires, dev->next_event))
+		return;
+
+	if (!ts->full_stopped) {
+		ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
+		ts->full_jiffies = last_jiffies;
+		ts->full_stopped = 1;
+	}
+	ts->next_jiffies = last_jiffies + delta_jiffies;
+
+	if (ts->nohz_mode == NOHZ_MODE_HIGHRES) {
+		hrtimer_start(&ts->sched_timer, expires,
+			      HRTIMER_MODE_ABS_PINNED);
+		/* Check, if the timer was already in the past */
+		if (hrtimer_active(&ts->sched_timer))
+			return;
+	} else if (!tick_program_event(expires, 0))
+		return;
+
+	/* We are past the event already, keep ticking. */
+	tick_nohz_full_restart_tick(ts);
+}
+
+/*
+ * Called from irq_exit() on a CPU that is not idle, with interrupts
+ * disabled: stop the tick if only one task is runnable, restart it if
+ * the tick is needed again.
+ */
+void __tick_nohz_full_check(void)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (!tick_nohz_full_cpu(cpu) || ts->inidle ||
+	    ts->nohz_mode == NOHZ_MODE_INACTIVE)
+		return;
+
+	if (tick_nohz_full_can_stop(cpu))
+		tick_nohz_full_stop_tick(ts);
+	else if (ts->full_stopped)
+		tick_nohz_full_restart_tick(ts);
+}
+
+/*
+ * Called from schedule(): whatever runs next, the tick is back until
+ * the next irq_exit() decides otherwise.
+ */
+void __tick_nohz_full_restart(void)
+{
+	struct tick_sched *ts;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	ts = &__get_cpu_var(tick_cpu_sched);
+	if (ts->full_stopped)
+		tick_nohz_full_restart_tick(ts);
+	local_irq_restore(flags);
+}
+
+/**
+ * tick_nohz_full_kick_cpu - get the tick of a full dynticks CPU back
+ * @cpu:	the CPU
+ *
+ * The CPU is made to reschedule, which restarts its tick.  Safe to call
+ * from any context, with any lock held: the kick is skipped if the
+ * runqueue lock of @cpu is contended.
+ */
+void tick_nohz_full_kick_cpu(int cpu)
+{
+	if (!tick_nohz_full_cpu(cpu) || !cpu_online(cpu))
+		return;
+	if (!ACCESS_ONCE(per_cpu(tick_cpu_sched, cpu).full_stopped))
+		return;
+	resched_cpu(cpu);
+}
+
+void tick_nohz_full_kick_all(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running)
+		return;
+	for_each_cpu(cpu, tick_nohz_full_mask)
+		tick_nohz_full_kick_cpu(cpu);
+}
+
+/*
+ * A timer expiring at @expires was queued on @cpu: kick the CPU if its
+ * tick has been stopped beyond that.
+ */
+void tick_nohz_full_kick_timer(int cpu, unsigned long expires)
+{
+	if (tick_nohz_full_cpu(cpu) &&
+	    time_before(expires, per_cpu(tick_cpu_sched, cpu).next_jiffies))
+		tick_nohz_full_kick_cpu(cpu);
+}
+#endif /* CONFIG_NO_HZ_FULL */
+
 static int tick_nohz_reprogram(struct tick_sched *ts, ktime_t now)
 {
 	hrtimer_forward(&ts->sched_timer, now, tick_period);
@@ -527,7 +734,8 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 
 	/* Check, if the jiffies need an update */
@@ -546,6 +754,10 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 		touch_softlockup_watchdog();
 		ts->idle_jiffies++;
 	}
+#ifdef CONFIG_NO_HZ_FULL
+	if (ts->full_stopped)
+		tick_nohz_full_account(ts, 1);
+#endif
 
 	update_process_times(user_mode(regs));
 	profile_tick(CPU_PROFILING);
@@ -682,7 +894,8 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -707,6 +920,10 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 			touch_softlockup_watchdog();
 			ts->idle_jiffies++;
 		}
+#ifdef CONFIG_NO_HZ_FULL
+		if (ts->full_stopped)
+			tick_nohz_full_account(ts, 1);
+#endif
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
 	}
@@ -186,6 +186,23 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 
 #undef P
 #undef P_ns
+
+#define P(x) \
+	SEQ_printf(m, "  .%-15s: %Lu\n", #x, \
+		   (unsigned long long)(st.x))
+	{
+		struct timer_wheel_stats st;
+
+		timer_wheel_get_stats(cpu, &st);
+		SEQ_printf(m, " timer wheel:\n");
+		P(queued);
+		P(expired);
+		P(batches);
+		P(max_batch);
+		SEQ_printf(m, "  .%-15s: %Lu nsecs\n", "max_run",
+			   (unsigned long long)st.max_run_ns);
+	}
+#undef P
 }
 
 #ifdef CONFIG_GENERIC_CLOCKEVENTS
@@ -255,7 +272,7 @@ static int timer_list_show(struct seq_file *m, void *v)
 	u64 now = ktime_to_ns(ktime_get());
 	int cpu;
 
-	SEQ_printf(m, "Timer List Version: v0.5\n");
+	SEQ_printf(m, "Timer List Version: v0.6\n");
 	SEQ_printf(m, "HRTIMER_MAX_CLOCK_BASES: %d\n", HRTIMER_MAX_CLOCK_BASES);
 	SEQ_printf(m, "now at %Ld nsecs\n", (unsigned long long)now);
 
@@ -54,33 +54,63 @@ u64 jiffies_64 __cacheline_aligned_in_smp = INITIAL_JIFFIES;
 EXPORT_SYMBOL(jiffies_64);
 
 /*
- * per-CPU timer vector definitions:
+ * per-CPU timer wheel definitions:
+ *
+ * The wheel has LVL_DEPTH levels of LVL_SIZE buckets.  Level 0 has the
+ * granularity of a jiffy, each further level is LVL_CLK_DIV times as
+ * coarse.  A timer is queued once, in the level whose range covers its
+ * timeout, with its expiry rounded up to the granularity of that level,
+ * and it is never moved (cascaded) from there: a timer in level n may
+ * expire up to LVL_GRAN(n) - 1 jiffies late, which is at most 1/8 of
+ * its timeout.  All the timers of a bucket expire in one batch.
+ *
+ * HZ 1000, 64 buckets per level:
+ * Level Offset  Granularity            Range
+ *  0      0         1 ms                0 ms -         63 ms
+ *  1     64         8 ms               64 ms -        511 ms
+ *  2    128        64 ms              512 ms -       4095 ms (512ms - ~4s)
+ *  3    192       512 ms             4096 ms -      32767 ms (~4s - ~32s)
+ *  4    256      4096 ms (~4s)      32768 ms -     262143 ms (~32s - ~4m)
+ *  5    320     32768 ms (~32s)    262144 ms -    2097151 ms (~4m - ~34m)
+ *  6    384    262144 ms (~4m)    2097152 ms -   16777215 ms (~34m - ~4h)
+ *  7    448   2097152 ms (~34m)  16777216 ms -  134217727 ms (~4h - ~1d)
+ *  8    512  16777216 ms (~4h)  134217728 ms - 1073741822 ms (~1d - ~12d)
+ *
+ * Longer timeouts are cut to the range of the last level.
  */
-#define TVN_BITS (CONFIG_BASE_SMALL ? 4 : 6)
-#define TVR_BITS (CONFIG_BASE_SMALL ? 6 : 8)
-#define TVN_SIZE (1 << TVN_BITS)
-#define TVR_SIZE (1 << TVR_BITS)
-#define TVN_MASK (TVN_SIZE - 1)
-#define TVR_MASK (TVR_SIZE - 1)
-
-struct tvec {
-	struct list_head vec[TVN_SIZE];
-};
+#define LVL_CLK_SHIFT	3
+#define LVL_CLK_DIV	(1UL << LVL_CLK_SHIFT)
+#define LVL_CLK_MASK	(LVL_CLK_DIV - 1)
+#define LVL_SHIFT(n)	((n) * LVL_CLK_SHIFT)
+#define LVL_GRAN(n)	(1UL << LVL_SHIFT(n))
+
+#define LVL_BITS	(CONFIG_BASE_SMALL ? 4 : 6)
+#define LVL_SIZE	(1UL << LVL_BITS)
+#define LVL_MASK	(LVL_SIZE - 1)
+#define LVL_OFFS(n)	((n) * LVL_SIZE)
+
+/* First timeout (in jiffies) handled by level n, n > 0 */
+#define LVL_START(n)	((LVL_SIZE - 1) << (((n) - 1) * LVL_CLK_SHIFT))
+
+#if HZ > 100
+# define LVL_DEPTH	9
+#else
+# define LVL_DEPTH	8
+#endif
 
-struct tvec_root {
-	struct list_head vec[TVR_SIZE];
-};
+#define WHEEL_TIMEOUT_CUTOFF	(LVL_START(LVL_DEPTH))
+#define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
+#define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
 struct tvec_base {
 	spinlock_t lock;
 	struct timer_list *running_timer;
 	unsigned long timer_jiffies;
 	unsigned long next_timer;
-	struct tvec_root tv1;
-	struct tvec tv2;
-	struct tvec tv3;
-	struct tvec tv4;
-	struct tvec tv5;
+	int cpu;
+	struct timer_wheel_stats stats;
+	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
+	struct list_head vectors[WHEEL_SIZE];
 } ____cacheline_aligned;
 
 struct tvec_base boot_tvec_bases;
@@ -327,46 +357,54 @@ static inline void set_running_timer(struct tvec_base *base,
 #endif
 }
 
+/*
+ * Bucket of @expires in level @lvl: the expiry is rounded up to the
+ * granularity of the level, so that the timer never fires early.
+ */
+static inline unsigned int calc_index(unsigned long expires, unsigned int lvl,
+				      unsigned long *bucket_expiry)
+{
+	expires = (expires + LVL_GRAN(lvl) - 1) >> LVL_SHIFT(lvl);
+	*bucket_expiry = expires << LVL_SHIFT(lvl);
+	return LVL_OFFS(lvl) + (expires & LVL_MASK);
+}
+
 static void internal_add_timer(struct tvec_base *base, struct timer_list *timer)
 {
 	unsigned long expires = timer->expires;
-	unsigned long idx = expires - base->timer_jiffies;
-	struct list_head *vec;
-
-	if (idx < TVR_SIZE) {
-		int i = expires & TVR_MASK;
-		vec = base->tv1.vec + i;
-	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
-		int i = (expires >> TVR_BITS) & TVN_MASK;
-		vec = base->tv2.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
-		vec = base->tv3.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv4.vec + i;
-	} else if ((signed long) idx < 0) {
+	unsigned long clk = base->timer_jiffies;
+	unsigned long delta = expires - clk;
+	unsigned long bucket_expiry;
+	unsigned int idx, lvl;
+
+	if ((long) delta < 0) {
 		/*
 		 * Can happen if you add a timer with expires == jiffies,
 		 * or you set a timer to go off in the past
 		 */
-		vec = base->tv1.vec + (base->timer_jiffies & TVR_MASK);
+		idx = clk & LVL_MASK;
+		bucket_expiry = clk;
 	} else {
-		int i;
-		/* If the timeout is larger than 0xffffffff on 64-bit
-		 * architectures then we use the maximum timeout:
-		 */
-		if (idx > 0xffffffffUL) {
-			idx = 0xffffffffUL;
-			expires = idx + base->timer_jiffies;
+		/* Cut the timeouts beyond the range of the wheel */
+		if (delta >= WHEEL_TIMEOUT_CUTOFF) {
+			expires = clk + WHEEL_TIMEOUT_MAX;
+			delta = WHEEL_TIMEOUT_MAX;
 		}
-		i = (expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv5.vec + i;
+		for (lvl = 0; lvl < LVL_DEPTH - 1; lvl++)
+			if (delta < LVL_START(lvl + 1))
+				break;
+		idx = calc_index(expires, lvl, &bucket_expiry);
 	}
 	/*
 	 * Timers are FIFO:
 	 */
-	list_add_tail(&timer->entry, vec);
+	list_add_tail(&timer->entry, base->vectors + idx);
+	__set_bit(idx, base->pending_map);
+	base->stats.queued++;
+
+	if (time_before(bucket_expiry, base->next_timer) &&
+	    !tbase_get_deferrable(timer->base))
+		base->next_timer = bucket_expiry;
 }
 
 #ifdef CONFIG_TIMER_STATS
@@ -585,19 +623,46 @@ void init_timer_deferrable_key(struct timer_list *timer,
 }
 EXPORT_SYMBOL(init_timer_deferrable_key);
 
-static inline void detach_timer(struct timer_list *timer,
-				int clear_pending)
+/*
+ * Timers do not record their bucket.  When the last timer of a bucket
+ * goes, the list head is left alone, both neighbours of the removed
+ * entry, and its address gives the bucket whose pending bit is cleared.
+ * Timers detached from a private list of expired timers do not match.
+ */
+static inline void detach_timer(struct tvec_base *base,
+				struct timer_list *timer, int clear_pending)
 {
 	struct list_head *entry = &timer->entry;
+	struct list_head *prev = entry->prev;
 
 	debug_deactivate(timer);
 
-	__list_del(entry->prev, entry->next);
+	__list_del(prev, entry->next);
+	if (prev == entry->next && prev >= base->vectors &&
+	    prev < base->vectors + WHEEL_SIZE)
+		__clear_bit(prev - base->vectors, base->pending_map);
 	if (clear_pending)
 		entry->next = NULL;
 	entry->prev = LIST_POISON2;
 }
 
+static int detach_if_pending(struct timer_list *timer,
+			     struct tvec_base *base, int clear_pending)
+{
+	if (!timer_pending(timer))
+		return 0;
+
+	detach_timer(base, timer, clear_pending);
+	/*
+	 * The cached next expiry may be the bucket of this timer, at or
+	 * after its expiry: have it recomputed.
+	 */
+	if (!time_after(timer->expires, base->next_timer) &&
+	    !tbase_get_deferrable(timer->base))
+		base->next_timer = base->timer_jiffies;
+	return 1;
+}
+
 /*
  * We are using hashed locking: holding per_cpu(tvec_bases).lock
  * means that all timers which are tied to this base via timer->base are
@@ -643,16 +708,9 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 
 	base = lock_timer_base(timer, &flags);
 
-	if (timer_pending(timer)) {
-		detach_timer(timer, 0);
-		if (timer->expires == base->next_timer &&
-		    !tbase_get_deferrable(timer->base))
-			base->next_timer = base->timer_jiffies;
-		ret = 1;
-	} else {
-		if (pending_only)
-			goto out_unlock;
-	}
+	ret = detach_if_pending(timer, base, 0);
+	if (!ret && pending_only)
+		goto out_unlock;
 
 	debug_activate(timer, expires);
 
@@ -689,10 +747,12 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	}
 
 	timer->expires = expires;
-	if (time_before(timer->expires, base->next_timer) &&
-	    !tbase_get_deferrable(timer->base))
-		base->next_timer = timer->expires;
 	internal_add_timer(base, timer);
+	/*
+	 * A running timer stays on its old base, so kick the CPU
+	 * owning the base it was actually queued on.
+	 */
+	tick_nohz_full_kick_timer(base->cpu, timer->expires);
 
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
@@ -810,9 +870,6 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	spin_lock_irqsave(&base->lock, flags);
 	timer_set_base(timer, base);
 	debug_activate(timer, timer->expires);
-	if (time_before(timer->expires, base->next_timer) &&
-	    !tbase_get_deferrable(timer->base))
-		base->next_timer = timer->expires;
 	internal_add_timer(base, timer);
 	/*
 	 * Check whether the other CPU is idle and needs to be
@@ -823,6 +880,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	 * the timer wheel.
 	 */
 	wake_up_idle_cpu(cpu);
+	tick_nohz_full_kick_timer(cpu, timer->expires);
 	spin_unlock_irqrestore(&base->lock, flags);
 }
 EXPORT_SYMBOL_GPL(add_timer_on);
@@ -847,13 +905,7 @@ int del_timer(struct timer_list *timer)
 	timer_stats_timer_clear_start_info(timer);
 	if (timer_pending(timer)) {
 		base = lock_timer_base(timer, &flags);
-		if (timer_pending(timer)) {
-			detach_timer(timer, 1);
-			if (timer->expires == base->next_timer &&
-			    !tbase_get_deferrable(timer->base))
-				base->next_timer = base->timer_jiffies;
-			ret = 1;
-		}
+		ret = detach_if_pending(timer, base, 1);
 		spin_unlock_irqrestore(&base->lock, flags);
 	}
 
@@ -882,14 +934,7 @@ int try_to_del_timer_sync(struct timer_list *timer)
 	if (base->running_timer == timer)
 		goto out;
 
-	ret = 0;
-	if (timer_pending(timer)) {
-		detach_timer(timer, 1);
-		if (timer->expires == base->next_timer &&
-		    !tbase_get_deferrable(timer->base))
-			base->next_timer = base->timer_jiffies;
-		ret = 1;
-	}
+	ret = detach_if_pending(timer, base, 1);
 out:
 	spin_unlock_irqrestore(&base->lock, flags);
 
@@ -935,116 +980,171 @@ int del_timer_sync(struct timer_list *timer)
 EXPORT_SYMBOL(del_timer_sync);
 #endif
 
-static int cascade(struct tvec_base *base, struct tvec *tv, int index)
+/*
+ * Move the buckets due at base->timer_jiffies to @heads, one list per
+ * level.  A level is only due when the clock of the level below wraps
+ * to a multiple of LVL_CLK_DIV.
+ */
+static int collect_expired_timers(struct tvec_base *base,
+				  struct list_head *heads)
 {
-	/* cascade all the timers from tv up one level */
-	struct timer_list *timer, *tmp;
-	struct list_head tv_list;
+	unsigned long clk = base->timer_jiffies;
+	unsigned int idx;
+	int i, levels = 0;
 
-	list_replace_init(tv->vec + index, &tv_list);
+	for (i = 0; i < LVL_DEPTH; i++) {
+		idx = (clk & LVL_MASK) + i * LVL_SIZE;
 
-	/*
-	 * We are removing _all_ timers from the list, so we
-	 * don't have to detach them individually.
-	 */
-	list_for_each_entry_safe(timer, tmp, &tv_list, entry) {
-		BUG_ON(tbase_get_base(timer->base) != base);
-		internal_add_timer(base, timer);
+		if (__test_and_clear_bit(idx, base->pending_map)) {
+			list_replace_init(base->vectors + idx, heads + levels);
+			levels++;
+		}
+		/* Is it time to look at the next level? */
+		if (clk & LVL_CLK_MASK)
+			break;
+		/* Shift clock for the next level granularity */
+		clk >>= LVL_CLK_SHIFT;
 	}
-
-	return index;
+	return levels;
 }
 
-#define INDEX(N) ((base->timer_jiffies >> (TVR_BITS + (N) * TVN_BITS)) & TVN_MASK)
-
-/**
- * __run_timers - run all expired timers (if any) on this CPU.
- * @base: the timer vector to be processed.
- *
- * This function cascades all vectors and executes all expired timer
- * vectors.
+/*
+ * Run a batch of expired timers.  base->lock is dropped around each
+ * callback.
  */
-static inline void __run_timers(struct tvec_base *base)
+static void expire_timers(struct tvec_base *base, struct list_head *head)
 {
 	struct timer_list *timer;
+	unsigned long batch = 0;
 
-	spin_lock_irq(&base->lock);
-	while (time_after_eq(jiffies, base->timer_jiffies)) {
-		struct list_head work_list;
-		struct list_head *head = &work_list;
-		int index = base->timer_jiffies & TVR_MASK;
-
-		/*
-		 * Cascade timers:
-		 */
-		if (!index &&
-			(!cascade(base, &base->tv2, INDEX(0))) &&
-				(!cascade(base, &base->tv3, INDEX(1))) &&
-					!cascade(base, &base->tv4, INDEX(2)))
-			cascade(base, &base->tv5, INDEX(3));
-		++base->timer_jiffies;
-		list_replace_init(base->tv1.vec + index, &work_list);
-		while (!list_empty(head)) {
-			void (*fn)(unsigned long);
-			unsigned long data;
+	while (!list_empty(head)) {
+		void (*fn)(unsigned long);
+		unsigned long data;
 
-			timer = list_first_entry(head, struct timer_list,entry);
-			fn = timer->function;
-			data = timer->data;
+		timer = list_first_entry(head, struct timer_list,entry);
+		fn = timer->function;
+		data = timer->data;
 
-			timer_stats_account_timer(timer);
+		timer_stats_account_timer(timer);
 
-			set_running_timer(base, timer);
-			detach_timer(timer, 1);
+		set_running_timer(base, timer);
+		detach_timer(base, timer, 1);
 
-			spin_unlock_irq(&base->lock);
-			{
-				int preempt_count = preempt_count();
+		spin_unlock_irq(&base->lock);
+		{
+			int preempt_count = preempt_count();
 
 #ifdef CONFIG_LOCKDEP
-				/*
-				 * It is permissible to free the timer from
-				 * inside the function that is called from
-				 * it, this we need to take into account for
-				 * lockdep too. To avoid bogus "held lock
-				 * freed" warnings as well as problems when
-				 * looking into timer->lockdep_map, make a
-				 * copy and use that here.
-				 */
-				struct lockdep_map lockdep_map =
-					timer->lockdep_map;
+			/*
+			 * It is permissible to free the timer from
+			 * inside the function that is called from
+			 * it, this we need to take into account for
+			 * lockdep too. To avoid bogus "held lock
+			 * freed" warnings as well as problems when
+			 * looking into timer->lockdep_map, make a
+			 * copy and use that here.
+			 */
+			struct lockdep_map lockdep_map =
+				timer->lockdep_map;
 #endif
-				/*
-				 * Couple the lock chain with the lock chain at
-				 * del_timer_sync() by acquiring the lock_map
-				 * around the fn() call here and in
-				 * del_timer_sync().
-				 */
-				lock_map_acquire(&lockdep_map);
-
-				trace_timer_expire_entry(timer);
-				fn(data);
-				trace_timer_expire_exit(timer);
-
-				lock_map_release(&lockdep_map);
-
-				if (preempt_count != preempt_count()) {
-					printk(KERN_ERR "huh, entered %p "
-					       "with preempt_count %08x, exited"
-					       " with %08x?\n",
-					       fn, preempt_count,
-					       preempt_count());
-					BUG();
-				}
+			/*
+			 * Couple the lock chain with the lock chain at
+			 * del_timer_sync() by acquiring the lock_map
+			 * around the fn() call here and in
+			 * del_timer_sync().
+			 */
+			lock_map_acquire(&lockdep_map);
+
+			trace_timer_expire_entry(timer);
+			fn(data);
+			trace_timer_expire_exit(timer);
+
+			lock_map_release(&lockdep_map);
+
+			if (preempt_count != preempt_count()) {
+				printk(KERN_ERR "huh, entered %p "
+				       "with preempt_count %08x, exited"
+				       " with %08x?\n",
+				       fn, preempt_count,
+				       preempt_count());
+				BUG();
 			}
-			spin_lock_irq(&base->lock);
 		}
+		spin_lock_irq(&base->lock);
+		batch++;
+	}
+
+	base->stats.expired += batch;
+	base->stats.batches++;
+	if (batch > base->stats.max_batch)
+		base->stats.max_batch = batch;
+}
+
+/**
+ * __run_timers - run all expired timers (if any) on this CPU.
+ * @base: the timer vector to be processed.
+ *
+ * This function collects the due buckets of all levels and executes
+ * the expired timers, one bucket at a time.
+ */
+static inline void __run_timers(struct tvec_base *base)
+{
+	struct list_head heads[LVL_DEPTH];
+	u64 start = sched_clock();
+	int levels;
+
+	spin_lock_irq(&base->lock);
+	while (time_after_eq(jiffies, base->timer_jiffies)) {
+		levels = collect_expired_timers(base, heads);
+		++base->timer_jiffies;
+		while (levels--)
+			expire_timers(base, heads + levels);
 	}
 	set_running_timer(base, NULL);
+	start = sched_clock() - start;
+	if (start > base->stats.max_run_ns)
+		base->stats.max_run_ns = start;
 	spin_unlock_irq(&base->lock);
 }
 
 #ifdef CONFIG_NO_HZ
+/*
+ * Does the bucket hold a timer that must wake the CPU up?
+ */
+static int bucket_has_timers(struct tvec_base *base, unsigned int idx)
+{
+	struct timer_list *nte;
+
+	list_for_each_entry(nte, base->vectors + idx, entry)
+		if (!tbase_get_deferrable(nte->base))
+			return 1;
+	return 0;
+}
+
+/*
+ * Search the first bucket of the level starting at @offset that holds
+ * non-deferrable timers, from bucket @clk of the level on and wrapping
+ * around.  Return its distance from @clk, or -1 if there is none.
+ */
+static int next_pending_bucket(struct tvec_base *base, unsigned int offset,
+			       unsigned int clk)
+{
+	unsigned int pos, start = offset + clk;
+	unsigned int end = offset + LVL_SIZE;
+
+	for (pos = find_next_bit(base->pending_map, end, start); pos < end;
+	     pos = find_next_bit(base->pending_map, end, pos + 1))
+		if (bucket_has_timers(base, pos))
+			return pos - start;
+
+	for (pos = find_next_bit(base->pending_map, start, offset); pos < start;
+	     pos = find_next_bit(base->pending_map, start, pos + 1))
+		if (bucket_has_timers(base, pos))
+			return pos + LVL_SIZE - start;
+
+	return -1;
+}
+
 /*
  * Find out when the next timer event is due to happen. This
  * is used on S/390 to stop all activity when a CPU is idle.
@@ -1052,72 +1152,31 @@ static inline void __run_timers(struct tvec_base *base)
  */
 static unsigned long __next_timer_interrupt(struct tvec_base *base)
 {
-	unsigned long timer_jiffies = base->timer_jiffies;
-	unsigned long expires = timer_jiffies + NEXT_TIMER_MAX_DELTA;
-	int index, slot, array, found = 0;
-	struct timer_list *nte;
-	struct tvec *varray[4];
-
-	/* Look for timer events in tv1. */
-	index = slot = timer_jiffies & TVR_MASK;
-	do {
-		list_for_each_entry(nte, base->tv1.vec + slot, entry) {
-			if (tbase_get_deferrable(nte->base))
-				continue;
-
-			found = 1;
-			expires = nte->expires;
-			/* Look at the cascade bucket(s)? */
-			if (!index || slot < index)
-				goto cascade;
-			return expires;
-		}
-		slot = (slot + 1) & TVR_MASK;
-	} while (slot != index);
-
-cascade:
-	/* Calculate the next cascade event */
-	if (index)
-		timer_jiffies += TVR_SIZE - index;
-	timer_jiffies >>= TVR_BITS;
-
-	/* Check tv2-tv5. */
-	varray[0] = &base->tv2;
-	varray[1] = &base->tv3;
-	varray[2] = &base->tv4;
-	varray[3] = &base->tv5;
-
-	for (array = 0; array < 4; array++) {
-		struct tvec *varp = varray[array];
-
-		index = slot = timer_jiffies & TVN_MASK;
-		do {
-			list_for_each_entry(nte, varp->vec + slot, entry) {
-				if (tbase_get_deferrable(nte->base))
-					continue;
-
-				found = 1;
-				if (time_before(nte->expires, expires))
-					expires = nte->expires;
-			}
-			/*
-			 * Do we still search for the first timer or are
-			 * we looking up the cascade buckets ?
-			 */
-			if (found) {
-				/* Look at the cascade bucket(s)? */
-				if (!index || slot < index)
-					break;
-				return expires;
-			}
-			slot = (slot + 1) & TVN_MASK;
-		} while (slot != index);
+	unsigned long clk, next, adj;
+	unsigned int lvl, offset = 0;
+
+	next = base->timer_jiffies + NEXT_TIMER_MAX_DELTA;
+	clk = base->timer_jiffies;
+	for (lvl = 0; lvl < LVL_DEPTH; lvl++, offset += LVL_SIZE) {
+		int pos = next_pending_bucket(base, offset, clk & LVL_MASK);
 
-		if (index)
-			timer_jiffies += TVN_SIZE - index;
-		timer_jiffies >>= TVN_BITS;
+		if (pos >= 0) {
+			unsigned long tmp = clk + (unsigned long) pos;
+
+			tmp <<= LVL_SHIFT(lvl);
+			if (time_before(tmp, next))
+				next = tmp;
+		}
+		/*
+		 * The clock of the next level is the first bucket of that
+		 * level still to come: round up if this level is not on a
+		 * multiple of LVL_CLK_DIV.
+		 */
+		adj = clk & LVL_CLK_MASK ? 1 : 0;
+		clk >>= LVL_CLK_SHIFT;
+		clk += adj;
 	}
-	return expires;
+	return next;
 }
 
 /*
@@ -1192,6 +1251,21 @@ unsigned long get_next_timer_interrupt(unsigned long now)
 }
 #endif
 
+/**
+ * timer_wheel_get_stats - read the timer wheel statistics of a CPU
+ * @cpu: the CPU
+ * @stats: where to store them
+ */
+void timer_wheel_get_stats(int cpu, struct timer_wheel_stats *stats)
+{
+	struct tvec_base *base = per_cpu(tvec_bases, cpu);
+	unsigned long flags;
+
+	spin_lock_irqsave(&base->lock, flags);
+	*stats = base->stats;
+	spin_unlock_irqrestore(&base->lock, flags);
+}
+
 /*
  * Called from the timer interrupt handler to charge one tick to the current
  * process.  user_tick is 1 if the tick is user time, 0 for system.
@@ -1554,20 +1628,16 @@ static int __cpuinit init_timers_cpu(int cpu)
 			base = &boot_tvec_bases;
 		}
 		spin_lock_init(&base->lock);
+		base->cpu = cpu;
 		tvec_base_done[cpu] = 1;
 	} else {
 		base = per_cpu(tvec_bases, cpu);
 	}
 
 
-	for (j = 0; j < TVN_SIZE; j++) {
-		INIT_LIST_HEAD(base->tv5.vec + j);
-		INIT_LIST_HEAD(base->tv4.vec + j);
-		INIT_LIST_HEAD(base->tv3.vec + j);
-		INIT_LIST_HEAD(base->tv2.vec + j);
-	}
-	for (j = 0; j < TVR_SIZE; j++)
-		INIT_LIST_HEAD(base->tv1.vec + j);
+	for (j = 0; j < WHEEL_SIZE; j++)
+		INIT_LIST_HEAD(base->vectors + j);
+	bitmap_zero(base->pending_map, WHEEL_SIZE);
 
 	base->timer_jiffies = jiffies;
 	base->next_timer = base->timer_jiffies;
@@ -1575,17 +1645,16 @@ static int __cpuinit init_timers_cpu(int cpu)
 }
 
 #ifdef CONFIG_HOTPLUG_CPU
-static void migrate_timer_list(struct tvec_base *new_base, struct list_head *head)
+static void migrate_timer_list(struct tvec_base *old_base,
+			       struct tvec_base *new_base,
+			       struct list_head *head)
 {
 	struct timer_list *timer;
 
 	while (!list_empty(head)) {
 		timer = list_first_entry(head, struct timer_list, entry);
-		detach_timer(timer, 0);
+		detach_timer(old_base, timer, 0);
 		timer_set_base(timer, new_base);
-		if (time_before(timer->expires, new_base->next_timer) &&
-		    !tbase_get_deferrable(timer->base))
-			new_base->next_timer = timer->expires;
 		internal_add_timer(new_base, timer);
 	}
 }
@@ -1608,14 +1677,8 @@ static void __cpuinit migrate_timers(int cpu)
 
 	BUG_ON(old_base->running_timer);
 
-	for (i = 0; i < TVR_SIZE; i++)
-		migrate_timer_list(new_base, old_base->tv1.vec + i);
-	for (i = 0; i < TVN_SIZE; i++) {
-		migrate_timer_list(new_base, old_base->tv2.vec + i);
-		migrate_timer_list(new_base, old_base->tv3.vec + i);
-		migrate_timer_list(new_base, old_base->tv4.vec + i);
-		migrate_timer_list(new_base, old_base->tv5.vec + i);
-	}
+	for (i = 0; i < WHEEL_SIZE; i++)
+		migrate_timer_list(old_base, new_base, old_base->vectors + i);
 
 	spin_unlock(&old_base->lock);
 	spin_unlock_irq(&new_base->lock);
@@ -86,6 +86,8 @@
 #include <linux/proc_fs.h>
 #include <linux/migrate.h>
 #include <linux/rmap.h>
+#include <linux/ksm.h>
+#include <linux/mmu_notifier.h>
 #include <linux/security.h>
 #include <linux/syscalls.h>
 #include <linux/ctype.h>
@@ -99,6 +101,7 @@
 #define MPOL_MF_DISCONTIG_OK (MPOL_MF_INTERNAL << 0)	/* Skip checks for continuous vmas */
 #define MPOL_MF_INVERT (MPOL_MF_INTERNAL << 1)		/* Invert check for nodemask */
 #define MPOL_MF_STATS (MPOL_MF_INTERNAL << 2)		/* Gather statistics */
+#define MPOL_MF_NUMA_SAMPLE (MPOL_MF_INTERNAL << 3)	/* Sample page accesses */
 
 static struct kmem_cache *policy_cache;
 static struct kmem_cache *sn_cache;
@@ -390,6 +393,10 @@ static const struct mempolicy_operations mpol_ops[MPOL_MAX] = {
 static void gather_stats(struct page *, void *, int pte_dirty);
 static void migrate_page_add(struct page *page, struct list_head *pagelist,
 				unsigned long flags);
+#ifdef CONFIG_NUMA_BALANCING
+static void numa_sample_page(struct vm_area_struct *vma, unsigned long addr,
+			     pte_t *pte, struct page *page, void *private);
+#endif
 
 /* Scan through pages checking if pages follow certain conditions. */
 static int check_pte_range(struct vm_area_struct *vma, pmd_t *pmd,
@@ -424,6 +431,12 @@ static int check_pte_range(struct vm_area_struct *vma, pmd_t *pmd,
 		 */
 		if (PageReserved(page))
 			continue;
+#ifdef CONFIG_NUMA_BALANCING
+		if (flags & MPOL_MF_NUMA_SAMPLE) {
+			numa_sample_page(vma, addr, pte, page, private);
+			continue;
+		}
+#endif
 		nid = page_to_nid(page);
 		if (node_isset(nid, *nodes) == !!(flags & MPOL_MF_INVERT))
 			continue;
@@ -955,6 +968,110 @@ static struct page *new_vma_page(struct page *page, unsigned long private, int *
 	 */
 	return alloc_page_vma(GFP_HIGHUSER_MOVABLE, vma, address);
 }
+
+#ifdef CONFIG_NUMA_BALANCING
+struct numa_sample {
+	unsigned long *faults;
+	int target_nid;
+	struct list_head pagelist;
+};
+
+/*
+ * A page accessed since the previous pass counts for the node it is on.
+ * Those of a private anonymous page away from the target node are
+ * queued for migration.
+ */
+static void numa_sample_page(struct vm_area_struct *vma, unsigned long addr,
+			     pte_t *pte, struct page *page, void *private)
+{
+	struct numa_sample *ns = private;
+	int nid = page_to_nid(page);
+	int young;
+
+	/*
+	 * The CPU TLBs are flushed once per range by mpol_numa_sample(),
+	 * secondary MMUs are told right away.
+	 */
+	young = ptep_test_and_clear_young(vma, addr, pte);
+	young |= mmu_notifier_clear_flush_young(vma->vm_mm, addr);
+	if (!young)
+		return;
+	/* keep the access visible to page_referenced() for reclaim */
+	SetPageReferenced(page);
+	ns->faults[nid]++;
+
+	if (ns->target_nid < 0 || nid == ns->target_nid)
+		return;
+	if (PageAnon(page) && !PageKsm(page))
+		migrate_page_add(page, &ns->pagelist, 0);
+}
+
+/**
+ * mpol_numa_sample - sample the page accesses of an address space
+ * @mm: the address space, with mmap_sem held for reading
+ * @offset: where to start, updated to where the next pass starts
+ * @pages: size of the range to sample, in pages
+ * @faults: per-node counts of the pages accessed, incremented
+ * @target_nid: node to migrate the hot private pages to, or -1
+ *
+ * The accessed bit of the sampled ptes is cleared, so that each pass
+ * only sees the pages accessed since the previous one; it is moved to
+ * the page's referenced flag for reclaim.  Returns the number of pages
+ * migrated to @target_nid.
+ */
+unsigned long mpol_numa_sample(struct mm_struct *mm, unsigned long *offset,
+			       unsigned long pages, unsigned long *faults,
+			       int target_nid)
+{
+	struct numa_sample ns = {
+		.faults		= faults,
+		.target_nid	= target_nid,
+	};
+	unsigned long start = *offset, end, left = pages << PAGE_SHIFT;
+	struct vm_area_struct *vma;
+	struct page *page;
+	int nr_pages = 0, nr_failed;
+
+	INIT_LIST_HEAD(&ns.pagelist);
+
+	vma = find_vma(mm, start);
+	if (!vma) {
+		start = 0;
+		vma = mm->mmap;
+	}
+	for (; vma && left; vma = vma->vm_next) {
+		if (!vma_migratable(vma))
+			continue;
+
+		start = max(start, vma->vm_start);
+		end = vma->vm_end;
+		if (end - start > left)
+			end = start + left;
+
+		check_pgd_range(vma, start, end, &node_states[N_HIGH_MEMORY],
+				MPOL_MF_NUMA_SAMPLE, &ns);
+		/* Let the CPUs set the accessed bits again */
+		flush_tlb_range(vma, start, end);
+
+		left -= end - start;
+		start = end;
+		if (start < vma->vm_end)
+			break;
+	}
+	*offset = vma ? start : 0;
+
+	if (list_empty(&ns.pagelist))
+		return 0;
+
+	list_for_each_entry(page, &ns.pagelist, lru)
+		nr_pages++;
+	nr_failed = migrate_pages(&ns.pagelist, new_node_page, target_nid);
+	if (nr_failed < 0)
+		return 0;
+	return nr_pages - nr_failed;
+}
+#endif
+
 #else
 
 static void migrate_page_add(struct page *page, struct list_head *pagelist,
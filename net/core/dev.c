@@ -1797,7 +1797,7 @@ gso:
 			return rc;
 		}
 		txq_trans_update(txq);
-		if (unlikely(netif_tx_queue_stopped(txq) && skb->next))
+		if (unlikely(netif_xmit_stopped(txq) && skb->next))
 			return NETDEV_TX_BUSY;
 	} while (skb->next);
 
@@ -1832,16 +1832,146 @@ u16 skb_tx_hash(const struct net_device *dev, const struct sk_buff *skb)
 }
 EXPORT_SYMBOL(skb_tx_hash);
 
+#ifdef CONFIG_XPS
+static DEFINE_MUTEX(xps_map_mutex);
+
+static void xps_free_maps(struct xps_dev_maps *dev_maps)
+{
+	int cpu;
+
+	if (!dev_maps)
+		return;
+	for_each_possible_cpu(cpu)
+		kfree(dev_maps->cpu_map[cpu]);
+	kfree(dev_maps);
+}
+
+/**
+ *	netif_set_xps_queue - set the CPUs that transmit on a TX queue
+ *	@dev: network device
+ *	@mask: CPUs whose packets go to @index
+ *	@index: TX queue
+ *
+ *	The per-CPU maps are rebuilt from the current ones with @index
+ *	added for the CPUs in @mask and removed for all others.  A CPU
+ *	mapped to several queues spreads its flows over them by hash.
+ *	Must be called from process context.
+ */
+int netif_set_xps_queue(struct net_device *dev, const struct cpumask *mask,
+			u16 index)
+{
+	struct xps_dev_maps *dev_maps, *new_dev_maps;
+	struct xps_map *map, *new_map;
+	bool empty = true;
+	int cpu, i, len;
+
+	if (index >= dev->num_tx_queues)
+		return -EINVAL;
+
+	new_dev_maps = kzalloc(XPS_DEV_MAPS_SIZE, GFP_KERNEL);
+	if (!new_dev_maps)
+		return -ENOMEM;
+
+	mutex_lock(&xps_map_mutex);
+	dev_maps = dev->xps_maps;
+
+	for_each_possible_cpu(cpu) {
+		map = dev_maps ? dev_maps->cpu_map[cpu] : NULL;
+		len = map ? map->len : 0;
+
+		new_map = kzalloc_node(XPS_MAP_SIZE(len + 1), GFP_KERNEL,
+				       cpu_to_node(cpu));
+		if (!new_map) {
+			mutex_unlock(&xps_map_mutex);
+			xps_free_maps(new_dev_maps);
+			return -ENOMEM;
+		}
+
+		for (i = 0; i < len; i++)
+			if (map->queues[i] != index)
+				new_map->queues[new_map->len++] = map->queues[i];
+		if (cpumask_test_cpu(cpu, mask))
+			new_map->queues[new_map->len++] = index;
+
+		if (!new_map->len) {
+			kfree(new_map);
+			continue;
+		}
+		new_dev_maps->cpu_map[cpu] = new_map;
+		empty = false;
+	}
+
+	if (empty) {
+		kfree(new_dev_maps);
+		new_dev_maps = NULL;
+	}
+	rcu_assign_pointer(dev->xps_maps, new_dev_maps);
+	mutex_unlock(&xps_map_mutex);
+
+	synchronize_net();
+	xps_free_maps(dev_maps);
+
+	return 0;
+}
+EXPORT_SYMBOL(netif_set_xps_queue);
+#endif /* CONFIG_XPS */
+
+/*
+ * Pick the TX queue configured for the sending CPU, -1 if there is none.
+ */
+static inline int get_xps_queue(struct net_device *dev, struct sk_buff *skb)
+{
+#ifdef CONFIG_XPS
+	struct xps_dev_maps *dev_maps;
+	struct xps_map *map;
+	int queue_index = -1;
+
+	rcu_read_lock();
+	dev_maps = rcu_dereference(dev->xps_maps);
+	if (dev_maps) {
+		map = dev_maps->cpu_map[raw_smp_processor_id()];
+		if (map) {
+			if (map->len == 1) {
+				queue_index = map->queues[0];
+			} else {
+				u32 hash;
+
+				if (skb->sk && skb->sk->sk_hash)
+					hash = skb->sk->sk_hash;
+				else
+					hash = skb->protocol;
+				hash = jhash_1word(hash, skb_tx_hashrnd);
+				queue_index = map->queues[
+				    ((u64)hash * map->len) >> 32];
+			}
+			if (unlikely(queue_index >= dev->real_num_tx_queues))
+				queue_index = -1;
+		}
+	}
+	rcu_read_unlock();
+
+	return queue_index;
+#else
+	return -1;
+#endif
+}
+
 static struct netdev_queue *dev_pick_tx(struct net_device *dev,
 					struct sk_buff *skb)
 {
 	const struct net_device_ops *ops = dev->netdev_ops;
 	u16 queue_index = 0;
 
-	if (ops->ndo_select_queue)
+	if (ops->ndo_select_queue) {
 		queue_index = ops->ndo_select_queue(dev, skb);
-	else if (dev->real_num_tx_queues > 1)
-		queue_index = skb_tx_hash(dev, skb);
+	} else if (dev->real_num_tx_queues > 1) {
+		int xps_index = get_xps_queue(dev, skb);
+
+		if (xps_index >= 0)
+			queue_index = xps_index;
+		else
+			queue_index = skb_tx_hash(dev, skb);
+	}
 
 	skb_set_queue_mapping(skb, queue_index);
 	return netdev_get_tx_queue(dev, queue_index);
@@ -1852,31 +1982,72 @@ static inline int __dev_xmit_skb(struct sk_buff *skb, struct Qdisc *q,
 				 struct netdev_queue *txq)
 {
 	spinlock_t *root_lock = qdisc_lock(q);
-	int rc;
+	bool contended = test_bit(__QDISC_STATE_RUNNING, &q->state);
+	int rc = NET_XMIT_SUCCESS;
+
+	/*
+	 * Another CPU owns the dequeue side: work-conserving qdiscs take
+	 * the skb without the root lock, the owner picks it up before its
+	 * next dequeue.
+	 */
+	if (contended && (q->flags & TCQ_F_DEFER)) {
+		if (qdisc_defer_skb(skb, q))
+			return NET_XMIT_SUCCESS;
+		/* The owner has left, our skb is on the defer list */
+		skb = NULL;
+		contended = false;
+	}
+
+	/*
+	 * Heuristic to force contended enqueues to serialize on a
+	 * separate lock before trying to get the qdisc main lock.
+	 * This lets the qdisc owner get the lock more often and
+	 * dequeue packets faster.
+	 */
+	if (unlikely(contended))
+		spin_lock(&q->busylock);
 
 	spin_lock(root_lock);
 	if (unlikely(test_bit(__QDISC_STATE_DEACTIVATED, &q->state))) {
-		kfree_skb(skb);
-		rc = NET_XMIT_DROP;
-	} else if ((q->flags & TCQ_F_CAN_BYPASS) && !qdisc_qlen(q) &&
-		   !test_and_set_bit(__QDISC_STATE_RUNNING, &q->state)) {
-		/*
-		 * This is a work-conserving queue; there are no old skbs
-		 * waiting to be sent out; and the qdisc is not running -
-		 * xmit the skb directly.
-		 */
-		__qdisc_update_bstats(q, skb->len);
-		if (sch_direct_xmit(skb, q, dev, txq, root_lock))
-			__qdisc_run(q);
-		else
-			clear_bit(__QDISC_STATE_RUNNING, &q->state);
-
-		rc = NET_XMIT_SUCCESS;
+		if (skb) {
+			kfree_skb(skb);
+			rc = NET_XMIT_DROP;
+		}
 	} else {
-		rc = qdisc_enqueue_root(skb, q);
-		qdisc_run(q);
+		qdisc_splice_deferred(q);
+
+		if (!skb) {
+			qdisc_run(q);
+		} else if ((q->flags & TCQ_F_CAN_BYPASS) && !qdisc_qlen(q) &&
+			   !test_and_set_bit(__QDISC_STATE_RUNNING, &q->state)) {
+			/*
+			 * This is a work-conserving queue; there are no old skbs
+			 * waiting to be sent out; and the qdisc is not running -
+			 * xmit the skb directly.
+			 */
+			if (unlikely(contended)) {
+				spin_unlock(&q->busylock);
+				contended = false;
+			}
+			__qdisc_update_bstats(q, skb->len);
+			if (sch_direct_xmit(skb, q, dev, txq, root_lock))
+				__qdisc_run(q);
+			else
+				qdisc_run_end(q);
+		} else {
+			rc = qdisc_enqueue_root(skb, q);
+			if (!test_and_set_bit(__QDISC_STATE_RUNNING, &q->state)) {
+				if (unlikely(contended)) {
+					spin_unlock(&q->busylock);
+					contended = false;
+				}
+				__qdisc_run(q);
+			}
+		}
 	}
 	spin_unlock(root_lock);
+	if (unlikely(contended))
+		spin_unlock(&q->busylock);
 
 	return rc;
 }
@@ -1977,7 +2148,7 @@ gso:
 
 			HARD_TX_LOCK(dev, txq, cpu);
 
-			if (!netif_tx_queue_stopped(txq)) {
+			if (!netif_xmit_stopped(txq)) {
 				rc = NET_XMIT_SUCCESS;
 				if (!dev_hard_start_xmit(skb, dev, txq)) {
 					HARD_TX_UNLOCK(dev, txq);
@@ -2450,6 +2621,39 @@ static void flush_backlog(void *arg)
 		}
 }
 
+/*
+ * Look up the GRO handlers of an encapsulated protocol, for tunnels
+ * that merge packets below their own header.  Caller holds
+ * rcu_read_lock().
+ */
+struct packet_type *gro_find_receive_by_type(__be16 type)
+{
+	struct list_head *head = &ptype_base[ntohs(type) & PTYPE_HASH_MASK];
+	struct packet_type *ptype;
+
+	list_for_each_entry_rcu(ptype, head, list) {
+		if (ptype->type != type || ptype->dev || !ptype->gro_receive)
+			continue;
+		return ptype;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL(gro_find_receive_by_type);
+
+struct packet_type *gro_find_complete_by_type(__be16 type)
+{
+	struct list_head *head = &ptype_base[ntohs(type) & PTYPE_HASH_MASK];
+	struct packet_type *ptype;
+
+	list_for_each_entry_rcu(ptype, head, list) {
+		if (ptype->type != type || ptype->dev || !ptype->gro_complete)
+			continue;
+		return ptype;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL(gro_find_complete_by_type);
+
 static int napi_gro_complete(struct sk_buff *skb)
 {
 	struct packet_type *ptype;
@@ -2497,6 +2701,28 @@ void napi_gro_flush(struct napi_struct *napi)
 }
 EXPORT_SYMBOL(napi_gro_flush);
 
+/* Move @grow bytes at frag0 to the linear part of the skb. */
+static void gro_pull_from_frag0(struct sk_buff *skb, int grow)
+{
+	struct skb_shared_info *pinfo = skb_shinfo(skb);
+
+	BUG_ON(skb->end - skb->tail < grow);
+
+	memcpy(skb_tail_pointer(skb), NAPI_GRO_CB(skb)->frag0, grow);
+
+	skb->tail += grow;
+	skb->data_len -= grow;
+
+	pinfo->frags[0].page_offset += grow;
+	pinfo->frags[0].size -= grow;
+
+	if (unlikely(!pinfo->frags[0].size)) {
+		put_page(pinfo->frags[0].page);
+		memmove(pinfo->frags, pinfo->frags + 1,
+			--pinfo->nr_frags * sizeof(skb_frag_t));
+	}
+}
+
 int dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
 	struct sk_buff **pp = NULL;
@@ -2524,6 +2750,7 @@ int dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 		NAPI_GRO_CB(skb)->same_flow = 0;
 		NAPI_GRO_CB(skb)->flush = 0;
 		NAPI_GRO_CB(skb)->free = 0;
+		NAPI_GRO_CB(skb)->encap_mark = 0;
 
 		pp = ptype->gro_receive(&napi->gro_list, skb);
 		break;
@@ -2559,26 +2786,9 @@ int dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 	ret = GRO_HELD;
 
 pull:
-	if (skb_headlen(skb) < skb_gro_offset(skb)) {
-		int grow = skb_gro_offset(skb) - skb_headlen(skb);
-
-		BUG_ON(skb->end - skb->tail < grow);
-
-		memcpy(skb_tail_pointer(skb), NAPI_GRO_CB(skb)->frag0, grow);
-
-		skb->tail += grow;
-		skb->data_len -= grow;
-
-		skb_shinfo(skb)->frags[0].page_offset += grow;
-		skb_shinfo(skb)->frags[0].size -= grow;
-
-		if (unlikely(!skb_shinfo(skb)->frags[0].size)) {
-			put_page(skb_shinfo(skb)->frags[0].page);
-			memmove(skb_shinfo(skb)->frags,
-				skb_shinfo(skb)->frags + 1,
-				--skb_shinfo(skb)->nr_frags * sizeof(skb_frag_t));
-		}
-	}
+	if (skb_headlen(skb) < skb_gro_offset(skb))
+		gro_pull_from_frag0(skb,
+				    skb_gro_offset(skb) - skb_headlen(skb));
 
 ok:
 	return ret;
@@ -2599,7 +2809,7 @@ static int __napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 	for (p = napi->gro_list; p; p = p->next) {
 		NAPI_GRO_CB(p)->same_flow = (p->dev == skb->dev)
 			&& !compare_ether_header(skb_mac_header(p),
-						 skb_gro_mac_header(skb));
+						 skb_mac_header(skb));
 		NAPI_GRO_CB(p)->flush = 0;
 	}
 
@@ -2689,14 +2899,7 @@ int napi_frags_finish(struct napi_struct *napi, struct sk_buff *skb, int ret)
 
 	switch (ret) {
 	case GRO_NORMAL:
-	case GRO_HELD:
-		skb->protocol = eth_type_trans(skb, skb->dev);
-
-		if (ret == GRO_NORMAL)
-			return netif_receive_skb(skb);
-
-		skb_gro_pull(skb, -ETH_HLEN);
-		break;
+		return netif_receive_skb(skb);
 
 	case GRO_DROP:
 		err = NET_RX_DROP;
@@ -2715,36 +2918,41 @@ struct sk_buff *napi_frags_skb(struct napi_struct *napi)
 {
 	struct sk_buff *skb = napi->skb;
 	struct ethhdr *eth;
-	unsigned int hlen;
-	unsigned int off;
+	unsigned int hlen = sizeof(*eth);
 
 	napi->skb = NULL;
 
 	skb_reset_mac_header(skb);
 	skb_gro_reset_offset(skb);
 
-	off = skb_gro_offset(skb);
-	hlen = off + sizeof(*eth);
-	eth = skb_gro_header_fast(skb, off);
+	eth = skb_gro_header_fast(skb, 0);
 	if (skb_gro_header_hard(skb, hlen)) {
-		eth = skb_gro_header_slow(skb, hlen, off);
-		if (unlikely(!eth)) {
-			napi_reuse_skb(napi, skb);
-			skb = NULL;
-			goto out;
-		}
+		eth = skb_gro_header_slow(skb, hlen, 0);
+		if (unlikely(!eth))
+			goto drop;
+	} else {
+		gro_pull_from_frag0(skb, hlen);
+		NAPI_GRO_CB(skb)->frag0 += hlen;
+		NAPI_GRO_CB(skb)->frag0_len -= hlen;
+		eth = (struct ethhdr *)skb->data;
 	}
 
-	skb_gro_pull(skb, sizeof(*eth));
+	/* eth_type_trans() peeks at the 802.2 header of 802.3 frames */
+	if (unlikely(ntohs(eth->h_proto) < 1536) &&
+	    !skb_gro_header_slow(skb, hlen + 2, 0))
+		goto drop;
 
 	/*
-	 * This works because the only protocols we care about don't require
-	 * special handling.  We'll fix it up properly at the end.
+	 * Classify the frame before GRO, as drivers do for
+	 * napi_gro_receive(): the GRO offsets then start at the network
+	 * header and pkt_type is valid on both paths.
 	 */
-	skb->protocol = eth->h_proto;
-
-out:
+	skb->protocol = eth_type_trans(skb, skb->dev);
 	return skb;
+
+drop:
+	napi_reuse_skb(napi, skb);
+	return NULL;
 }
 EXPORT_SYMBOL(napi_frags_skb);
 
@@ -5186,6 +5394,9 @@ static void netdev_init_one_queue(struct net_device *dev,
 				  void *_unused)
 {
 	queue->dev = dev;
+#ifdef CONFIG_BQL
+	dql_init(&queue->dql, HZ);
+#endif
 }
 
 static void netdev_init_queues(struct net_device *dev)
@@ -5289,6 +5500,9 @@ void free_netdev(struct net_device *dev)
 
 	release_net(dev_net(dev));
 
+#ifdef CONFIG_XPS
+	xps_free_maps(dev->xps_maps);
+#endif
 	kfree(dev->_tx);
 
 	/* Flush device addresses */
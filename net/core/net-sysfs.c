@@ -448,6 +448,319 @@ exit:
 }
 #endif
 
+#ifdef CONFIG_SYSFS
+/*
+ * netdev_queue sysfs structures and functions: queues/tx-N
+ */
+struct netdev_queue_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct netdev_queue *queue,
+			struct netdev_queue_attribute *attr, char *buf);
+	ssize_t (*store)(struct netdev_queue *queue,
+			 struct netdev_queue_attribute *attr,
+			 const char *buf, size_t len);
+};
+#define to_netdev_queue_attr(_attr) container_of(_attr,		\
+	struct netdev_queue_attribute, attr)
+
+#define to_netdev_queue(obj) container_of(obj, struct netdev_queue, kobj)
+
+static ssize_t netdev_queue_attr_show(struct kobject *kobj,
+				      struct attribute *attr, char *buf)
+{
+	struct netdev_queue_attribute *attribute = to_netdev_queue_attr(attr);
+	struct netdev_queue *queue = to_netdev_queue(kobj);
+
+	if (!attribute->show)
+		return -EIO;
+
+	return attribute->show(queue, attribute, buf);
+}
+
+static ssize_t netdev_queue_attr_store(struct kobject *kobj,
+				       struct attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct netdev_queue_attribute *attribute = to_netdev_queue_attr(attr);
+	struct netdev_queue *queue = to_netdev_queue(kobj);
+
+	if (!attribute->store)
+		return -EIO;
+
+	return attribute->store(queue, attribute, buf, count);
+}
+
+static struct sysfs_ops netdev_queue_sysfs_ops = {
+	.show = netdev_queue_attr_show,
+	.store = netdev_queue_attr_store,
+};
+
+#ifdef CONFIG_XPS
+static unsigned int get_netdev_queue_index(struct netdev_queue *queue)
+{
+	return queue - queue->dev->_tx;
+}
+
+static ssize_t show_xps_map(struct netdev_queue *queue,
+			    struct netdev_queue_attribute *attribute,
+			    char *buf)
+{
+	struct net_device *dev = queue->dev;
+	unsigned int index = get_netdev_queue_index(queue);
+	struct xps_dev_maps *dev_maps;
+	cpumask_var_t mask;
+	size_t len;
+	int cpu, i;
+
+	if (!zalloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	rcu_read_lock();
+	dev_maps = rcu_dereference(dev->xps_maps);
+	if (dev_maps) {
+		for_each_possible_cpu(cpu) {
+			struct xps_map *map = dev_maps->cpu_map[cpu];
+
+			if (!map)
+				continue;
+			for (i = map->len; i--;) {
+				if (map->queues[i] == index) {
+					cpumask_set_cpu(cpu, mask);
+					break;
+				}
+			}
+		}
+	}
+	rcu_read_unlock();
+
+	len = cpumask_scnprintf(buf, PAGE_SIZE, mask);
+	free_cpumask_var(mask);
+	if (PAGE_SIZE - len < 2)
+		return -EINVAL;
+	len += sprintf(buf + len, "\n");
+
+	return len;
+}
+
+static ssize_t store_xps_map(struct netdev_queue *queue,
+			     struct netdev_queue_attribute *attribute,
+			     const char *buf, size_t len)
+{
+	struct net_device *dev = queue->dev;
+	cpumask_var_t mask;
+	int err;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
+	if (!err)
+		err = netif_set_xps_queue(dev, mask,
+					  get_netdev_queue_index(queue));
+
+	free_cpumask_var(mask);
+
+	return err ? : len;
+}
+
+static struct netdev_queue_attribute xps_cpus_attribute =
+	__ATTR(xps_cpus, S_IRUGO | S_IWUSR, show_xps_map, store_xps_map);
+#endif /* CONFIG_XPS */
+
+static struct attribute *netdev_queue_default_attrs[] = {
+#ifdef CONFIG_XPS
+	&xps_cpus_attribute.attr,
+#endif
+	NULL
+};
+
+#ifdef CONFIG_BQL
+static ssize_t bql_show(char *buf, unsigned int value)
+{
+	return sprintf(buf, "%u\n", value);
+}
+
+static ssize_t bql_set(const char *buf, const size_t count,
+		       unsigned int *pvalue)
+{
+	unsigned long value;
+
+	if (!strcmp(buf, "max") || !strcmp(buf, "max\n"))
+		value = DQL_MAX_LIMIT;
+	else if (strict_strtoul(buf, 10, &value) || value > DQL_MAX_LIMIT)
+		return -EINVAL;
+
+	*pvalue = value;
+
+	return count;
+}
+
+static ssize_t bql_show_hold_time(struct netdev_queue *queue,
+				  struct netdev_queue_attribute *attr,
+				  char *buf)
+{
+	struct dql *dql = &queue->dql;
+
+	return sprintf(buf, "%u\n", jiffies_to_msecs(dql->slack_hold_time));
+}
+
+static ssize_t bql_set_hold_time(struct netdev_queue *queue,
+				 struct netdev_queue_attribute *attribute,
+				 const char *buf, size_t len)
+{
+	struct dql *dql = &queue->dql;
+	unsigned long value;
+
+	if (strict_strtoul(buf, 10, &value) || value > UINT_MAX)
+		return -EINVAL;
+
+	dql->slack_hold_time = msecs_to_jiffies(value);
+
+	return len;
+}
+
+static struct netdev_queue_attribute bql_hold_time_attribute =
+	__ATTR(hold_time, S_IRUGO | S_IWUSR, bql_show_hold_time,
+	       bql_set_hold_time);
+
+static ssize_t bql_show_inflight(struct netdev_queue *queue,
+				 struct netdev_queue_attribute *attr,
+				 char *buf)
+{
+	struct dql *dql = &queue->dql;
+
+	return sprintf(buf, "%u\n", dql->num_queued - dql->num_completed);
+}
+
+static struct netdev_queue_attribute bql_inflight_attribute =
+	__ATTR(inflight, S_IRUGO, bql_show_inflight, NULL);
+
+#define BQL_ATTR(NAME, FIELD)						\
+static ssize_t bql_show_ ## NAME(struct netdev_queue *queue,		\
+				 struct netdev_queue_attribute *attr,	\
+				 char *buf)				\
+{									\
+	return bql_show(buf, queue->dql.FIELD);				\
+}									\
+									\
+static ssize_t bql_set_ ## NAME(struct netdev_queue *queue,		\
+				struct netdev_queue_attribute *attr,	\
+				const char *buf, size_t len)		\
+{									\
+	return bql_set(buf, len, &queue->dql.FIELD);			\
+}									\
+									\
+static struct netdev_queue_attribute bql_ ## NAME ## _attribute =	\
+	__ATTR(NAME, S_IRUGO | S_IWUSR, bql_show_ ## NAME,		\
+	       bql_set_ ## NAME);
+
+BQL_ATTR(limit, limit)
+BQL_ATTR(limit_max, max_limit)
+BQL_ATTR(limit_min, min_limit)
+
+static struct attribute *dql_attrs[] = {
+	&bql_limit_attribute.attr,
+	&bql_limit_max_attribute.attr,
+	&bql_limit_min_attribute.attr,
+	&bql_hold_time_attribute.attr,
+	&bql_inflight_attribute.attr,
+	NULL
+};
+
+static struct attribute_group dql_group = {
+	.name  = "byte_queue_limits",
+	.attrs  = dql_attrs,
+};
+#endif /* CONFIG_BQL */
+
+static void netdev_queue_release(struct kobject *kobj)
+{
+	struct netdev_queue *queue = to_netdev_queue(kobj);
+
+	dev_put(queue->dev);
+}
+
+static struct kobj_type netdev_queue_ktype = {
+	.sysfs_ops = &netdev_queue_sysfs_ops,
+	.release = netdev_queue_release,
+	.default_attrs = netdev_queue_default_attrs,
+};
+
+static int netdev_queue_add_kobject(struct net_device *net, int index)
+{
+	struct netdev_queue *queue = netdev_get_tx_queue(net, index);
+	struct kobject *kobj = &queue->kobj;
+	int error;
+
+	/* Released by netdev_queue_release() */
+	dev_hold(queue->dev);
+
+	/* The kobject is reused when the device comes back to init_net */
+	memset(kobj, 0, sizeof(*kobj));
+	kobj->kset = net->queues_kset;
+	error = kobject_init_and_add(kobj, &netdev_queue_ktype, NULL,
+				     "tx-%u", index);
+	if (error)
+		goto exit;
+
+#ifdef CONFIG_BQL
+	error = sysfs_create_group(kobj, &dql_group);
+	if (error)
+		goto exit;
+#endif
+
+	kobject_uevent(kobj, KOBJ_ADD);
+	return 0;
+
+exit:
+	kobject_put(kobj);
+	return error;
+}
+
+static void netdev_queue_remove_kobjects(struct net_device *net, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		struct netdev_queue *queue = netdev_get_tx_queue(net, i);
+
+#ifdef CONFIG_BQL
+		sysfs_remove_group(&queue->kobj, &dql_group);
+#endif
+		kobject_put(&queue->kobj);
+	}
+}
+
+static int register_queue_kobjects(struct net_device *net)
+{
+	int i, error;
+
+	net->queues_kset = kset_create_and_add("queues", NULL,
+					       &net->dev.kobj);
+	if (!net->queues_kset)
+		return -ENOMEM;
+
+	for (i = 0; i < net->num_tx_queues; i++) {
+		error = netdev_queue_add_kobject(net, i);
+		if (error) {
+			netdev_queue_remove_kobjects(net, i);
+			kset_unregister(net->queues_kset);
+			return error;
+		}
+	}
+	return 0;
+}
+
+static void remove_queue_kobjects(struct net_device *net)
+{
+	netdev_queue_remove_kobjects(net, net->num_tx_queues);
+	kset_unregister(net->queues_kset);
+}
+#endif /* CONFIG_SYSFS */
+
 /*
  *	netdev_release -- destroy and free a dead device.
  *	Called when last reference to device kobject is gone.
@@ -485,6 +798,9 @@ void netdev_unregister_kobject(struct net_device * net)
 	if (dev_net(net) != &init_net)
 		return;
 
+#ifdef CONFIG_SYSFS
+	remove_queue_kobjects(net);
+#endif
 	device_del(dev);
 }
 
@@ -495,6 +811,7 @@ int netdev_register_kobject(struct net_device *net)
 {
 	struct device *dev = &(net->dev);
 	const struct attribute_group **groups = net->sysfs_groups;
+	int error;
 
 	dev->class = &net_class;
 	dev->platform_data = net;
@@ -514,7 +831,18 @@ int netdev_register_kobject(struct net_device *net)
 	if (dev_net(net) != &init_net)
 		return 0;
 
-	return device_add(dev);
+	error = device_add(dev);
+	if (error)
+		return error;
+
+#ifdef CONFIG_SYSFS
+	error = register_queue_kobjects(net);
+	if (error) {
+		device_del(dev);
+		return error;
+	}
+#endif
+	return 0;
 }
 
 int netdev_class_create_file(struct class_attribute *class_attr)
@@ -16,6 +16,7 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
+#include <linux/netdevice.h>
 
 #include <net/request_sock.h>
 
@@ -59,6 +60,7 @@ int reqsk_queue_alloc(struct request_sock_queue *queue,
 
 	get_random_bytes(&lopt->hash_rnd, sizeof(lopt->hash_rnd));
 	rwlock_init(&queue->syn_wait_lock);
+	spin_lock_init(&queue->rskq_lock);
 	queue->rskq_accept_head = NULL;
 	lopt->nr_table_entries = nr_table_entries;
 
@@ -109,6 +111,12 @@ void reqsk_queue_destroy(struct request_sock_queue *queue)
 	size_t lopt_size = sizeof(struct listen_sock) +
 		lopt->nr_table_entries * sizeof(struct request_sock *);
 
+	/*
+	 * Nobody can link or unlink requests anymore, but SYN processing
+	 * on other CPUs may still be peeking at the queue lengths.
+	 */
+	synchronize_net();
+
 	if (lopt->qlen != 0) {
 		unsigned int i;
 
@@ -118,7 +126,7 @@ void reqsk_queue_destroy(struct request_sock_queue *queue)
 			while ((req = lopt->syn_table[i]) != NULL) {
 				lopt->syn_table[i] = req->dl_next;
 				lopt->qlen--;
-				reqsk_free(req);
+				reqsk_put(req);
 			}
 		}
 	}
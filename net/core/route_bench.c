@@ -0,0 +1,185 @@
+/*
+ * route_bench.c	Route lookup benchmark.
+ *
+ *		Times output route lookups for random unicast destinations
+ *		against the routing tables of the initial namespace, so a
+ *		full BGP table can be loaded first and measured.  Results
+ *		go to the kernel log, unload the module to run it again:
+ *
+ *		  modprobe route_bench nr_lookups=4000000
+ *		  dmesg | grep route_bench
+ *		  rmmod route_bench
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/in6.h>
+#include <net/net_namespace.h>
+#include <net/route.h>
+#if defined(CONFIG_IPV6) || defined(CONFIG_IPV6_MODULE)
+#include <net/ip6_route.h>
+#endif
+
+static unsigned int nr_lookups = 1000000;
+module_param(nr_lookups, uint, 0);
+MODULE_PARM_DESC(nr_lookups, "Route lookups per family");
+
+static unsigned int nr_addrs = 65536;
+module_param(nr_addrs, uint, 0);
+MODULE_PARM_DESC(nr_addrs, "Number of random destinations cycled through");
+
+static int ipv4 = 1;
+module_param(ipv4, bool, 0);
+MODULE_PARM_DESC(ipv4, "Run the IPv4 test");
+
+static int ipv6 = 1;
+module_param(ipv6, bool, 0);
+MODULE_PARM_DESC(ipv6, "Run the IPv6 test");
+
+static void route_bench_report(const char *family, ktime_t start,
+			       unsigned int unreach)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u64 rate = (u64)nr_lookups * NSEC_PER_SEC;
+	u64 per_lookup = ns;
+
+	if (!ns)
+		ns = 1;
+	do_div(rate, ns);
+	do_div(per_lookup, nr_lookups);
+
+	printk(KERN_INFO "route_bench: %s: %u lookups in %llu ns, "
+	       "%llu ns/lookup, %llu lookups/s, %u unreachable\n",
+	       family, nr_lookups, (unsigned long long)ns,
+	       (unsigned long long)per_lookup, (unsigned long long)rate,
+	       unreach);
+}
+
+static int route_bench_ipv4(void)
+{
+	unsigned int i, unreach = 0;
+	__be32 *addrs;
+	ktime_t start;
+
+	addrs = vmalloc(nr_addrs * sizeof(*addrs));
+	if (!addrs)
+		return -ENOMEM;
+
+	/* 1.0.0.0 - 223.255.255.255 without loopback */
+	for (i = 0; i < nr_addrs; i++) {
+		u32 addr;
+
+		do {
+			addr = 0x01000000 + random32() % 0xdf000000;
+		} while ((addr >> 24) == 127);
+		addrs[i] = htonl(addr);
+	}
+
+	start = ktime_get();
+	for (i = 0; i < nr_lookups; i++) {
+		struct flowi fl = {
+			.nl_u = {
+				.ip4_u = {
+					.daddr = addrs[i % nr_addrs],
+				},
+			},
+		};
+		struct rtable *rt;
+
+		if (ip_route_output_key(&init_net, &rt, &fl))
+			unreach++;
+		else
+			ip_rt_put(rt);
+
+		if (!(i & 4095))
+			cond_resched();
+	}
+	route_bench_report("ipv4", start, unreach);
+
+	vfree(addrs);
+	return 0;
+}
+
+#if defined(CONFIG_IPV6) || defined(CONFIG_IPV6_MODULE)
+static int route_bench_ipv6(void)
+{
+	unsigned int i, unreach = 0;
+	struct in6_addr *addrs;
+	ktime_t start;
+
+	addrs = vmalloc(nr_addrs * sizeof(*addrs));
+	if (!addrs)
+		return -ENOMEM;
+
+	/* global unicast, 2000::/3 */
+	for (i = 0; i < nr_addrs; i++) {
+		get_random_bytes(&addrs[i], sizeof(addrs[i]));
+		addrs[i].s6_addr32[0] = htonl(0x20000000 |
+			(ntohl(addrs[i].s6_addr32[0]) & 0x1fffffff));
+	}
+
+	start = ktime_get();
+	for (i = 0; i < nr_lookups; i++) {
+		struct flowi fl = {
+			.nl_u = {
+				.ip6_u = {
+					.daddr = addrs[i % nr_addrs],
+				},
+			},
+		};
+		struct dst_entry *dst;
+
+		dst = ip6_route_output(&init_net, NULL, &fl);
+		if (dst->error)
+			unreach++;
+		dst_release(dst);
+
+		if (!(i & 4095))
+			cond_resched();
+	}
+	route_bench_report("ipv6", start, unreach);
+
+	vfree(addrs);
+	return 0;
+}
+#else
+static inline int route_bench_ipv6(void)
+{
+	printk(KERN_INFO "route_bench: ipv6: not configured\n");
+	return 0;
+}
+#endif
+
+static int __init route_bench_init(void)
+{
+	int err = 0;
+
+	if (!nr_lookups || !nr_addrs)
+		return -EINVAL;
+
+	if (ipv4)
+		err = route_bench_ipv4();
+	if (!err && ipv6)
+		err = route_bench_ipv6();
+
+	return err;
+}
+
+static void __exit route_bench_exit(void)
+{
+}
+
+module_init(route_bench_init);
+module_exit(route_bench_exit);
+MODULE_DESCRIPTION("Route lookup benchmark");
+MODULE_LICENSE("GPL");
@@ -94,6 +94,7 @@
 #include <linux/igmp.h>
 #include <linux/inetdevice.h>
 #include <linux/netdevice.h>
+#include <linux/etherdevice.h>
 #include <net/checksum.h>
 #include <net/ip.h>
 #include <net/protocol.h>
@@ -152,7 +153,7 @@ void inet_sock_destruct(struct sock *sk)
 	WARN_ON(sk->sk_wmem_queued);
 	WARN_ON(sk->sk_forward_alloc);
 
-	kfree(inet->inet_opt);
+	ip_options_free_rcu(inet->inet_opt);
 	dst_release(sk->sk_dst_cache);
 	sk_refcnt_debug_dec(sk);
 }
@@ -578,16 +579,16 @@ static long inet_wait_for_connect(struct sock *sk, long timeo)
 /*
  *	Connect to a remote host. There is regrettably still a little
  *	TCP 'magic' in here.
+ *
+ *	Called with the socket locked, also by tcp_sendmsg() for MSG_FASTOPEN.
  */
-int inet_stream_connect(struct socket *sock, struct sockaddr *uaddr,
-			int addr_len, int flags)
+int __inet_stream_connect(struct socket *sock, struct sockaddr *uaddr,
+			  int addr_len, int flags)
 {
 	struct sock *sk = sock->sk;
 	int err;
 	long timeo;
 
-	lock_sock(sk);
-
 	if (uaddr->sa_family == AF_UNSPEC) {
 		err = sk->sk_prot->disconnect(sk, flags);
 		sock->state = err ? SS_DISCONNECTING : SS_UNCONNECTED;
@@ -650,7 +651,6 @@ int inet_stream_connect(struct socket *sock, struct sockaddr *uaddr,
 	sock->state = SS_CONNECTED;
 	err = 0;
 out:
-	release_sock(sk);
 	return err;
 
 sock_error:
@@ -660,6 +660,18 @@ sock_error:
 		sock->state = SS_DISCONNECTING;
 	goto out;
 }
+EXPORT_SYMBOL(__inet_stream_connect);
+
+int inet_stream_connect(struct socket *sock, struct sockaddr *uaddr,
+			int addr_len, int flags)
+{
+	int err;
+
+	lock_sock(sock->sk);
+	err = __inet_stream_connect(sock, uaddr, addr_len, flags);
+	release_sock(sock->sk);
+	return err;
+}
 EXPORT_SYMBOL(inet_stream_connect);
 
 /*
@@ -1224,6 +1236,7 @@ static struct sk_buff *inet_gso_segment(struct sk_buff *skb, int features)
 	int ihl;
 	int id;
 	unsigned int offset = 0;
+	int udpfrag;
 
 	if (!(features & NETIF_F_V4_CSUM))
 		features &= ~NETIF_F_SG;
@@ -1233,9 +1246,15 @@ static struct sk_buff *inet_gso_segment(struct sk_buff *skb, int features)
 		       SKB_GSO_UDP |
 		       SKB_GSO_DODGY |
 		       SKB_GSO_TCP_ECN |
+		       SKB_GSO_GRE |
+		       SKB_GSO_IPIP |
+		       SKB_GSO_UDP_GRO |
 		       0)))
 		goto out;
 
+	/* UFO makes IP fragments, merged datagrams are split as they came */
+	udpfrag = !(skb_shinfo(skb)->gso_type & SKB_GSO_UDP_GRO);
+
 	if (unlikely(!pskb_may_pull(skb, sizeof(*iph))))
 		goto out;
 
@@ -1266,7 +1285,7 @@ static struct sk_buff *inet_gso_segment(struct sk_buff *skb, int features)
 	skb = segs;
 	do {
 		iph = ip_hdr(skb);
-		if (proto == IPPROTO_UDP) {
+		if (proto == IPPROTO_UDP && udpfrag) {
 			iph->id = htons(id);
 			iph->frag_off = htons(offset >> 3);
 			if (skb->next != NULL)
@@ -1283,6 +1302,89 @@ out:
 	return segs;
 }
 
+/**
+ *	inet_tunnel_gso_segment - segment a GSO packet inside an IPv4 tunnel
+ *	@skb: packet, data pointing at the tunnel header
+ *	@features: features of the device the segments leave on
+ *	@tnl_hlen: length of the tunnel header
+ *	@protocol: ethertype of the encapsulated packet
+ *	@gso_type: SKB_GSO_* flag of the tunnel
+ *
+ *	Called from the gso_segment() callback of the tunnel protocol.  The
+ *	encapsulated packet is segmented as if it was sent on its own and
+ *	the outer headers are copied in front of every segment, the outer
+ *	IP headers are then fixed up by inet_gso_segment().
+ */
+struct sk_buff *inet_tunnel_gso_segment(struct sk_buff *skb, int features,
+					unsigned int tnl_hlen, __be16 protocol,
+					int gso_type)
+{
+	struct sk_buff *segs = ERR_PTR(-EINVAL);
+	struct sk_buff *seg;
+	__be16 outer_protocol = skb->protocol;
+	unsigned int mac_len = skb->mac_len;
+	unsigned int inner_mac_len = 0;
+	unsigned int outer_hlen;
+	int nhoff, mhoff;
+
+	if (unlikely(!pskb_may_pull(skb, tnl_hlen)))
+		goto out;
+
+	if (protocol == htons(ETH_P_TEB)) {
+		if (unlikely(!pskb_may_pull(skb, tnl_hlen + ETH_HLEN)))
+			goto out;
+		inner_mac_len = ETH_HLEN;
+		protocol = ((struct ethhdr *)(skb->data + tnl_hlen))->h_proto;
+	}
+
+	nhoff = skb_network_header(skb) - skb->data;
+	mhoff = skb_mac_header(skb) - skb->data;
+	outer_hlen = tnl_hlen - mhoff;
+
+	__skb_pull(skb, tnl_hlen);
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, inner_mac_len);
+	skb->protocol = protocol;
+	skb_shinfo(skb)->gso_type &= ~gso_type;
+
+	/*
+	 * The device can not segment the inner packet, and unless it
+	 * checksums at any offset the inner checksums are done here too.
+	 */
+	features &= ~NETIF_F_GSO_MASK;
+	if (!(features & NETIF_F_HW_CSUM))
+		features &= ~(NETIF_F_SG | NETIF_F_ALL_CSUM);
+
+	segs = skb_gso_segment(skb, features);
+	if (!segs)
+		segs = ERR_PTR(-EINVAL);
+
+	__skb_push(skb, tnl_hlen);
+	skb_reset_transport_header(skb);
+	skb_set_network_header(skb, nhoff);
+	skb_set_mac_header(skb, mhoff);
+	skb->mac_len = mac_len;
+	skb->protocol = outer_protocol;
+	skb_shinfo(skb)->gso_type |= gso_type;
+
+	if (IS_ERR(segs))
+		goto out;
+
+	for (seg = segs; seg; seg = seg->next) {
+		__skb_push(seg, outer_hlen);
+		skb_copy_to_linear_data(seg, skb_mac_header(skb), outer_hlen);
+		skb_reset_mac_header(seg);
+		skb_set_network_header(seg, mac_len);
+		skb_set_transport_header(seg, outer_hlen - tnl_hlen);
+		seg->mac_len = mac_len;
+		seg->protocol = outer_protocol;
+	}
+
+out:
+	return segs;
+}
+EXPORT_SYMBOL(inet_tunnel_gso_segment);
+
 static struct sk_buff **inet_gro_receive(struct sk_buff **head,
 					 struct sk_buff *skb)
 {
@@ -1328,7 +1430,7 @@ static struct sk_buff **inet_gro_receive(struct sk_buff **head,
 		if (!NAPI_GRO_CB(p)->same_flow)
 			continue;
 
-		iph2 = ip_hdr(p);
+		iph2 = (struct iphdr *)(p->data + off);
 
 		if ((iph->protocol ^ iph2->protocol) |
 		    (iph->tos ^ iph2->tos) |
@@ -1385,6 +1487,128 @@ out_unlock:
 	return err;
 }
 
+/**
+ *	inet_tunnel_gro_receive - merge packets inside an IPv4 tunnel
+ *	@head: list of packets held by GRO
+ *	@skb: packet, GRO offset at the tunnel header
+ *	@tnl_hlen: length of the tunnel header
+ *	@protocol: ethertype of the encapsulated packet
+ *
+ *	Called from the gro_receive() callback of the tunnel protocol once it
+ *	compared the tunnel headers of the held packets.  The encapsulated
+ *	packet is handed to the GRO handler of its own protocol, with the
+ *	network header pointing at it for the time of the call.
+ */
+struct sk_buff **inet_tunnel_gro_receive(struct sk_buff **head,
+					 struct sk_buff *skb,
+					 unsigned int tnl_hlen, __be16 protocol)
+{
+	struct sk_buff **pp = NULL;
+	struct packet_type *ptype;
+	struct sk_buff *p;
+	unsigned int hlen;
+	unsigned int off;
+	int nhoff;
+	int flush = 1;
+	void *tnlh;
+	__wsum csum;
+
+	/*
+	 * Nested tunnels would share one SKB_GSO_* flag, which the outer
+	 * decapsulation clears, so only the outermost one is merged.
+	 */
+	if (NAPI_GRO_CB(skb)->encap_mark)
+		goto out;
+
+	off = skb_gro_offset(skb);
+	hlen = off + tnl_hlen;
+	if (protocol == htons(ETH_P_TEB))
+		hlen += ETH_HLEN;
+
+	tnlh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		tnlh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!tnlh))
+			goto out;
+	}
+
+	if (protocol == htons(ETH_P_TEB)) {
+		struct ethhdr *eh = tnlh + tnl_hlen;
+
+		for (p = *head; p; p = p->next) {
+			if (!NAPI_GRO_CB(p)->same_flow)
+				continue;
+
+			if (compare_ether_header(p->data + off + tnl_hlen, eh))
+				NAPI_GRO_CB(p)->same_flow = 0;
+		}
+		protocol = eh->h_proto;
+	}
+
+	rcu_read_lock();
+	ptype = gro_find_receive_by_type(protocol);
+	if (!ptype)
+		goto out_unlock;
+
+	nhoff = skb_network_offset(skb);
+	skb_gro_pull(skb, hlen - off);
+	skb_set_network_header(skb, skb_gro_offset(skb));
+
+	csum = skb->csum;
+	skb_postpull_rcsum(skb, tnlh, hlen - off);
+
+	NAPI_GRO_CB(skb)->encap_mark = 1;
+	pp = ptype->gro_receive(head, skb);
+
+	skb->csum = csum;
+	skb_set_network_header(skb, nhoff);
+	flush = 0;
+
+out_unlock:
+	rcu_read_unlock();
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+EXPORT_SYMBOL(inet_tunnel_gro_receive);
+
+/**
+ *	inet_tunnel_gro_complete - finish a packet merged inside a tunnel
+ *	@skb: merged packet, network header at the outer IP header
+ *	@off: offset of the encapsulated packet from skb->data
+ *	@protocol: ethertype of the encapsulated packet
+ *	@gso_type: SKB_GSO_* flag of the tunnel
+ *
+ *	The merged packet keeps the tunnel flag in its gso_type, so that it
+ *	can be segmented again by inet_tunnel_gso_segment() when forwarded.
+ */
+int inet_tunnel_gro_complete(struct sk_buff *skb, unsigned int off,
+			     __be16 protocol, int gso_type)
+{
+	struct packet_type *ptype;
+	int nhoff = skb_network_offset(skb);
+	int err = -ENOENT;
+
+	if (protocol == htons(ETH_P_TEB)) {
+		protocol = ((struct ethhdr *)(skb->data + off))->h_proto;
+		off += ETH_HLEN;
+	}
+
+	rcu_read_lock();
+	ptype = gro_find_complete_by_type(protocol);
+	if (ptype) {
+		skb_set_network_header(skb, off);
+		err = ptype->gro_complete(skb);
+		skb_set_network_header(skb, nhoff);
+		skb_shinfo(skb)->gso_type |= gso_type;
+	}
+	rcu_read_unlock();
+
+	return err;
+}
+EXPORT_SYMBOL(inet_tunnel_gro_complete);
+
 int inet_ctl_sock_create(struct sock **sk, unsigned short family,
 			 unsigned short type, unsigned char protocol,
 			 struct net *net)
@@ -1470,6 +1694,8 @@ static const struct net_protocol udp_protocol = {
 	.err_handler =	udp_err,
 	.gso_send_check = udp4_ufo_send_check,
 	.gso_segment = udp4_ufo_fragment,
+	.gro_receive = udp4_gro_receive,
+	.gro_complete = udp4_gro_complete,
 	.no_policy =	1,
 	.netns_ok =	1,
 };
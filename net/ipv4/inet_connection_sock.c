@@ -290,7 +290,9 @@ struct sock *inet_csk_accept(struct sock *sk, int flags, int *err)
 	}
 
 	newsk = reqsk_queue_get_child(&icsk->icsk_accept_queue, sk);
-	WARN_ON(newsk->sk_state == TCP_SYN_RECV);
+	/* Only a TCP Fast Open child is accepted before its 3WHS completes */
+	WARN_ON(newsk->sk_state == TCP_SYN_RECV &&
+		newsk->sk_protocol != IPPROTO_TCP);
 out:
 	release_sock(sk);
 	return newsk;
@@ -356,12 +358,10 @@ struct dst_entry *inet_csk_route_req(struct sock *sk,
 {
 	struct rtable *rt;
 	const struct inet_request_sock *ireq = inet_rsk(req);
-	struct ip_options_rcu *opt = inet_rsk(req)->opt;
+	struct ip_options_rcu *opt;
 	struct flowi fl = { .oif = sk->sk_bound_dev_if,
 			    .nl_u = { .ip4_u =
-				      { .daddr = ((opt && opt->opt.srr) ?
-						  opt->opt.faddr :
-						  ireq->rmt_addr),
+				      { .daddr = ireq->rmt_addr,
 					.saddr = ireq->loc_addr,
 					.tos = RT_CONN_FLAGS(sk) } },
 			    .proto = sk->sk_protocol,
@@ -370,11 +370,21 @@ struct dst_entry *inet_csk_route_req(struct sock *sk,
 				       { .sport = inet_sk(sk)->sport,
 					 .dport = ireq->rmt_port } } };
 	struct net *net = sock_net(sk);
+	int strictroute = 0;
+
+	rcu_read_lock();
+	opt = inet_req_opt(sk, req);
+	if (opt) {
+		if (opt->opt.srr)
+			fl.fl4_dst = opt->opt.faddr;
+		strictroute = opt->opt.is_strictroute;
+	}
+	rcu_read_unlock();
 
 	security_req_classify_flow(req, &fl);
 	if (ip_route_output_flow(net, &rt, &fl, sk, 0))
 		goto no_route;
-	if (opt && opt->opt.is_strictroute && rt->rt_dst != rt->rt_gateway)
+	if (strictroute && rt->rt_dst != rt->rt_gateway)
 		goto route_err;
 	return &rt->u.dst;
 
@@ -399,19 +409,27 @@ static inline u32 inet_synq_hash(const __be32 raddr, const __be16 rport,
 #define AF_INET_FAMILY(fam) 1
 #endif
 
-struct request_sock *inet_csk_search_req(const struct sock *sk,
-					 struct request_sock ***prevp,
+/*
+ * Look up the request_sock a segment of a passive open belongs to.  The
+ * caller does not need the listener lock; a reference is taken on the
+ * returned request, to be dropped with reqsk_put().
+ */
+struct request_sock *inet_csk_search_req(struct sock *sk,
 					 const __be16 rport, const __be32 raddr,
 					 const __be32 laddr)
 {
-	const struct inet_connection_sock *icsk = inet_csk(sk);
-	struct listen_sock *lopt = icsk->icsk_accept_queue.listen_opt;
-	struct request_sock *req, **prev;
-
-	for (prev = &lopt->syn_table[inet_synq_hash(raddr, rport, lopt->hash_rnd,
-						    lopt->nr_table_entries)];
-	     (req = *prev) != NULL;
-	     prev = &req->dl_next) {
+	struct request_sock_queue *queue = &inet_csk(sk)->icsk_accept_queue;
+	struct listen_sock *lopt;
+	struct request_sock *req = NULL;
+
+	read_lock(&queue->syn_wait_lock);
+	lopt = queue->listen_opt;
+	if (lopt == NULL)
+		goto out;
+
+	for (req = lopt->syn_table[inet_synq_hash(raddr, rport, lopt->hash_rnd,
+						  lopt->nr_table_entries)];
+	     req != NULL; req = req->dl_next) {
 		const struct inet_request_sock *ireq = inet_rsk(req);
 
 		if (ireq->rmt_port == rport &&
@@ -419,26 +437,45 @@ struct request_sock *inet_csk_search_req(const struct sock *sk,
 		    ireq->loc_addr == laddr &&
 		    AF_INET_FAMILY(req->rsk_ops->family)) {
 			WARN_ON(req->sk);
-			*prevp = prev;
+			atomic_inc(&req->rsk_refcnt);
 			break;
 		}
 	}
-
+out:
+	read_unlock(&queue->syn_wait_lock);
 	return req;
 }
 
 EXPORT_SYMBOL_GPL(inet_csk_search_req);
 
-void inet_csk_reqsk_queue_hash_add(struct sock *sk, struct request_sock *req,
-				   unsigned long timeout)
+/*
+ * Returns 0 if the listener is being destroyed and @req was not hashed,
+ * the caller then still owns it.
+ */
+int inet_csk_reqsk_queue_hash_add(struct sock *sk, struct request_sock *req,
+				  unsigned long timeout)
 {
-	struct inet_connection_sock *icsk = inet_csk(sk);
-	struct listen_sock *lopt = icsk->icsk_accept_queue.listen_opt;
-	const u32 h = inet_synq_hash(inet_rsk(req)->rmt_addr, inet_rsk(req)->rmt_port,
-				     lopt->hash_rnd, lopt->nr_table_entries);
+	struct request_sock_queue *queue = &inet_csk(sk)->icsk_accept_queue;
+	struct listen_sock *lopt;
+	int qlen = -1;
+
+	write_lock(&queue->syn_wait_lock);
+	lopt = queue->listen_opt;
+	if (lopt != NULL) {
+		const u32 h = inet_synq_hash(inet_rsk(req)->rmt_addr,
+					     inet_rsk(req)->rmt_port,
+					     lopt->hash_rnd,
+					     lopt->nr_table_entries);
+
+		qlen = reqsk_queue_hash_req(lopt, h, req, timeout);
+	}
+	write_unlock(&queue->syn_wait_lock);
 
-	reqsk_queue_hash_req(&icsk->icsk_accept_queue, h, req, timeout);
-	inet_csk_reqsk_queue_added(sk, timeout);
+	if (qlen < 0)
+		return 0;
+	if (qlen == 0)
+		inet_csk_reset_keepalive_timer(sk, timeout);
+	return 1;
 }
 
 /* Only thing we need from tcp.h */
@@ -520,6 +557,7 @@ void inet_csk_reqsk_queue_prune(struct sock *parent,
 	i = lopt->clock_hand;
 
 	do {
+		write_lock(&queue->syn_wait_lock);
 		reqp=&lopt->syn_table[i];
 		while ((req = *reqp) != NULL) {
 			if (time_after_eq(now, req->expires)) {
@@ -543,13 +581,16 @@ void inet_csk_reqsk_queue_prune(struct sock *parent,
 				}
 
 				/* Drop this request */
-				inet_csk_reqsk_queue_unlink(parent, req, reqp);
-				reqsk_queue_removed(queue, req);
-				reqsk_free(req);
+				*reqp = req->dl_next;
+				if (req->retrans == 0)
+					lopt->qlen_young--;
+				lopt->qlen--;
+				reqsk_put(req);
 				continue;
 			}
 			reqp = &req->dl_next;
 		}
+		write_unlock(&queue->syn_wait_lock);
 
 		i = (i + 1) & (lopt->nr_table_entries - 1);
 
@@ -563,6 +604,36 @@ void inet_csk_reqsk_queue_prune(struct sock *parent,
 
 EXPORT_SYMBOL_GPL(inet_csk_reqsk_queue_prune);
 
+/*
+ * Queue the child created for @req on the accept queue of @sk.  Passive
+ * opens complete without the listener lock, so another CPU may have taken
+ * @req first (@own_req is then 0), or the listener may have been closed
+ * meanwhile.  The child is then destroyed without telling the peer, since
+ * the connection may well be alive in another child, and NULL is returned.
+ */
+struct sock *inet_csk_complete_hashdance(struct sock *sk, struct sock *child,
+					 struct request_sock *req, int own_req)
+{
+	if (own_req) {
+		if (inet_csk_reqsk_queue_add(sk, req, child))
+			return child;
+		reqsk_put(req);
+	}
+
+	inet_csk_delete_keepalive_timer(child);
+	child->sk_prot->unhash(child);
+	child->sk_state = TCP_CLOSE;
+	sock_orphan(child);
+	percpu_counter_inc(child->sk_prot->orphan_count);
+	inet_csk_destroy_sock(child);
+
+	bh_unlock_sock(child);
+	sock_put(child);
+	return NULL;
+}
+
+EXPORT_SYMBOL_GPL(inet_csk_complete_hashdance);
+
 struct sock *inet_csk_clone(struct sock *sk, const struct request_sock *req,
 			    const gfp_t priority)
 {
@@ -707,7 +778,7 @@ void inet_csk_listen_stop(struct sock *sk)
 		sock_put(child);
 
 		sk_acceptq_removed(sk);
-		__reqsk_free(req);
+		reqsk_put(req);
 	}
 	WARN_ON(sk->sk_ack_backlog);
 }
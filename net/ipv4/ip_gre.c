@@ -581,6 +581,10 @@ static int ipgre_rcv(struct sk_buff *skb)
 
 		secpath_reset(skb);
 
+		/* Packets merged by ipgre_gro_receive() leave the tunnel */
+		if (skb_is_gso(skb))
+			skb_shinfo(skb)->gso_type &= ~SKB_GSO_GRE;
+
 		skb->protocol = gre_proto;
 		/* WCCP version 1 and 2 protocol decoding.
 		 * - Change protocol to IP
@@ -675,6 +679,9 @@ static netdev_tx_t ipgre_tunnel_xmit(struct sk_buff *skb, struct net_device *dev
 	__be32 dst;
 	int    mtu;
 
+	if (unlikely(iptunnel_gso_nested(skb, SKB_GSO_GRE)))
+		return iptunnel_xmit_segs(skb, dev, ipgre_tunnel_xmit);
+
 	if (dev->type == ARPHRD_ETHER)
 		IPCB(skb)->flags = 0;
 
@@ -766,7 +773,7 @@ static netdev_tx_t ipgre_tunnel_xmit(struct sk_buff *skb, struct net_device *dev
 		df |= (old_iph->frag_off&htons(IP_DF));
 
 		if ((old_iph->frag_off&htons(IP_DF)) &&
-		    mtu < ntohs(old_iph->tot_len)) {
+		    mtu < ntohs(old_iph->tot_len) && !skb_is_gso(skb)) {
 			icmp_send(skb, ICMP_DEST_UNREACH, ICMP_FRAG_NEEDED, htonl(mtu));
 			ip_rt_put(rt);
 			goto tx_error;
@@ -785,7 +792,8 @@ static netdev_tx_t ipgre_tunnel_xmit(struct sk_buff *skb, struct net_device *dev
 			}
 		}
 
-		if (mtu >= IPV6_MIN_MTU && mtu < skb->len - tunnel->hlen + gre_hlen) {
+		if (mtu >= IPV6_MIN_MTU && mtu < skb->len - tunnel->hlen + gre_hlen &&
+		    !skb_is_gso(skb)) {
 			icmpv6_send(skb, ICMPV6_PKT_TOOBIG, 0, mtu, dev);
 			ip_rt_put(rt);
 			goto tx_error;
@@ -805,8 +813,10 @@ static netdev_tx_t ipgre_tunnel_xmit(struct sk_buff *skb, struct net_device *dev
 
 	max_headroom = LL_RESERVED_SPACE(tdev) + gre_hlen;
 
+	/* A GSO packet gets its gso_type changed, it needs its own copy */
 	if (skb_headroom(skb) < max_headroom || skb_shared(skb)||
-	    (skb_cloned(skb) && !skb_clone_writable(skb, 0))) {
+	    (skb_cloned(skb) && (!skb_clone_writable(skb, 0) ||
+				 skb_is_gso(skb)))) {
 		struct sk_buff *new_skb = skb_realloc_headroom(skb, max_headroom);
 		if (!new_skb) {
 			ip_rt_put(rt);
@@ -821,6 +831,16 @@ static netdev_tx_t ipgre_tunnel_xmit(struct sk_buff *skb, struct net_device *dev
 		old_iph = ip_hdr(skb);
 	}
 
+	/* The GRE checksum covers the payload, whose own must be final */
+	if (iptunnel_handle_offloads(skb,
+				     (tunnel->parms.o_flags & GRE_CSUM) ||
+				     !(tdev->features & NETIF_F_HW_CSUM),
+				     SKB_GSO_GRE)) {
+		ip_rt_put(rt);
+		goto tx_error;
+	}
+	old_iph = ip_hdr(skb);
+
 	skb_reset_transport_header(skb);
 	skb_push(skb, gre_hlen);
 	skb_reset_network_header(skb);
@@ -872,7 +892,11 @@ static netdev_tx_t ipgre_tunnel_xmit(struct sk_buff *skb, struct net_device *dev
 		}
 		if (tunnel->parms.o_flags&GRE_CSUM) {
 			*ptr = 0;
-			*(__sum16*)ptr = ip_compute_csum((void*)(iph+1), skb->len - sizeof(struct iphdr));
+			/* GSO segments get theirs in ipgre_gso_segment() */
+			if (!skb_is_gso(skb))
+				*(__sum16 *)ptr = csum_fold(skb_checksum(skb,
+						sizeof(struct iphdr),
+						skb->len - sizeof(struct iphdr), 0));
 		}
 	}
 
@@ -942,6 +966,10 @@ static int ipgre_tunnel_bind_dev(struct net_device *dev)
 	dev->needed_headroom = addend + hlen;
 	mtu -= dev->hard_header_len + addend;
 
+	/* Segments of one GSO packet can not share a sequence number */
+	if (tunnel->parms.o_flags&GRE_SEQ)
+		dev->features &= ~(NETIF_F_GSO_SOFTWARE | NETIF_F_UFO);
+
 	if (mtu < 68)
 		mtu = 68;
 
@@ -1225,7 +1253,7 @@ static void ipgre_tunnel_setup(struct net_device *dev)
 	dev->flags		= IFF_NOARP;
 	dev->iflink		= 0;
 	dev->addr_len		= 4;
-	dev->features		|= NETIF_F_NETNS_LOCAL;
+	dev->features		|= NETIF_F_NETNS_LOCAL | IPTUNNEL_FEATURES;
 	dev->priv_flags		&= ~IFF_XMIT_DST_RELEASE;
 }
 
@@ -1277,9 +1305,128 @@ static void ipgre_fb_tunnel_init(struct net_device *dev)
 }
 
 
+static int ipgre_gso_send_check(struct sk_buff *skb)
+{
+	return 0;
+}
+
+/* GRE packets sent by ipgre_tunnel_xmit() with SKB_GSO_GRE */
+static struct sk_buff *ipgre_gso_segment(struct sk_buff *skb, int features)
+{
+	struct sk_buff *segs = ERR_PTR(-EINVAL);
+	unsigned int ghl = 4;
+	__be16 *p;
+	__be16 flags;
+	int csum;
+
+	if (unlikely(!(skb_shinfo(skb)->gso_type & SKB_GSO_GRE)))
+		goto out;
+
+	if (unlikely(!pskb_may_pull(skb, ghl)))
+		goto out;
+
+	p = (__be16 *)skb->data;
+	flags = p[0];
+	if (flags & (GRE_VERSION|GRE_ROUTING|GRE_SEQ))
+		goto out;
+
+	csum = flags & GRE_CSUM;
+	if (csum) {
+		ghl += 4;
+		/* the inner checksums have to be final before ours */
+		features &= ~NETIF_F_ALL_CSUM;
+	}
+	if (flags & GRE_KEY)
+		ghl += 4;
+
+	segs = inet_tunnel_gso_segment(skb, features, ghl, p[1], SKB_GSO_GRE);
+	if (!csum || IS_ERR(segs))
+		goto out;
+
+	for (skb = segs; skb; skb = skb->next) {
+		int offset = skb_transport_offset(skb);
+		__be32 *ptr = (__be32 *)(skb_transport_header(skb) + 4);
+
+		*ptr = 0;
+		*(__sum16 *)ptr = csum_fold(skb_checksum(skb, offset,
+							 skb->len - offset, 0));
+	}
+out:
+	return segs;
+}
+
+/*
+ * Packets of the same tunnel are merged when their GRE headers are equal
+ * but for the length; checksums and sequence numbers are per packet, so
+ * those are left alone.
+ */
+static struct sk_buff **ipgre_gro_receive(struct sk_buff **head,
+					  struct sk_buff *skb)
+{
+	struct sk_buff **pp = NULL;
+	struct sk_buff *p;
+	unsigned int ghl = 4;
+	unsigned int hlen;
+	unsigned int off;
+	__be16 *greh;
+
+	off = skb_gro_offset(skb);
+	hlen = off + ghl;
+	greh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		greh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!greh))
+			goto out;
+	}
+
+	if (greh[0] & (GRE_CSUM|GRE_ROUTING|GRE_SEQ|GRE_VERSION))
+		goto out;
+
+	if (greh[0] & GRE_KEY) {
+		ghl += 4;
+		hlen += 4;
+		if (skb_gro_header_hard(skb, hlen)) {
+			greh = skb_gro_header_slow(skb, hlen, off);
+			if (unlikely(!greh))
+				goto out;
+		}
+	}
+
+	/* flags, protocol and key */
+	for (p = *head; p; p = p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		if (memcmp(greh, p->data + off, ghl))
+			NAPI_GRO_CB(p)->same_flow = 0;
+	}
+
+	return inet_tunnel_gro_receive(head, skb, ghl, greh[1]);
+
+out:
+	NAPI_GRO_CB(skb)->flush = 1;
+	return pp;
+}
+
+static int ipgre_gro_complete(struct sk_buff *skb)
+{
+	unsigned int off = skb_network_offset(skb) + ip_hdrlen(skb);
+	__be16 *greh = (__be16 *)(skb->data + off);
+	unsigned int ghl = 4;
+
+	if (greh[0] & GRE_KEY)
+		ghl += 4;
+
+	return inet_tunnel_gro_complete(skb, off + ghl, greh[1], SKB_GSO_GRE);
+}
+
 static const struct net_protocol ipgre_protocol = {
 	.handler	=	ipgre_rcv,
 	.err_handler	=	ipgre_err,
+	.gso_send_check	=	ipgre_gso_send_check,
+	.gso_segment	=	ipgre_gso_segment,
+	.gro_receive	=	ipgre_gro_receive,
+	.gro_complete	=	ipgre_gro_complete,
 	.netns_ok	=	1,
 };
 
@@ -1468,7 +1615,7 @@ static void ipgre_tap_setup(struct net_device *dev)
 	dev->destructor 	= free_netdev;
 
 	dev->iflink		= 0;
-	dev->features		|= NETIF_F_NETNS_LOCAL;
+	dev->features		|= NETIF_F_NETNS_LOCAL | IPTUNNEL_FEATURES;
 }
 
 static int ipgre_newlink(struct net_device *dev, struct nlattr *tb[],
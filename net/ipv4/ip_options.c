@@ -501,6 +501,22 @@ void ip_options_undo(struct ip_options * opt)
 	}
 }
 
+static void ip_options_kfree_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct ip_options_rcu, rcu));
+}
+
+/*
+ *	Free options that lockless readers may still be looking at.
+ */
+
+void ip_options_free_rcu(struct ip_options_rcu *opt)
+{
+	if (opt)
+		call_rcu(&opt->rcu, ip_options_kfree_rcu);
+}
+EXPORT_SYMBOL(ip_options_free_rcu);
+
 static struct ip_options_rcu *ip_options_get_alloc(const int optlen)
 {
 	return kzalloc(sizeof(struct ip_options_rcu) + ((optlen + 3) & ~3),
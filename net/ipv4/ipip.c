@@ -402,6 +402,9 @@ static netdev_tx_t ipip_tunnel_xmit(struct sk_buff *skb, struct net_device *dev)
 	__be32 dst = tiph->daddr;
 	int    mtu;
 
+	if (unlikely(iptunnel_gso_nested(skb, SKB_GSO_IPIP)))
+		return iptunnel_xmit_segs(skb, dev, ipip_tunnel_xmit);
+
 	if (skb->protocol != htons(ETH_P_IP))
 		goto tx_error;
 
@@ -454,7 +457,7 @@ static netdev_tx_t ipip_tunnel_xmit(struct sk_buff *skb, struct net_device *dev)
 			skb_dst(skb)->ops->update_pmtu(skb_dst(skb), mtu);
 
 		if ((old_iph->frag_off & htons(IP_DF)) &&
-		    mtu < ntohs(old_iph->tot_len)) {
+		    mtu < ntohs(old_iph->tot_len) && !skb_is_gso(skb)) {
 			icmp_send(skb, ICMP_DEST_UNREACH, ICMP_FRAG_NEEDED,
 				  htonl(mtu));
 			ip_rt_put(rt);
@@ -476,8 +479,10 @@ static netdev_tx_t ipip_tunnel_xmit(struct sk_buff *skb, struct net_device *dev)
 	 */
 	max_headroom = (LL_RESERVED_SPACE(tdev)+sizeof(struct iphdr));
 
+	/* A GSO packet gets its gso_type changed, it needs its own copy */
 	if (skb_headroom(skb) < max_headroom || skb_shared(skb) ||
-	    (skb_cloned(skb) && !skb_clone_writable(skb, 0))) {
+	    (skb_cloned(skb) && (!skb_clone_writable(skb, 0) ||
+				 skb_is_gso(skb)))) {
 		struct sk_buff *new_skb = skb_realloc_headroom(skb, max_headroom);
 		if (!new_skb) {
 			ip_rt_put(rt);
@@ -492,6 +497,13 @@ static netdev_tx_t ipip_tunnel_xmit(struct sk_buff *skb, struct net_device *dev)
 		old_iph = ip_hdr(skb);
 	}
 
+	if (iptunnel_handle_offloads(skb, !(tdev->features & NETIF_F_HW_CSUM),
+				     SKB_GSO_IPIP)) {
+		ip_rt_put(rt);
+		goto tx_error;
+	}
+	old_iph = ip_hdr(skb);
+
 	skb->transport_header = skb->network_header;
 	skb_push(skb, sizeof(struct iphdr));
 	skb_reset_network_header(skb);
@@ -705,7 +717,7 @@ static void ipip_tunnel_setup(struct net_device *dev)
 	dev->flags		= IFF_NOARP;
 	dev->iflink		= 0;
 	dev->addr_len		= 4;
-	dev->features		|= NETIF_F_NETNS_LOCAL;
+	dev->features		|= NETIF_F_NETNS_LOCAL | IPTUNNEL_FEATURES;
 	dev->priv_flags		&= ~IFF_XMIT_DST_RELEASE;
 }
 
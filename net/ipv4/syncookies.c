@@ -214,7 +214,7 @@ static inline struct sock *get_cookie_sock(struct sock *sk, struct sk_buff *skb,
 
 	child = icsk->icsk_af_ops->syn_recv_sock(sk, skb, req, dst);
 	if (child)
-		inet_csk_reqsk_queue_add(sk, req, child);
+		child = inet_csk_complete_hashdance(sk, child, req, 1);
 	else
 		reqsk_free(req);
 
@@ -278,7 +278,7 @@ struct sock *cookie_v4_check(struct sock *sk, struct sk_buff *skb,
 
 	/* check for timestamp cookie support */
 	memset(&tcp_opt, 0, sizeof(tcp_opt));
-	tcp_parse_options(skb, &tcp_opt, 0);
+	tcp_parse_options(skb, &tcp_opt, 0, NULL);
 
 	if (tcp_opt.saw_tstamp)
 		cookie_check_timestamp(&tcp_opt);
@@ -291,6 +291,8 @@ struct sock *cookie_v4_check(struct sock *sk, struct sk_buff *skb,
 	ireq = inet_rsk(req);
 	treq = tcp_rsk(req);
 	treq->rcv_isn		= ntohl(th->seq) - 1;
+	treq->rcv_nxt		= treq->rcv_isn + 1;
+	treq->listener		= NULL;
 	treq->snt_isn		= cookie;
 	req->mss		= mss;
 	ireq->loc_port		= th->dest;
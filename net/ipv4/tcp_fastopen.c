@@ -0,0 +1,200 @@
+/*
+ * TCP Fast Open: data in the SYN of a connection to a server that handed
+ * the client a cookie in an earlier handshake.
+ *
+ * The server cookie is the client address encrypted with an AES key, that
+ * can be replaced through the tcp_fastopen_key sysctl.  Clients keep the
+ * cookies, and the MSS of the server, in the inet_peer of the destination.
+ */
+
+#include <linux/crypto.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/random.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <net/inetpeer.h>
+#include <net/tcp.h>
+
+int sysctl_tcp_fastopen __read_mostly = TFO_CLIENT_ENABLE;
+
+struct tcp_fastopen_context {
+	struct crypto_cipher	*tfm;
+	u8			key[TCP_FASTOPEN_KEY_LENGTH];
+	struct rcu_head		rcu;
+};
+
+static struct tcp_fastopen_context *tcp_fastopen_ctx;
+static DEFINE_SPINLOCK(tcp_fastopen_ctx_lock);
+
+static void tcp_fastopen_ctx_free(struct rcu_head *head)
+{
+	struct tcp_fastopen_context *ctx =
+		container_of(head, struct tcp_fastopen_context, rcu);
+
+	crypto_free_cipher(ctx->tfm);
+	kfree(ctx);
+}
+
+int tcp_fastopen_reset_cipher(void *key, unsigned int len)
+{
+	struct tcp_fastopen_context *ctx, *octx;
+	int err;
+
+	ctx = kmalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->tfm = crypto_alloc_cipher("aes", 0, 0);
+	if (IS_ERR(ctx->tfm)) {
+		err = PTR_ERR(ctx->tfm);
+		printk(KERN_ERR "TCP: Fast Open cipher alloc error: %d\n", err);
+		kfree(ctx);
+		return err;
+	}
+	err = crypto_cipher_setkey(ctx->tfm, key, len);
+	if (err) {
+		printk(KERN_ERR "TCP: Fast Open cipher key error: %d\n", err);
+		crypto_free_cipher(ctx->tfm);
+		kfree(ctx);
+		return err;
+	}
+	memcpy(ctx->key, key, len);
+
+	spin_lock(&tcp_fastopen_ctx_lock);
+	octx = tcp_fastopen_ctx;
+	rcu_assign_pointer(tcp_fastopen_ctx, ctx);
+	spin_unlock(&tcp_fastopen_ctx_lock);
+
+	if (octx)
+		call_rcu(&octx->rcu, tcp_fastopen_ctx_free);
+	return 0;
+}
+
+void tcp_fastopen_get_key(u32 *key)
+{
+	struct tcp_fastopen_context *ctx;
+
+	rcu_read_lock();
+	ctx = rcu_dereference(tcp_fastopen_ctx);
+	if (ctx)
+		memcpy(key, ctx->key, TCP_FASTOPEN_KEY_LENGTH);
+	else
+		memset(key, 0, TCP_FASTOPEN_KEY_LENGTH);
+	rcu_read_unlock();
+}
+
+/* The cookie of a client is the first TCP_FASTOPEN_COOKIE_SIZE bytes of
+ * its address encrypted with the current key.  foc->len is left alone if
+ * no key could be set up.
+ */
+void tcp_fastopen_cookie_gen(__be32 addr, struct tcp_fastopen_cookie *foc)
+{
+	__be32 peer_addr[4] = { addr, 0, 0, 0 };
+	struct tcp_fastopen_context *ctx;
+
+	rcu_read_lock();
+	ctx = rcu_dereference(tcp_fastopen_ctx);
+	if (ctx) {
+		crypto_cipher_encrypt_one(ctx->tfm, foc->val,
+					  (u8 *)peer_addr);
+		foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+	}
+	rcu_read_unlock();
+}
+
+/* The client cache lives in the inet_peer of the server, so it is IPv4
+ * only for now.  The fields are updated together under a seqlock: a
+ * connect() must not send the cookie of one SYN-ACK with the MSS of
+ * another.
+ */
+static DEFINE_SEQLOCK(tcp_fastopen_seqlock);
+
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	struct inet_peer *peer;
+	unsigned int seq;
+
+	if (sk->sk_family != AF_INET)
+		return;
+	peer = inet_getpeer(inet_sk(sk)->daddr, 0);
+	if (peer == NULL)
+		return;
+
+	do {
+		seq = read_seqbegin(&tcp_fastopen_seqlock);
+		if (peer->tcp_fastopen_mss)
+			*mss = peer->tcp_fastopen_mss;
+		cookie->len = peer->tcp_fastopen_cookie_len;
+		memcpy(cookie->val, peer->tcp_fastopen_cookie,
+		       sizeof(cookie->val));
+		*syn_loss = peer->tcp_fastopen_syn_loss;
+		*last_syn_loss = peer->tcp_fastopen_last_syn_loss;
+	} while (read_seqretry(&tcp_fastopen_seqlock, seq));
+
+	inet_putpeer(peer);
+}
+
+/* Called on the SYN-ACK.  The loss count backs off data in the SYN
+ * exponentially, see tcp_send_syn_data(); it saturates at 6 (an hour).
+ */
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, int syn_lost)
+{
+	struct inet_peer *peer;
+
+	if (sk->sk_family != AF_INET)
+		return;
+	peer = inet_getpeer(inet_sk(sk)->daddr, 1);
+	if (peer == NULL)
+		return;
+
+	write_seqlock_bh(&tcp_fastopen_seqlock);
+	if (mss)
+		peer->tcp_fastopen_mss = mss;
+	if (cookie->len > 0) {
+		peer->tcp_fastopen_cookie_len = cookie->len;
+		memcpy(peer->tcp_fastopen_cookie, cookie->val, cookie->len);
+	}
+	if (syn_lost) {
+		if (peer->tcp_fastopen_syn_loss < 6)
+			peer->tcp_fastopen_syn_loss++;
+		peer->tcp_fastopen_last_syn_loss = jiffies;
+	} else {
+		peer->tcp_fastopen_syn_loss = 0;
+	}
+	write_sequnlock_bh(&tcp_fastopen_seqlock);
+
+	inet_putpeer(peer);
+}
+
+/* A passive Fast Open socket got its SYN-ACK acknowledged, or is going
+ * away: drop its request and give the slot back to the listener.
+ */
+void tcp_fastopen_remove_req(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct request_sock *req = tp->fastopen_rsk;
+	struct sock *lsk = tcp_rsk(req)->listener;
+
+	tp->fastopen_rsk = NULL;
+	tcp_rsk(req)->listener = NULL;
+	atomic_dec(&inet_csk(lsk)->icsk_accept_queue.fastopen_qlen);
+	sock_put(lsk);
+	reqsk_put(req);
+}
+
+static int __init tcp_fastopen_init(void)
+{
+	u8 key[TCP_FASTOPEN_KEY_LENGTH];
+
+	get_random_bytes(key, sizeof(key));
+	tcp_fastopen_reset_cipher(key, sizeof(key));
+	return 0;
+}
+
+late_initcall(tcp_fastopen_init);
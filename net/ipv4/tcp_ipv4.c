@@ -440,12 +440,12 @@ void tcp_v4_err(struct sk_buff *icmp_skb, u32 info)
 	}
 
 	switch (sk->sk_state) {
-		struct request_sock *req, **prev;
+		struct request_sock *req;
 	case TCP_LISTEN:
 		if (sock_owned_by_user(sk))
 			goto out;
 
-		req = inet_csk_search_req(sk, &prev, th->dest,
+		req = inet_csk_search_req(sk, th->dest,
 					  iph->daddr, iph->saddr);
 		if (!req)
 			goto out;
@@ -457,6 +457,7 @@ void tcp_v4_err(struct sk_buff *icmp_skb, u32 info)
 
 		if (seq != tcp_rsk(req)->snt_isn) {
 			NET_INC_STATS_BH(net, LINUX_MIB_OUTOFWINDOWICMPS);
+			reqsk_put(req);
 			goto out;
 		}
 
@@ -466,7 +467,8 @@ void tcp_v4_err(struct sk_buff *icmp_skb, u32 info)
 		 * created socket, and POSIX does not want network
 		 * errors returned from accept().
 		 */
-		inet_csk_reqsk_queue_drop(sk, req, prev);
+		inet_csk_reqsk_queue_drop(sk, req);
+		reqsk_put(req);
 		goto out;
 
 	case TCP_SYN_SENT:
@@ -726,24 +728,50 @@ static void tcp_v4_timewait_ack(struct sock *sk, struct sk_buff *skb)
 	inet_twsk_put(tw);
 }
 
+/* @sk is the listener, or the child of a Fast Open request, which may
+ * have sent data after its SYN-ACK already.
+ */
 static void tcp_v4_reqsk_send_ack(struct sock *sk, struct sk_buff *skb,
 				  struct request_sock *req)
 {
-	tcp_v4_send_ack(skb, tcp_rsk(req)->snt_isn + 1,
-			tcp_rsk(req)->rcv_isn + 1, req->rcv_wnd,
+	tcp_v4_send_ack(skb, (sk->sk_state == TCP_LISTEN) ?
+			tcp_rsk(req)->snt_isn + 1 : tcp_sk(sk)->snd_nxt,
+			tcp_rsk(req)->rcv_nxt, req->rcv_wnd,
 			req->ts_recent,
 			0,
 			tcp_v4_md5_do_lookup(sk, ip_hdr(skb)->daddr),
 			inet_rsk(req)->no_srccheck ? IP_REPLY_ARG_NOSRCCHECK : 0);
 }
 
+static struct sk_buff *tcp_v4_make_synack(struct sock *sk,
+					  struct dst_entry *dst,
+					  struct request_sock *req,
+					  struct tcp_fastopen_cookie *foc)
+{
+	const struct inet_request_sock *ireq = inet_rsk(req);
+	struct sk_buff *skb;
+
+	skb = tcp_make_synack(sk, dst, req, foc);
+	if (skb) {
+		struct tcphdr *th = tcp_hdr(skb);
+
+		th->check = tcp_v4_check(skb->len,
+					 ireq->loc_addr,
+					 ireq->rmt_addr,
+					 csum_partial(th, skb->len,
+						      skb->csum));
+	}
+	return skb;
+}
+
 /*
  *	Send a SYN-ACK after having received a SYN.
  *	This still operates on a request_sock only, not on a big
  *	socket.
  */
 static int __tcp_v4_send_synack(struct sock *sk, struct request_sock *req,
-				struct dst_entry *dst)
+				struct dst_entry *dst,
+				struct tcp_fastopen_cookie *foc)
 {
 	const struct inet_request_sock *ireq = inet_rsk(req);
 	int err = -1;
@@ -753,20 +781,14 @@ static int __tcp_v4_send_synack(struct sock *sk, struct request_sock *req,
 	if (!dst && (dst = inet_csk_route_req(sk, req)) == NULL)
 		return -1;
 
-	skb = tcp_make_synack(sk, dst, req);
+	skb = tcp_v4_make_synack(sk, dst, req, foc);
 
 	if (skb) {
-		struct tcphdr *th = tcp_hdr(skb);
-
-		th->check = tcp_v4_check(skb->len,
-					 ireq->loc_addr,
-					 ireq->rmt_addr,
-					 csum_partial(th, skb->len,
-						      skb->csum));
-
+		rcu_read_lock();
 		err = ip_build_and_send_pkt(skb, sk, ireq->loc_addr,
 					    ireq->rmt_addr,
-					    ireq->opt);
+					    inet_req_opt(sk, req));
+		rcu_read_unlock();
 		err = net_xmit_eval(err);
 	}
 
@@ -776,7 +798,7 @@ static int __tcp_v4_send_synack(struct sock *sk, struct request_sock *req,
 
 static int tcp_v4_send_synack(struct sock *sk, struct request_sock *req)
 {
-	return __tcp_v4_send_synack(sk, req, NULL);
+	return __tcp_v4_send_synack(sk, req, NULL, NULL);
 }
 
 /*
@@ -784,7 +806,7 @@ static int tcp_v4_send_synack(struct sock *sk, struct request_sock *req)
  */
 static void tcp_v4_reqsk_destructor(struct request_sock *req)
 {
-	kfree(inet_rsk(req)->opt);
+	ip_options_free_rcu(inet_rsk(req)->opt);
 }
 
 #ifdef CONFIG_SYN_COOKIES
@@ -1017,6 +1039,10 @@ static int tcp_v4_parse_md5_keys(struct sock *sk, char __user *optval,
 
 		tp->md5sig_info = p;
 		sk->sk_route_caps &= ~NETIF_F_GSO_MASK;
+
+		/* See tcp_listen_lockless() */
+		if (sk->sk_state == TCP_LISTEN)
+			synchronize_net();
 	}
 
 	newkey = kmemdup(cmd.tcpm_key, cmd.tcpm_keylen, sk->sk_allocation);
@@ -1210,8 +1236,161 @@ static struct timewait_sock_ops tcp_timewait_sock_ops = {
 	.twsk_destructor= tcp_twsk_destructor,
 };
 
+/*
+ * Decides whether the data in a SYN is accepted: the listener must take
+ * Fast Open children, have room for one more, and the cookie must be
+ * right.  @valid_foc is set to the cookie to return in the SYN-ACK, when
+ * the client asked for one or sent a wrong one.
+ */
+static int tcp_fastopen_check(struct sock *sk, struct sk_buff *skb,
+			      struct request_sock *req,
+			      struct tcp_fastopen_cookie *foc,
+			      struct tcp_fastopen_cookie *valid_foc)
+{
+	struct request_sock_queue *queue = &inet_csk(sk)->icsk_accept_queue;
+	__be32 saddr = ip_hdr(skb)->saddr;
+	int check_cookie = 1;
+
+	if (likely(foc->len < 0)) {
+		if (!(sysctl_tcp_fastopen & TFO_SERVER_COOKIE_NOT_REQD) ||
+		    TCP_SKB_CB(skb)->end_seq == TCP_SKB_CB(skb)->seq + 1)
+			return 0;
+		check_cookie = 0;
+	}
+	if (!(sysctl_tcp_fastopen & TFO_SERVER_ENABLE) ||
+	    queue->fastopen_max_qlen == 0)
+		return 0;
+
+	if (foc->len == 0) {
+		tcp_fastopen_cookie_gen(saddr, valid_foc);
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENCOOKIEREQD);
+		return 0;
+	}
+	if (check_cookie &&
+	    !(sysctl_tcp_fastopen & TFO_SERVER_COOKIE_NOT_CHKED)) {
+		tcp_fastopen_cookie_gen(saddr, valid_foc);
+		if (foc->len != TCP_FASTOPEN_COOKIE_SIZE ||
+		    valid_foc->len != TCP_FASTOPEN_COOKIE_SIZE ||
+		    memcmp(foc->val, valid_foc->val,
+			   TCP_FASTOPEN_COOKIE_SIZE) != 0) {
+			NET_INC_STATS_BH(sock_net(sk),
+					 LINUX_MIB_TCPFASTOPENPASSIVEFAIL);
+			return 0;
+		}
+		valid_foc->len = -1;
+	}
+
+	if (atomic_inc_return(&queue->fastopen_qlen) >
+	    queue->fastopen_max_qlen) {
+		atomic_dec(&queue->fastopen_qlen);
+		NET_INC_STATS_BH(sock_net(sk),
+				 LINUX_MIB_TCPFASTOPENLISTENOVERFLOW);
+		return 0;
+	}
+
+	/* The SYN-ACK acknowledges the data */
+	tcp_rsk(req)->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
+	return 1;
+}
+
+/*
+ * The child of a Fast Open request is created from the SYN, takes its data,
+ * and is queued for accept() right away.  It keeps @req, and a reference on
+ * the listener, to retransmit the SYN-ACK until that is acknowledged, see
+ * tcp_fastopen_remove_req().  Returns -1, having released @dst, if the
+ * child could not be created.
+ */
+static int tcp_v4_conn_req_fastopen(struct sock *sk, struct sk_buff *skb,
+				    struct request_sock *req,
+				    struct dst_entry *dst)
+{
+	const struct inet_request_sock *ireq = inet_rsk(req);
+	struct inet_connection_sock *icsk;
+	struct sk_buff *skb_synack, *data = NULL;
+	struct tcp_sock *tp;
+	struct sock *child;
+
+	/* The child may be accepted and read as soon as it is queued, so
+	 * it gets its own clone of the SYN data.
+	 */
+	if (TCP_SKB_CB(skb)->end_seq != TCP_SKB_CB(skb)->seq + 1) {
+		data = skb_clone(skb, GFP_ATOMIC);
+		if (data == NULL) {
+			dst_release(dst);
+			return -1;
+		}
+	}
+
+	if (!dst && (dst = inet_csk_route_req(sk, req)) == NULL)
+		goto drop_data;
+
+	/* Before the child: the SYN-ACK sets the window of @req up */
+	skb_synack = tcp_v4_make_synack(sk, dst, req, NULL);
+	if (skb_synack == NULL) {
+		dst_release(dst);
+		goto drop_data;
+	}
+
+	child = inet_csk(sk)->icsk_af_ops->syn_recv_sock(sk, skb, req, dst);
+	if (child == NULL) {
+		kfree_skb(skb_synack);
+		goto drop_data;
+	}
+
+	icsk = inet_csk(child);
+	tp = tcp_sk(child);
+	atomic_inc(&req->rsk_refcnt);
+	tp->fastopen_rsk = req;
+	sock_hold(sk);
+	tcp_rsk(req)->listener = sk;
+
+	/* RFC1323: The window in SYN & SYN/ACK segments is never scaled. */
+	tp->snd_wnd = tp->max_window = ntohs(tcp_hdr(skb)->window);
+
+	icsk->icsk_af_ops->rebuild_header(child);
+	tcp_init_congestion_control(child);
+	tcp_mtup_init(child);
+	tcp_init_buffer_space(child);
+
+	/* The data in the SYN is acknowledged by the SYN-ACK */
+	if (data != NULL) {
+		skb_dst_drop(data);
+		__skb_pull(data, tcp_hdr(data)->doff * 4);
+		skb_set_owner_r(data, child);
+		__skb_queue_tail(&child->sk_receive_queue, data);
+		tp->syn_data_acked = 1;
+	}
+
+	/* Destroys the child if the listener is being closed */
+	if (!inet_csk_complete_hashdance(sk, child, req, 1)) {
+		kfree_skb(skb_synack);
+		return 0;
+	}
+
+	rcu_read_lock();
+	ip_build_and_send_pkt(skb_synack, sk, ireq->loc_addr, ireq->rmt_addr,
+			      rcu_dereference(inet_sk(child)->inet_opt));
+	rcu_read_unlock();
+
+	/* Retransmits the SYN-ACK, see tcp_fastopen_synack_timer() */
+	inet_csk_reset_xmit_timer(child, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT, TCP_RTO_MAX);
+
+	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVE);
+	sk->sk_data_ready(sk, 0);
+	bh_unlock_sock(child);
+	sock_put(child);
+	return 0;
+
+drop_data:
+	kfree_skb(data);
+	return -1;
+}
+
 int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 {
+	struct tcp_fastopen_cookie foc = { .len = -1 };
+	struct tcp_fastopen_cookie valid_foc = { .len = -1 };
 	struct inet_request_sock *ireq;
 	struct tcp_options_received tmp_opt;
 	struct request_sock *req;
@@ -1262,7 +1441,7 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	tmp_opt.mss_clamp = 536;
 	tmp_opt.user_mss  = tcp_sk(sk)->rx_opt.user_mss;
 
-	tcp_parse_options(skb, &tmp_opt, 0);
+	tcp_parse_options(skb, &tmp_opt, 0, want_cookie ? NULL : &foc);
 
 	if (want_cookie && !tmp_opt.saw_tstamp)
 		tcp_clear_options(&tmp_opt);
@@ -1335,10 +1514,30 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	}
 	tcp_rsk(req)->snt_isn = isn;
 
-	if (__tcp_v4_send_synack(sk, req, dst) || want_cookie)
+	if (want_cookie) {
+		__tcp_v4_send_synack(sk, req, dst, NULL);
+		goto drop_and_free;
+	}
+
+	if (tcp_fastopen_check(sk, skb, req, &foc, &valid_foc)) {
+		if (tcp_v4_conn_req_fastopen(sk, skb, req, dst) == 0)
+			return 0;
+		atomic_dec(&inet_csk(sk)->icsk_accept_queue.fastopen_qlen);
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVEFAIL);
 		goto drop_and_free;
+	}
 
-	inet_csk_reqsk_queue_hash_add(sk, req, TCP_TIMEOUT_INIT);
+	/* The ACK of the SYN-ACK may be processed on another CPU, without
+	 * the listener lock: hash the request first, and keep a reference
+	 * on it while the SYN-ACK is built.
+	 */
+	atomic_inc(&req->rsk_refcnt);
+	if (!inet_csk_reqsk_queue_hash_add(sk, req, TCP_TIMEOUT_INIT))
+		goto drop_and_release;
+
+	__tcp_v4_send_synack(sk, req, dst,
+			     valid_foc.len > 0 ? &valid_foc : NULL);
+	reqsk_put(req);
 	return 0;
 
 drop_and_release:
@@ -1386,9 +1585,11 @@ struct sock *tcp_v4_syn_recv_sock(struct sock *sk, struct sk_buff *skb,
 	newinet->daddr	      = ireq->rmt_addr;
 	newinet->rcv_saddr    = ireq->loc_addr;
 	newinet->saddr	      = ireq->loc_addr;
-	inet_opt	      = ireq->opt;
+	/* Another CPU may be completing the same request (see
+	 * inet_csk_complete_hashdance()), only one child gets the options.
+	 */
+	inet_opt	      = xchg(&ireq->opt, NULL);
 	rcu_assign_pointer(newinet->inet_opt, inet_opt);
-	ireq->opt	      = NULL;
 	newinet->mc_index     = inet_iif(skb);
 	newinet->mc_ttl	      = ip_hdr(skb)->ttl;
 	inet_csk(newsk)->icsk_ext_hdr_len = 0;
@@ -1440,12 +1641,14 @@ static struct sock *tcp_v4_hnd_req(struct sock *sk, struct sk_buff *skb)
 	struct tcphdr *th = tcp_hdr(skb);
 	const struct iphdr *iph = ip_hdr(skb);
 	struct sock *nsk;
-	struct request_sock **prev;
 	/* Find possible connection requests. */
-	struct request_sock *req = inet_csk_search_req(sk, &prev, th->source,
+	struct request_sock *req = inet_csk_search_req(sk, th->source,
 						       iph->saddr, iph->daddr);
-	if (req)
-		return tcp_check_req(sk, skb, req, prev);
+	if (req) {
+		nsk = tcp_check_req(sk, skb, req, 0);
+		reqsk_put(req);
+		return nsk;
+	}
 
 	nsk = inet_lookup_established(sock_net(sk), &tcp_hashinfo, iph->saddr,
 			th->source, iph->daddr, th->dest, inet_iif(skb));
@@ -1623,6 +1826,15 @@ process:
 
 	skb->dev = NULL;
 
+	/* Passive opens do not serialize on the listener lock: the SYN
+	 * table and the accept queue have locks of their own.
+	 */
+	if (tcp_listen_lockless(sk)) {
+		ret = tcp_v4_do_rcv(sk, skb);
+		sock_put(sk);
+		return ret;
+	}
+
 	bh_lock_sock_nested(sk);
 	ret = 0;
 	if (!sock_owned_by_user(sk)) {
@@ -1871,6 +2083,11 @@ void tcp_v4_destroy_sock(struct sock *sk)
 	/* Clean prequeue, it must be empty really */
 	__skb_queue_purge(&tp->ucopy.prequeue);
 
+	/* A Fast Open child closed before its SYN-ACK was acknowledged */
+	if (tp->fastopen_rsk != NULL)
+		tcp_fastopen_remove_req(sk);
+	tcp_free_fastopen_req(tp);
+
 	/* Clean up a referenced TCP bind bucket. */
 	if (inet_csk(sk)->icsk_bind_hash)
 		inet_put_port(sk);
@@ -2434,6 +2651,7 @@ struct proto tcp_prot = {
 	.getsockopt		= tcp_getsockopt,
 	.recvmsg		= tcp_recvmsg,
 	.backlog_rcv		= tcp_v4_do_rcv,
+	.release_cb		= tcp_release_cb,
 	.hash			= inet_hash,
 	.unhash			= inet_unhash,
 	.get_port		= inet_csk_get_port,
@@ -81,6 +81,10 @@ static int tunnel4_rcv(struct sk_buff *skb)
 	if (!pskb_may_pull(skb, sizeof(struct iphdr)))
 		goto drop;
 
+	/* Packets merged by tunnel4_gro_receive() leave the tunnel */
+	if (skb_is_gso(skb))
+		skb_shinfo(skb)->gso_type &= ~SKB_GSO_IPIP;
+
 	for (handler = tunnel4_handlers; handler; handler = handler->next)
 		if (!handler->handler(skb))
 			return 0;
@@ -132,9 +136,42 @@ static void tunnel64_err(struct sk_buff *skb, u32 info)
 }
 #endif
 
+static int tunnel4_gso_send_check(struct sk_buff *skb)
+{
+	return 0;
+}
+
+/* IPIP packets sent by ipip_tunnel_xmit() with SKB_GSO_IPIP */
+static struct sk_buff *tunnel4_gso_segment(struct sk_buff *skb, int features)
+{
+	if (unlikely(!(skb_shinfo(skb)->gso_type & SKB_GSO_IPIP)))
+		return ERR_PTR(-EINVAL);
+
+	return inet_tunnel_gso_segment(skb, features, 0, htons(ETH_P_IP),
+				       SKB_GSO_IPIP);
+}
+
+static struct sk_buff **tunnel4_gro_receive(struct sk_buff **head,
+					    struct sk_buff *skb)
+{
+	return inet_tunnel_gro_receive(head, skb, 0, htons(ETH_P_IP));
+}
+
+static int tunnel4_gro_complete(struct sk_buff *skb)
+{
+	return inet_tunnel_gro_complete(skb,
+					skb_network_offset(skb) +
+					ip_hdrlen(skb),
+					htons(ETH_P_IP), SKB_GSO_IPIP);
+}
+
 static const struct net_protocol tunnel4_protocol = {
 	.handler	=	tunnel4_rcv,
 	.err_handler	=	tunnel4_err,
+	.gso_send_check	=	tunnel4_gso_send_check,
+	.gso_segment	=	tunnel4_gso_segment,
+	.gro_receive	=	tunnel4_gro_receive,
+	.gro_complete	=	tunnel4_gro_complete,
 	.no_policy	=	1,
 	.netns_ok	=	1,
 };
@@ -95,6 +95,7 @@
 #include <linux/mm.h>
 #include <linux/inet.h>
 #include <linux/netdevice.h>
+#include <linux/inetdevice.h>
 #include <net/tcp_states.h>
 #include <linux/skbuff.h>
 #include <linux/proc_fs.h>
@@ -1021,6 +1022,11 @@ try_again:
 	}
 	if (inet->cmsg_flags)
 		ip_cmsg_recv(msg, skb);
+	if (udp_skb_is_gro(skb)) {
+		int gso_size = skb_shinfo(skb)->gso_size;
+
+		put_cmsg(msg, SOL_UDP, UDP_GRO, sizeof(gso_size), &gso_size);
+	}
 
 	err = copied;
 	if (flags & MSG_TRUNC)
@@ -1107,6 +1113,50 @@ drop:
 	return -1;
 }
 
+/*
+ * Datagrams merged by udp4_gro_receive() that reach a socket without
+ * UDP_GRO, because of a multicast or broadcast delivery or because the
+ * option was cleared meanwhile, are queued one by one.
+ */
+static int udp_queue_rcv_segs(struct sock *sk, struct sk_buff *skb)
+{
+	unsigned int iphlen = skb_network_header_len(skb);
+	struct sk_buff *segs, *next;
+
+	/* copy the IP and UDP headers in front of every datagram */
+	skb->mac_header = skb->network_header;
+	skb->mac_len = 0;
+	__skb_pull(skb, sizeof(struct udphdr));
+
+	segs = skb_segment(skb, 0);
+	kfree_skb(skb);
+	if (IS_ERR(segs)) {
+		UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_INERRORS,
+				 IS_UDPLITE(sk));
+		return -1;
+	}
+
+	for (; segs; segs = next) {
+		struct iphdr *iph = ip_hdr(segs);
+
+		next = segs->next;
+		segs->next = NULL;
+
+		iph->tot_len = htons(segs->len);
+		ip_send_check(iph);
+		udp_hdr(segs)->len = htons(segs->len - iphlen);
+		/* verified by udp4_gro_receive() */
+		segs->ip_summed = CHECKSUM_UNNECESSARY;
+		__skb_pull(segs, iphlen);
+
+		/* Encapsulation sockets do not get merged datagrams, there
+		 * is nothing to resubmit. */
+		if (udp_queue_rcv_skb(sk, segs) > 0)
+			kfree_skb(segs);
+	}
+	return 0;
+}
+
 /* returns:
  *  -1: error
  *   0: success
@@ -1121,6 +1171,9 @@ int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 	int rc;
 	int is_udplite = IS_UDPLITE(sk);
 
+	if (unlikely(udp_skb_is_gro(skb)) && !up->gro_enabled)
+		return udp_queue_rcv_segs(sk, skb);
+
 	/*
 	 *	Charge it to the socket, dropping if the queue is full.
 	 */
@@ -1467,6 +1520,13 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		}
 		break;
 
+	case UDP_GRO:
+		/* Merged datagrams are only built for IPv4 sockets */
+		if (is_udplite || sk->sk_family != AF_INET)
+			return -ENOPROTOOPT;
+		up->gro_enabled = val ? 1 : 0;
+		break;
+
 	case UDP_ENCAP:
 		switch (val) {
 		case 0:
@@ -1565,6 +1625,10 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = up->encap_type;
 		break;
 
+	case UDP_GRO:
+		val = up->gro_enabled;
+		break;
+
 	/* The following two cannot be changed on UDP sockets, the return is
 	 * always 0 (which corresponds to the full checksum coverage of UDP). */
 	case UDPLITE_SEND_CSCOV:
@@ -1919,6 +1983,41 @@ int udp4_ufo_send_check(struct sk_buff *skb)
 	return 0;
 }
 
+/*
+ * Split datagrams merged by udp4_gro_receive() that are sent out again,
+ * with a full checksum for each of them.
+ */
+static struct sk_buff *udp4_gro_segment(struct sk_buff *skb)
+{
+	struct sk_buff *segs, *seg;
+
+	if (unlikely(!pskb_may_pull(skb, sizeof(struct udphdr))))
+		return ERR_PTR(-EINVAL);
+
+	__skb_pull(skb, sizeof(struct udphdr));
+	/* no SG: the frag_list members may hold several datagrams each */
+	segs = skb_segment(skb, 0);
+	__skb_push(skb, sizeof(struct udphdr));
+	if (IS_ERR(segs))
+		return segs;
+
+	for (seg = segs; seg; seg = seg->next) {
+		struct iphdr *iph = ip_hdr(seg);
+		struct udphdr *uh = udp_hdr(seg);
+		int offset = skb_transport_offset(seg);
+		int len = seg->len - offset;
+
+		uh->len = htons(len);
+		uh->check = 0;
+		uh->check = csum_tcpudp_magic(iph->saddr, iph->daddr, len,
+					      IPPROTO_UDP,
+					      skb_checksum(seg, offset, len, 0));
+		if (uh->check == 0)
+			uh->check = CSUM_MANGLED_0;
+	}
+	return segs;
+}
+
 struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb, int features)
 {
 	struct sk_buff *segs = ERR_PTR(-EINVAL);
@@ -1930,6 +2029,11 @@ struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb, int features)
 	if (unlikely(skb->len <= mss))
 		goto out;
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_GRO) {
+		segs = udp4_gro_segment(skb);
+		goto out;
+	}
+
 	if (skb_gso_ok(skb, features | NETIF_F_GSO_ROBUST)) {
 		/* Packet is from an untrusted source, reset gso_segs. */
 		int type = skb_shinfo(skb)->gso_type;
@@ -1961,3 +2065,131 @@ out:
 	return segs;
 }
 
+/*
+ * Datagrams of a flow are merged for sockets that set UDP_GRO, into one
+ * skb that udp_recvmsg() hands out at once along with the size of the
+ * datagrams.  Only done on hosts that do not forward, a socket bound to
+ * the wildcard address would otherwise pull in transit traffic; if a
+ * batch is sent out anyway, udp4_ufo_fragment() splits it again.
+ */
+struct sk_buff **udp4_gro_receive(struct sk_buff **head, struct sk_buff *skb)
+{
+	struct sk_buff **pp = NULL;
+	struct in_device *in_dev;
+	struct sk_buff *p;
+	struct udphdr *uh;
+	struct udphdr *uh2;
+	struct iphdr *iph;
+	struct sock *sk;
+	unsigned int hlen;
+	unsigned int off;
+	unsigned int len;
+	unsigned int mss = 1;
+	int flush = 1;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*uh);
+	uh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		uh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!uh))
+			goto out;
+	}
+
+	len = skb_gro_len(skb);
+	if (skb->pkt_type != PACKET_HOST || ntohs(uh->len) != len ||
+	    len <= sizeof(*uh))
+		goto out;
+
+	iph = skb_gro_network_header(skb);
+
+	switch (skb->ip_summed) {
+	case CHECKSUM_COMPLETE:
+		if (!csum_tcpudp_magic(iph->saddr, iph->daddr, len,
+				       IPPROTO_UDP, skb->csum)) {
+			skb->ip_summed = CHECKSUM_UNNECESSARY;
+			break;
+		}
+
+		/* fall through */
+	case CHECKSUM_NONE:
+		if (uh->check)
+			goto out;
+	}
+
+	in_dev = __in_dev_get_rcu(skb->dev);
+	if (!in_dev || IN_DEV_FORWARD(in_dev))
+		goto out;
+
+	sk = __udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
+			       iph->daddr, uh->dest, skb->dev->ifindex,
+			       &udp_table);
+	if (!sk)
+		goto out;
+	flush = sk->sk_family != AF_INET || !udp_sk(sk)->gro_enabled ||
+		udp_sk(sk)->encap_type;
+	sock_put(sk);
+	if (flush)
+		goto out;
+
+	skb_gro_pull(skb, sizeof(*uh));
+	len = skb_gro_len(skb);
+
+	for (; (p = *head); head = &p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+		if (*(u32 *)&uh->source ^ *(u32 *)&uh2->source) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+
+		goto found;
+	}
+
+	goto out_check_final;
+
+found:
+	flush = NAPI_GRO_CB(p)->flush;
+	mss = skb_shinfo(p)->gso_size;
+
+	/* all datagrams but the last one have the size of the first */
+	flush |= (len - 1) >= mss;
+
+	if (flush || skb_gro_receive(head, skb)) {
+		mss = 1;
+		goto out_check_final;
+	}
+
+	p = *head;
+
+out_check_final:
+	flush = len < mss;
+
+	if (p && (!NAPI_GRO_CB(skb)->same_flow || flush))
+		pp = head;
+
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+
+int udp4_gro_complete(struct sk_buff *skb)
+{
+	const struct iphdr *iph = ip_hdr(skb);
+	struct udphdr *uh = udp_hdr(skb);
+	int len = skb->len - skb_transport_offset(skb);
+
+	uh->len = htons(len);
+	uh->check = ~csum_tcpudp_magic(iph->saddr, iph->daddr, len,
+				       IPPROTO_UDP, 0);
+	skb->csum_start = skb_transport_header(skb) - skb->head;
+	skb->csum_offset = offsetof(struct udphdr, check);
+	skb->ip_summed = CHECKSUM_PARTIAL;
+
+	skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_GRO;
+
+	return 0;
+}
@@ -892,10 +892,10 @@ static struct sk_buff **ipv6_gro_receive(struct sk_buff **head,
 		if (!NAPI_GRO_CB(p)->same_flow)
 			continue;
 
-		iph2 = ipv6_hdr(p);
+		iph2 = (struct ipv6hdr *)(p->data + off);
 
 		/* All fields must match except length. */
-		if (nlen != skb_network_header_len(p) ||
+		if (nlen != skb_transport_offset(p) - off ||
 		    memcmp(iph, iph2, offsetof(struct ipv6hdr, payload_len)) ||
 		    memcmp(&iph->nexthdr, &iph2->nexthdr,
 			   nlen - offsetof(struct ipv6hdr, nexthdr))) {
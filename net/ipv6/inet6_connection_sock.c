@@ -75,22 +75,25 @@ static u32 inet6_synq_hash(const struct in6_addr *raddr, const __be16 rport,
 	return c & (synq_hsize - 1);
 }
 
-struct request_sock *inet6_csk_search_req(const struct sock *sk,
-					  struct request_sock ***prevp,
+struct request_sock *inet6_csk_search_req(struct sock *sk,
 					  const __be16 rport,
 					  const struct in6_addr *raddr,
 					  const struct in6_addr *laddr,
 					  const int iif)
 {
-	const struct inet_connection_sock *icsk = inet_csk(sk);
-	struct listen_sock *lopt = icsk->icsk_accept_queue.listen_opt;
-	struct request_sock *req, **prev;
-
-	for (prev = &lopt->syn_table[inet6_synq_hash(raddr, rport,
-						     lopt->hash_rnd,
-						     lopt->nr_table_entries)];
-	     (req = *prev) != NULL;
-	     prev = &req->dl_next) {
+	struct request_sock_queue *queue = &inet_csk(sk)->icsk_accept_queue;
+	struct listen_sock *lopt;
+	struct request_sock *req = NULL;
+
+	read_lock(&queue->syn_wait_lock);
+	lopt = queue->listen_opt;
+	if (lopt == NULL)
+		goto out;
+
+	for (req = lopt->syn_table[inet6_synq_hash(raddr, rport,
+						   lopt->hash_rnd,
+						   lopt->nr_table_entries)];
+	     req != NULL; req = req->dl_next) {
 		const struct inet6_request_sock *treq = inet6_rsk(req);
 
 		if (inet_rsk(req)->rmt_port == rport &&
@@ -99,28 +102,42 @@ struct request_sock *inet6_csk_search_req(const struct sock *sk,
 		    ipv6_addr_equal(&treq->loc_addr, laddr) &&
 		    (!treq->iif || treq->iif == iif)) {
 			WARN_ON(req->sk != NULL);
-			*prevp = prev;
-			return req;
+			atomic_inc(&req->rsk_refcnt);
+			break;
 		}
 	}
-
-	return NULL;
+out:
+	read_unlock(&queue->syn_wait_lock);
+	return req;
 }
 
 EXPORT_SYMBOL_GPL(inet6_csk_search_req);
 
-void inet6_csk_reqsk_queue_hash_add(struct sock *sk,
-				    struct request_sock *req,
-				    const unsigned long timeout)
+int inet6_csk_reqsk_queue_hash_add(struct sock *sk,
+				   struct request_sock *req,
+				   const unsigned long timeout)
 {
-	struct inet_connection_sock *icsk = inet_csk(sk);
-	struct listen_sock *lopt = icsk->icsk_accept_queue.listen_opt;
-	const u32 h = inet6_synq_hash(&inet6_rsk(req)->rmt_addr,
-				      inet_rsk(req)->rmt_port,
-				      lopt->hash_rnd, lopt->nr_table_entries);
-
-	reqsk_queue_hash_req(&icsk->icsk_accept_queue, h, req, timeout);
-	inet_csk_reqsk_queue_added(sk, timeout);
+	struct request_sock_queue *queue = &inet_csk(sk)->icsk_accept_queue;
+	struct listen_sock *lopt;
+	int qlen = -1;
+
+	write_lock(&queue->syn_wait_lock);
+	lopt = queue->listen_opt;
+	if (lopt != NULL) {
+		const u32 h = inet6_synq_hash(&inet6_rsk(req)->rmt_addr,
+					      inet_rsk(req)->rmt_port,
+					      lopt->hash_rnd,
+					      lopt->nr_table_entries);
+
+		qlen = reqsk_queue_hash_req(lopt, h, req, timeout);
+	}
+	write_unlock(&queue->syn_wait_lock);
+
+	if (qlen < 0)
+		return 0;
+	if (qlen == 0)
+		inet_csk_reset_keepalive_timer(sk, timeout);
+	return 1;
 }
 
 EXPORT_SYMBOL_GPL(inet6_csk_reqsk_queue_hash_add);
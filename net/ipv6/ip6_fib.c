@@ -153,15 +153,23 @@ static __inline__ struct fib6_node * node_alloc(void)
 	return fn;
 }
 
-static __inline__ void node_free(struct fib6_node * fn)
+static void node_free_rcu(struct rcu_head *head)
 {
+	struct fib6_node *fn = container_of(head, struct fib6_node, rcu);
+
 	kmem_cache_free(fib6_node_kmem, fn);
 }
 
+/* Lockless lookups may still be walking through the node */
+static __inline__ void node_free(struct fib6_node * fn)
+{
+	call_rcu_bh(&fn->rcu, node_free_rcu);
+}
+
 static __inline__ void rt6_release(struct rt6_info *rt)
 {
 	if (atomic_dec_and_test(&rt->rt6i_ref))
-		dst_free(&rt->u.dst);
+		call_rcu_bh(&rt->u.dst.rcu_head, dst_rcu_free);
 }
 
 static void fib6_link_table(struct net *net, struct fib6_table *tb)
@@ -173,6 +181,7 @@ static void fib6_link_table(struct net *net, struct fib6_table *tb)
 	 * tables aren't visible prior to being linked to the list.
 	 */
 	rwlock_init(&tb->tb6_lock);
+	seqcount_init(&tb->tb6_seq);
 
 	h = tb->tb6_id & (FIB6_TABLE_HASHSZ - 1);
 
@@ -476,9 +485,9 @@ static struct fib6_node * fib6_add_1(struct fib6_node *root, void *addr,
 	ln->fn_sernum = sernum;
 
 	if (dir)
-		pn->right = ln;
+		rcu_assign_pointer(pn->right, ln);
 	else
-		pn->left  = ln;
+		rcu_assign_pointer(pn->left, ln);
 
 	return ln;
 
@@ -537,9 +546,9 @@ insert_above:
 
 		/* update parent pointer */
 		if (dir)
-			pn->right = in;
+			rcu_assign_pointer(pn->right, in);
 		else
-			pn->left  = in;
+			rcu_assign_pointer(pn->left, in);
 
 		ln->fn_bit = plen;
 
@@ -549,10 +558,10 @@ insert_above:
 		ln->fn_sernum = sernum;
 
 		if (addr_bit_set(addr, bit)) {
-			in->right = ln;
+			rcu_assign_pointer(in->right, ln);
 			in->left  = fn;
 		} else {
-			in->left  = ln;
+			rcu_assign_pointer(in->left, ln);
 			in->right = fn;
 		}
 	} else { /* plen <= bit */
@@ -575,9 +584,9 @@ insert_above:
 		ln->fn_sernum = sernum;
 
 		if (dir)
-			pn->right = ln;
+			rcu_assign_pointer(pn->right, ln);
 		else
-			pn->left  = ln;
+			rcu_assign_pointer(pn->left, ln);
 
 		if (addr_bit_set(&key->addr, plen))
 			ln->right = fn;
@@ -641,7 +650,7 @@ static int fib6_add_rt2node(struct fib6_node *fn, struct rt6_info *rt,
 	 */
 
 	rt->u.dst.rt6_next = iter;
-	*ins = rt;
+	rcu_assign_pointer(*ins, rt);
 	rt->rt6i_node = fn;
 	atomic_inc(&rt->rt6i_ref);
 	inet6_rt_notify(RTM_NEWROUTE, rt, info);
@@ -733,7 +742,7 @@ int fib6_add(struct fib6_node *root, struct rt6_info *rt, struct nl_info *info)
 
 			/* Now link new subtree to main tree */
 			sfn->parent = fn;
-			fn->subtree = sfn;
+			rcu_assign_pointer(fn->subtree, sfn);
 		} else {
 			sn = fib6_add_1(fn->subtree, &rt->rt6i_src.addr,
 					sizeof(struct in6_addr), rt->rt6i_src.plen,
@@ -827,7 +836,8 @@ static struct fib6_node * fib6_lookup_1(struct fib6_node *root,
 
 		dir = addr_bit_set(args->addr, fn->fn_bit);
 
-		next = dir ? fn->right : fn->left;
+		next = dir ? rcu_dereference(fn->right) :
+			     rcu_dereference(fn->left);
 
 		if (next) {
 			fn = next;
@@ -838,17 +848,22 @@ static struct fib6_node * fib6_lookup_1(struct fib6_node *root,
 	}
 
 	while(fn) {
-		if (FIB6_SUBTREE(fn) || fn->fn_flags & RTN_RTINFO) {
+		struct rt6_info *leaf = rcu_dereference(fn->leaf);
+
+		/*
+		 * A lockless lookup may see the leaf list of a node being
+		 * emptied; it retries once the writer is done.
+		 */
+		if (leaf && (FIB6_SUBTREE(fn) || fn->fn_flags & RTN_RTINFO)) {
 			struct rt6key *key;
 
-			key = (struct rt6key *) ((u8 *) fn->leaf +
-						 args->offset);
+			key = (struct rt6key *) ((u8 *) leaf + args->offset);
 
 			if (ipv6_prefix_equal(&key->addr, args->addr, key->plen)) {
 #ifdef CONFIG_IPV6_SUBTREES
 				if (fn->subtree) {
 					struct fib6_node *sfn;
-					sfn = fib6_lookup_1(fn->subtree,
+					sfn = fib6_lookup_1(rcu_dereference(fn->subtree),
 							    args + 1);
 					if (!sfn)
 						goto backtrack;
@@ -1374,8 +1389,10 @@ void fib6_clean_all(struct net *net, int (*func)(struct rt6_info *, void *arg),
 		head = &net->ipv6.fib_table_hash[h];
 		hlist_for_each_entry_rcu(table, node, head, tb6_hlist) {
 			write_lock_bh(&table->tb6_lock);
+			write_seqcount_begin(&table->tb6_seq);
 			fib6_clean_tree(net, &table->tb6_root,
 					func, prune, arg);
+			write_seqcount_end(&table->tb6_seq);
 			write_unlock_bh(&table->tb6_lock);
 		}
 	}
@@ -1531,6 +1548,8 @@ static void fib6_net_exit(struct net *net)
 {
 	rt6_ifdown(net, NULL);
 	del_timer_sync(&net->ipv6.ip6_fib_timer);
+	/* The routes dropped above are still queued for RCU */
+	rcu_barrier_bh();
 
 #ifdef CONFIG_IPV6_MULTIPLE_TABLES
 	kfree(net->ipv6.fib6_local_tbl);
@@ -1576,5 +1595,6 @@ out_kmem_cache_create:
 void fib6_gc_cleanup(void)
 {
 	unregister_pernet_subsys(&fib6_net_ops);
+	rcu_barrier_bh();
 	kmem_cache_destroy(fib6_node_kmem);
 }
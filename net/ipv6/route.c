@@ -233,7 +233,8 @@ static inline int rt6_need_strict(struct in6_addr *daddr)
 }
 
 /*
- *	Route lookup. Any table->tb6_lock is implied.
+ *	Route lookup. Either table->tb6_lock or rcu_read_lock_bh() with a
+ *	table->tb6_seq retry is implied.
  */
 
 static inline struct rt6_info *rt6_device_match(struct net *net,
@@ -416,36 +417,46 @@ static struct rt6_info *find_rr_leaf(struct fib6_node *fn,
 	return match;
 }
 
-static struct rt6_info *rt6_select(struct fib6_node *fn, int oif, int strict)
+static struct rt6_info *rt6_select(struct net *net, struct fib6_table *table,
+				   struct fib6_node *fn, int oif, int strict)
 {
 	struct rt6_info *match, *rt0;
-	struct net *net;
 
 	RT6_TRACE("%s(fn->leaf=%p, oif=%d)\n",
 		  __func__, fn->leaf, oif);
 
-	rt0 = fn->rr_ptr;
+	rt0 = rcu_dereference(fn->rr_ptr);
 	if (!rt0)
-		fn->rr_ptr = rt0 = fn->leaf;
+		rt0 = rcu_dereference(fn->leaf);
+	if (unlikely(!rt0))
+		return net->ipv6.ip6_null_entry;
 
 	match = find_rr_leaf(fn, rt0, rt0->rt6i_metric, oif, strict);
 
 	if (!match &&
 	    (strict & RT6_LOOKUP_F_REACHABLE)) {
-		struct rt6_info *next = rt0->u.dst.rt6_next;
+		struct rt6_info *next = rcu_dereference(rt0->u.dst.rt6_next);
 
 		/* no entries matched; do round-robin */
 		if (!next || next->rt6i_metric != rt0->rt6i_metric)
-			next = fn->leaf;
+			next = rcu_dereference(fn->leaf);
 
-		if (next != rt0)
-			fn->rr_ptr = next;
+		/*
+		 * Lookups run without tb6_lock, but the round-robin
+		 * pointer is only moved under it, and only to a route
+		 * fib6_del_route() has not unlinked yet.
+		 */
+		if (next && next != rt0) {
+			write_lock_bh(&table->tb6_lock);
+			if (next->rt6i_node)
+				rcu_assign_pointer(fn->rr_ptr, next);
+			write_unlock_bh(&table->tb6_lock);
+		}
 	}
 
 	RT6_TRACE("%s() => %p\n",
 		  __func__, match);
 
-	net = dev_net(rt0->rt6i_dev);
 	return (match ? match : net->ipv6.ip6_null_entry);
 }
 
@@ -550,16 +561,21 @@ static struct rt6_info *ip6_pol_route_lookup(struct net *net,
 {
 	struct fib6_node *fn;
 	struct rt6_info *rt;
+	unsigned int seq;
 
-	read_lock_bh(&table->tb6_lock);
+	rcu_read_lock_bh();
+relookup:
+	seq = read_seqcount_begin(&table->tb6_seq);
 	fn = fib6_lookup(&table->tb6_root, &fl->fl6_dst, &fl->fl6_src);
 restart:
-	rt = fn->leaf;
+	rt = rcu_dereference(fn->leaf);
 	rt = rt6_device_match(net, rt, &fl->fl6_src, fl->oif, flags);
 	BACKTRACK(net, &fl->fl6_src);
 out:
+	if (read_seqcount_retry(&table->tb6_seq, seq))
+		goto relookup;
 	dst_use(&rt->u.dst, jiffies);
-	read_unlock_bh(&table->tb6_lock);
+	rcu_read_unlock_bh();
 	return rt;
 
 }
@@ -607,7 +623,9 @@ static int __ip6_ins_rt(struct rt6_info *rt, struct nl_info *info)
 
 	table = rt->rt6i_table;
 	write_lock_bh(&table->tb6_lock);
+	write_seqcount_begin(&table->tb6_seq);
 	err = fib6_add(&table->tb6_root, rt, info);
+	write_seqcount_end(&table->tb6_seq);
 	write_unlock_bh(&table->tb6_lock);
 
 	return err;
@@ -712,25 +730,30 @@ static struct rt6_info *ip6_pol_route(struct net *net, struct fib6_table *table,
 	int attempts = 3;
 	int err;
 	int reachable = net->ipv6.devconf_all->forwarding ? 0 : RT6_LOOKUP_F_REACHABLE;
+	unsigned int seq;
 
 	strict |= flags & RT6_LOOKUP_F_IFACE;
 
 relookup:
-	read_lock_bh(&table->tb6_lock);
+	rcu_read_lock_bh();
 
 restart_2:
+	seq = read_seqcount_begin(&table->tb6_seq);
 	fn = fib6_lookup(&table->tb6_root, &fl->fl6_dst, &fl->fl6_src);
 
 restart:
-	rt = rt6_select(fn, oif, strict | reachable);
+	rt = rt6_select(net, table, fn, oif, strict | reachable);
 
 	BACKTRACK(net, &fl->fl6_src);
 	if (rt == net->ipv6.ip6_null_entry ||
 	    rt->rt6i_flags & RTF_CACHE)
 		goto out;
 
+	if (read_seqcount_retry(&table->tb6_seq, seq))
+		goto restart_2;
+
 	dst_hold(&rt->u.dst);
-	read_unlock_bh(&table->tb6_lock);
+	rcu_read_unlock_bh();
 
 	if (!rt->rt6i_nexthop && !(rt->rt6i_flags & RTF_NONEXTHOP))
 		nrt = rt6_alloc_cow(rt, &fl->fl6_dst, &fl->fl6_src);
@@ -756,19 +779,21 @@ restart:
 		goto out2;
 
 	/*
-	 * Race condition! In the gap, when table->tb6_lock was
-	 * released someone could insert this route.  Relookup.
+	 * Race condition! In the gap, when we left the RCU read side
+	 * someone could insert this route.  Relookup.
 	 */
 	dst_release(&rt->u.dst);
 	goto relookup;
 
 out:
+	if (read_seqcount_retry(&table->tb6_seq, seq))
+		goto restart_2;
 	if (reachable) {
 		reachable = 0;
 		goto restart_2;
 	}
 	dst_hold(&rt->u.dst);
-	read_unlock_bh(&table->tb6_lock);
+	rcu_read_unlock_bh();
 out2:
 	rt->u.dst.lastuse = jiffies;
 	rt->u.dst.__use++;
@@ -1339,10 +1364,12 @@ static int __ip6_del_rt(struct rt6_info *rt, struct nl_info *info)
 
 	table = rt->rt6i_table;
 	write_lock_bh(&table->tb6_lock);
+	write_seqcount_begin(&table->tb6_seq);
 
 	err = fib6_del(rt, info);
 	dst_release(&rt->u.dst);
 
+	write_seqcount_end(&table->tb6_seq);
 	write_unlock_bh(&table->tb6_lock);
 
 	return err;
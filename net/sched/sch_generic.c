@@ -49,16 +49,23 @@ static inline int dev_requeue_skb(struct sk_buff *skb, struct Qdisc *q)
 
 static inline struct sk_buff *dequeue_skb(struct Qdisc *q)
 {
-	struct sk_buff *skb = q->gso_skb;
+	struct sk_buff *skb;
+
+	/*
+	 * Take in the deferred packets first, even when a requeued one
+	 * blocks the queue: qdisc_run_end() would reschedule us for them
+	 * over and over while the driver keeps the queue stopped.
+	 */
+	qdisc_splice_deferred(q);
 
+	skb = q->gso_skb;
 	if (unlikely(skb)) {
 		struct net_device *dev = qdisc_dev(q);
 		struct netdev_queue *txq;
 
 		/* check the reason of requeuing without tx lock first */
 		txq = netdev_get_tx_queue(dev, skb_get_queue_mapping(skb));
-		if (!netif_tx_queue_stopped(txq) &&
-		    !netif_tx_queue_frozen(txq)) {
+		if (!netif_xmit_frozen_or_stopped(txq)) {
 			q->gso_skb = NULL;
 			q->q.qlen--;
 		} else
@@ -119,8 +126,7 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 	spin_unlock(root_lock);
 
 	HARD_TX_LOCK(dev, txq, smp_processor_id());
-	if (!netif_tx_queue_stopped(txq) &&
-	    !netif_tx_queue_frozen(txq))
+	if (!netif_xmit_frozen_or_stopped(txq))
 		ret = dev_hard_start_xmit(skb, dev, txq);
 	HARD_TX_UNLOCK(dev, txq);
 
@@ -129,7 +135,7 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 	switch (ret) {
 	case NETDEV_TX_OK:
 		/* Driver sent out skb successfully */
-		ret = qdisc_qlen(q);
+		ret = qdisc_qlen(q) || q->defer_list;
 		break;
 
 	case NETDEV_TX_LOCKED:
@@ -147,8 +153,7 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 		break;
 	}
 
-	if (ret && (netif_tx_queue_stopped(txq) ||
-		    netif_tx_queue_frozen(txq)))
+	if (ret && netif_xmit_frozen_or_stopped(txq))
 		ret = 0;
 
 	return ret;
@@ -208,7 +213,43 @@ void __qdisc_run(struct Qdisc *q)
 		}
 	}
 
-	clear_bit(__QDISC_STATE_RUNNING, &q->state);
+	qdisc_run_end(q);
+}
+
+/*
+ * Move the packets deferred by qdisc_defer_skb() into the qdisc, oldest
+ * first.  Called under qdisc_lock(q).
+ */
+void __qdisc_splice_deferred(struct Qdisc *q)
+{
+	struct sk_buff *skb = xchg(&q->defer_list, NULL);
+	struct sk_buff *list = NULL, *next;
+
+	while (skb) {
+		next = skb->next;
+		skb->next = list;
+		list = skb;
+		skb = next;
+	}
+
+	while (list) {
+		skb = list;
+		list = list->next;
+		skb->next = NULL;
+		qdisc_enqueue_root(skb, q);
+	}
+}
+
+static void qdisc_free_deferred(struct Qdisc *q)
+{
+	struct sk_buff *skb = xchg(&q->defer_list, NULL);
+	struct sk_buff *next;
+
+	while (skb) {
+		next = skb->next;
+		kfree_skb(skb);
+		skb = next;
+	}
 }
 
 unsigned long dev_trans_start(struct net_device *dev)
@@ -529,6 +570,8 @@ static int pfifo_fast_init(struct Qdisc *qdisc, struct nlattr *opt)
 	for (prio = 0; prio < PFIFO_FAST_BANDS; prio++)
 		skb_queue_head_init(band2list(priv, prio));
 
+	/* Work-conserving: contended enqueues need not wait for the lock */
+	qdisc->flags |= TCQ_F_DEFER;
 	return 0;
 }
 
@@ -564,6 +607,7 @@ struct Qdisc *qdisc_alloc(struct netdev_queue *dev_queue,
 
 	INIT_LIST_HEAD(&sch->list);
 	skb_queue_head_init(&sch->q);
+	spin_lock_init(&sch->busylock);
 	sch->ops = ops;
 	sch->enqueue = ops->enqueue;
 	sch->dequeue = ops->dequeue;
@@ -611,6 +655,7 @@ void qdisc_reset(struct Qdisc *qdisc)
 		qdisc->gso_skb = NULL;
 		qdisc->q.qlen = 0;
 	}
+	qdisc_free_deferred(qdisc);
 }
 EXPORT_SYMBOL(qdisc_reset);
 
@@ -637,6 +682,7 @@ void qdisc_destroy(struct Qdisc *qdisc)
 	dev_put(qdisc_dev(qdisc));
 
 	kfree_skb(qdisc->gso_skb);
+	qdisc_free_deferred(qdisc);
 	kfree((char *) qdisc - qdisc->padded);
 }
 EXPORT_SYMBOL(qdisc_destroy);